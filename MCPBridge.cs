@@ -1,3 +1,6 @@
+using System.Buffers.Binary;
+using System.Collections.Concurrent;
+using System.Text;
 using System.Text.Json;
 using System.Text.Json.Serialization;
 using System.Diagnostics;
@@ -7,21 +10,35 @@ namespace MCPBridge;
 // Source Generator Context para Native AOT
 [JsonSerializable(typeof(MCPCommand))]
 [JsonSerializable(typeof(MCPResponse))]
+[JsonSerializable(typeof(MCPChunk))]
 [JsonSerializable(typeof(SystemInfo))]
 [JsonSerializable(typeof(TextAnalysis))]
 public partial class JsonContext : JsonSerializerContext { }
 
 public class MCPCommand
 {
+    public long Id { get; set; }
     public string Action { get; set; } = "";
     public string? Data { get; set; }
+    public bool Stream { get; set; }            // execute_command: enviar la salida mientras se produce
+    public int TimeoutMs { get; set; }          // execute_command: plazo del comando (0 = sin límite)
 }
 
 public class MCPResponse
 {
+    public long Id { get; set; }
     public bool Success { get; set; }
     public string? Result { get; set; }
     public string? Error { get; set; }
+    public double ElapsedMs { get; set; }
+}
+
+// Trozo de salida de un comando en curso; la respuesta final llega después con el mismo Id
+public class MCPChunk
+{
+    public long Id { get; set; }
+    public int Fd { get; set; }                 // 1 = stdout, 2 = stderr
+    public string Chunk { get; set; } = "";
 }
 
 public class SystemInfo
@@ -51,46 +68,180 @@ class Program
             return;
         }
 
+        var input = Console.OpenStandardInput();
+        var output = Console.OpenStandardOutput();
+        var running = new List<Task>();
+
         try
         {
+            // Cada comando se atiende en su propia tarea; las respuestas salen
+            // en el orden en que terminan, identificadas por su Id
             while (true)
             {
-                var line = Console.ReadLine();
-                if (string.IsNullOrEmpty(line) || line == "EXIT")
+                var message = await ReadMessageAsync(input);
+                if (message == null)
                     break;
 
-                var command = JsonSerializer.Deserialize(line, JsonContext.Default.MCPCommand);
-                if (command != null)
+                MCPCommand? command = null;
+                string? parseError = null;
+                try
                 {
-                    var response = await ProcessCommand(command);
-                    var jsonResponse = JsonSerializer.Serialize(response, JsonContext.Default.MCPResponse);
-                    Console.WriteLine(jsonResponse);
-                    Console.Out.Flush();
+                    command = JsonSerializer.Deserialize(message, JsonContext.Default.MCPCommand);
                 }
+                catch (JsonException ex)
+                {
+                    parseError = $"JSON inválido: {ex.Message}";
+                }
+
+                // {"Id":N,"Action":"cancel"} mata el comando de la solicitud N; no tiene
+                // respuesta propia: la solicitud cancelada responde con su error
+                if (command != null && command.Action.Equals("cancel", StringComparison.OrdinalIgnoreCase))
+                {
+                    if (Running.TryGetValue(command.Id, out var target))
+                        target.Cancel();
+                    continue;
+                }
+
+                // Se registra aquí, en orden de llegada, para que una cancelación
+                // que llegue justo detrás siempre la encuentre
+                var cancel = new CancellationTokenSource();
+                if (command != null && command.Id > 0)
+                    Running[command.Id] = cancel;
+
+                running.RemoveAll(t => t.IsCompleted);
+                running.Add(Task.Run(() => HandleMessageAsync(command, parseError, cancel, output)));
             }
+            await Task.WhenAll(running);
         }
         catch (Exception ex)
         {
+            // Error de protocolo: sin Id, el cliente da la sesión por terminada
             var errorResponse = new MCPResponse 
             { 
                 Success = false, 
                 Error = $"Bridge error: {ex.Message}" 
             };
-            var jsonError = JsonSerializer.Serialize(errorResponse, JsonContext.Default.MCPResponse);
-            Console.WriteLine(jsonError);
+            await WriteMessageAsync(output, JsonSerializer.SerializeToUtf8Bytes(errorResponse, JsonContext.Default.MCPResponse));
         }
     }
 
-    static async Task<MCPResponse> ProcessCommand(MCPCommand command)
+    // Solicitudes en curso por Id, para poder cancelarlas
+    static readonly ConcurrentDictionary<long, CancellationTokenSource> Running = new();
+
+    static async Task HandleMessageAsync(MCPCommand? command, string? parseError,
+                                         CancellationTokenSource cancel, Stream output)
     {
+        MCPResponse response;
+        long id = command?.Id ?? 0;
+        var watch = Stopwatch.StartNew();
         try
         {
+            response = command != null
+                ? await ProcessCommand(command, output, cancel.Token)
+                : new MCPResponse { Success = false, Error = parseError ?? "Comando vacío" };
+        }
+        finally
+        {
+            Running.TryRemove(new KeyValuePair<long, CancellationTokenSource>(id, cancel));
+            cancel.Dispose();
+        }
+
+        response.Id = id;
+        response.ElapsedMs = watch.Elapsed.TotalMilliseconds;
+        await WriteMessageAsync(output, JsonSerializer.SerializeToUtf8Bytes(response, JsonContext.Default.MCPResponse));
+    }
+
+    // Protocolo: cada mensaje viaja en uno o más frames
+    // [longitud u32 big-endian][flags u32 big-endian][payload]
+    const int FrameHeader = 8;
+    const uint FrameMore = 0x1;                 // El mensaje continúa en el siguiente frame
+    const uint FrameClose = 0x2;                // Fin de la sesión
+    const int FrameChunk = 1 << 20;             // Payload máximo por frame
+    const int MaxMessage = 256 << 20;           // Mensajes mayores se consideran corruptos
+
+    // Lee frames hasta completar un mensaje; null si la sesión terminó
+    static async Task<byte[]?> ReadMessageAsync(Stream input)
+    {
+        var header = new byte[FrameHeader];
+        var message = new MemoryStream();
+
+        while (true)
+        {
+            try
+            {
+                await input.ReadExactlyAsync(header);
+            }
+            catch (EndOfStreamException)
+            {
+                return null;
+            }
+
+            var length = BinaryPrimitives.ReadUInt32BigEndian(header);
+            var flags = BinaryPrimitives.ReadUInt32BigEndian(header.AsSpan(4));
+            if ((flags & FrameClose) != 0)
+                return null;
+            if (length > FrameChunk || message.Length + length > MaxMessage)
+                throw new InvalidDataException($"Frame inválido ({length} bytes)");
+
+            var start = (int)message.Length;
+            message.SetLength(start + length);
+            await input.ReadExactlyAsync(message.GetBuffer().AsMemory(start, (int)length));
+
+            if ((flags & FrameMore) == 0)
+                return message.ToArray();
+        }
+    }
+
+    // Los frames de dos respuestas nunca deben intercalarse
+    static readonly SemaphoreSlim OutputLock = new(1, 1);
+
+    // Envía un mensaje troceado en frames de como mucho FrameChunk bytes
+    static async Task WriteMessageAsync(Stream output, byte[] payload)
+    {
+        var header = new byte[FrameHeader];
+        var offset = 0;
+        await OutputLock.WaitAsync();
+        try
+        {
+            do
+            {
+                var chunk = Math.Min(FrameChunk, payload.Length - offset);
+                var more = offset + chunk < payload.Length;
+                BinaryPrimitives.WriteUInt32BigEndian(header, (uint)chunk);
+                BinaryPrimitives.WriteUInt32BigEndian(header.AsSpan(4), more ? FrameMore : 0);
+                await output.WriteAsync(header);
+                await output.WriteAsync(payload.AsMemory(offset, chunk));
+                offset += chunk;
+            } while (offset < payload.Length);
+            await output.FlushAsync();
+        }
+        finally
+        {
+            OutputLock.Release();
+        }
+    }
+
+    static readonly SemaphoreSlim AuditLock = new(1, 1);
+
+    static async Task<MCPResponse> ProcessCommand(MCPCommand command, Stream output, CancellationToken cancelled)
+    {
+        try
+        {
+            // Con Stream, cada trozo de salida viaja en su propio mensaje en cuanto se lee
+            Func<int, string, Task>? onChunk = null;
+            if (command.Stream)
+            {
+                var id = command.Id;
+                onChunk = (fd, chunk) => WriteMessageAsync(output, JsonSerializer.SerializeToUtf8Bytes(
+                    new MCPChunk { Id = id, Fd = fd, Chunk = chunk }, JsonContext.Default.MCPChunk));
+            }
             return command.Action.ToLower() switch
             {
-                "execute_command" => await ExecuteSystemCommand(command.Data ?? ""),
+                "execute_command" => await ExecuteSystemCommand(command.Data ?? "", default, onChunk, cancelled,
+                                                                 command.TimeoutMs),
                 "analyze_text" => AnalyzeText(command.Data ?? ""),
                 "get_system_info" => GetSystemInfo(),
-                "arch_diagnostics" => await ArchDiagnostics(),
+                "arch_diagnostics" => await ArchDiagnostics(command.Data, cancelled),
                 _ => new MCPResponse 
                 { 
                     Success = false, 
@@ -108,7 +259,10 @@ class Program
         }
     }
 
-    static async Task<MCPResponse> ExecuteSystemCommand(string command)
+    static async Task<MCPResponse> ExecuteSystemCommand(string command, CancellationToken deadline = default,
+                                                        Func<int, string, Task>? onChunk = null,
+                                                        CancellationToken cancelled = default,
+                                                        int timeoutMs = 0)
     {
         try
         {
@@ -136,9 +290,17 @@ class Program
                     Error = "Comando demasiado largo (máx 1024 caracteres)"
                 };
             }
-            // Log de auditoría
-            await File.AppendAllTextAsync("mcp_audit.log",
-                $"[{DateTime.Now:yyyy-MM-dd HH:mm:ss}] Ejecutando: {command}\n");
+            // Log de auditoría (los comandos concurrentes escriben de uno en uno)
+            await AuditLock.WaitAsync();
+            try
+            {
+                await File.AppendAllTextAsync("mcp_audit.log",
+                    $"[{DateTime.Now:yyyy-MM-dd HH:mm:ss}] Ejecutando: {command}\n");
+            }
+            finally
+            {
+                AuditLock.Release();
+            }
             using var process = new Process();
             process.StartInfo = new ProcessStartInfo
             {
@@ -152,22 +314,29 @@ class Program
             // Limitar recursos del entorno
             process.StartInfo.Environment["PATH"] = "/usr/local/bin:/usr/bin:/bin";
             process.StartInfo.Environment["HOME"] = "/tmp";
-            // Timeout para evitar comandos colgados
-            using var cts = new CancellationTokenSource(TimeSpan.FromSeconds(30));
+            // Plazo que pide el cliente (COMMAND_TIMEOUT; 0 = sin límite, como en el
+            // modo nativo), el plazo del llamador o la cancelación que pida el cliente
+            using var cts = CancellationTokenSource.CreateLinkedTokenSource(deadline, cancelled);
+            if (timeoutMs > 0)
+                cts.CancelAfter(TimeSpan.FromMilliseconds(timeoutMs));
             process.Start();
-            var outputTask = process.StandardOutput.ReadToEndAsync();
-            var errorTask = process.StandardError.ReadToEndAsync();
+            var outputTask = PumpAsync(process.StandardOutput, 1, onChunk);
+            var errorTask = PumpAsync(process.StandardError, 2, onChunk);
             try
             {
                 await process.WaitForExitAsync(cts.Token);
             }
             catch (OperationCanceledException)
             {
-                process.Kill();
+                process.Kill(true);
                 return new MCPResponse
                 {
                     Success = false,
-                    Error = "Comando cancelado: tiempo de ejecución excedido (30s)"
+                    Error = cancelled.IsCancellationRequested
+                        ? "Comando cancelado desde el cliente"
+                        : deadline.IsCancellationRequested
+                        ? "Comando cortado: venció el plazo global"
+                        : $"Comando cancelado: tiempo de ejecución excedido ({timeoutMs / 1000.0:0.#}s)"
                 };
             }
             var output = await outputTask;
@@ -192,6 +361,22 @@ class Program
         }
     }
 
+    // Lee un flujo hasta el final; cada trozo se guarda y, si hay destino, se reenvía en cuanto llega
+    static async Task<string> PumpAsync(StreamReader reader, int fd, Func<int, string, Task>? onChunk)
+    {
+        var text = new StringBuilder();
+        var buffer = new char[4096];
+        int n;
+        while ((n = await reader.ReadAsync(buffer, 0, buffer.Length)) > 0)
+        {
+            var chunk = new string(buffer, 0, n);
+            text.Append(chunk);
+            if (onChunk != null)
+                await onChunk(fd, chunk);
+        }
+        return text.ToString();
+    }
+
     static MCPResponse AnalyzeText(string text)
     {
         var isCommand = IsLikelyCommand(text);
@@ -242,25 +427,68 @@ class Program
         }
     }
 
-    static async Task<MCPResponse> ArchDiagnostics()
+    static readonly string[] DefaultDiagnostics = { "uname -a", "lsblk -f", "df -h", "free -h" };
+
+    // Lee un diagnostics.ini (TIMEOUT=segundos, COMMAND=... por línea); sin archivo, el conjunto básico
+    static (List<string> Commands, int TimeoutSeconds) LoadDiagnostics(string? path)
     {
-        var commands = new[]
+        var commands = new List<string>();
+        var timeout = 15;
+
+        if (!string.IsNullOrEmpty(path) && File.Exists(path))
         {
-            "uname -a",
-            "lsblk -f", 
-            "df -h",
-            "free -h"
-        };
+            foreach (var raw in File.ReadAllLines(path))
+            {
+                var line = raw.Trim();
+                if (line.Length == 0 || line.StartsWith('#'))
+                    continue;
+                var eq = line.IndexOf('=');
+                if (eq < 0)
+                    continue;
+                var key = line[..eq].Trim();
+                var value = line[(eq + 1)..].Trim();
+                if (key == "TIMEOUT" && int.TryParse(value, out var seconds) && seconds > 0)
+                    timeout = seconds;
+                else if (key == "COMMAND" && value.Length > 0)
+                    commands.Add(value);
+            }
+        }
+
+        if (commands.Count == 0)
+            commands.AddRange(DefaultDiagnostics);
+        return (commands, timeout);
+    }
+
+    // Ejecuta todos los comandos a la vez con un plazo global; el informe sigue el orden del archivo
+    static async Task<MCPResponse> ArchDiagnostics(string? path, CancellationToken cancelled = default)
+    {
+        var (commands, timeoutSeconds) = LoadDiagnostics(path);
+        using var deadline = new CancellationTokenSource(TimeSpan.FromSeconds(timeoutSeconds));
+        var total = Stopwatch.StartNew();
+
+        var runs = commands.Select(async cmd =>
+        {
+            var watch = Stopwatch.StartNew();
+            var response = await ExecuteSystemCommand(cmd, deadline.Token, null, cancelled);
+            return (Response: response, Elapsed: watch.Elapsed);
+        }).ToArray();
+        var outcomes = await Task.WhenAll(runs);
 
         var results = new List<string>();
-        
-        foreach (var cmd in commands)
+        var serial = TimeSpan.Zero;
+        var failed = 0;
+        for (var i = 0; i < commands.Count; i++)
         {
-            var response = await ExecuteSystemCommand(cmd);
-            results.Add($"=== {cmd} ===");
-            results.Add(response.Result ?? "Error");
+            var (response, elapsed) = outcomes[i];
+            serial += elapsed;
+            if (!response.Success)
+                failed++;
+            results.Add($"=== {commands[i]} === [{elapsed.TotalSeconds:0.000} s]");
+            results.Add(response.Result ?? response.Error ?? "Error");
             results.Add("");
         }
+        results.Add($"Resumen: {commands.Count} comandos en {total.Elapsed.TotalSeconds:0.00} s " +
+                    $"(en serie: {serial.TotalSeconds:0.00} s); {failed} con error, plazo de {timeoutSeconds} s");
 
         return new MCPResponse
         {
@@ -269,22 +497,87 @@ class Program
         };
     }
 
+    // Mismo criterio que command_index.c en el cliente: ejecutables del PATH y
+    // órdenes internas de bash. Se recorre el PATH una vez por proceso
+    static readonly string[] ShellBuiltins =
+    {
+        ".", ":", "alias", "bg", "bind", "break", "builtin", "caller", "cd", "command",
+        "compgen", "complete", "compopt", "continue", "declare", "dirs", "disown", "echo",
+        "enable", "eval", "exec", "export", "false", "fc", "fg", "getopts", "hash",
+        "history", "jobs", "kill", "let", "local", "mapfile", "popd", "printf", "pushd",
+        "pwd", "read", "readarray", "readonly", "return", "set", "shift", "shopt",
+        "source", "test", "times", "trap", "true", "type", "typeset", "ulimit", "umask",
+        "unalias", "unset", "wait"
+    };
+
+    static readonly Lazy<HashSet<string>> KnownCommands = new(ScanPath);
+
+    const UnixFileMode AnyExecute = UnixFileMode.UserExecute | UnixFileMode.GroupExecute | UnixFileMode.OtherExecute;
+
+    static HashSet<string> ScanPath()
+    {
+        var names = new HashSet<string>(ShellBuiltins, StringComparer.Ordinal);
+        var path = Environment.GetEnvironmentVariable("PATH");
+        if (string.IsNullOrEmpty(path)) path = "/usr/local/sbin:/usr/local/bin:/usr/bin:/bin:/usr/sbin:/sbin";
+
+        foreach (var dir in path.Split(':', StringSplitOptions.RemoveEmptyEntries))
+        {
+            if (!dir.StartsWith('/') || !Directory.Exists(dir)) continue;
+            try
+            {
+                foreach (var file in new DirectoryInfo(dir).EnumerateFiles())
+                {
+                    if (file.Name.StartsWith('.')) continue;
+                    // Los enlaces simbólicos cuentan por su destino
+                    var target = file.LinkTarget != null ? file.ResolveLinkTarget(true) as FileInfo : file;
+                    if (target is { Exists: true } && (target.UnixFileMode & AnyExecute) != 0)
+                        names.Add(file.Name);
+                }
+            }
+            catch (Exception ex) when (ex is IOException || ex is UnauthorizedAccessException)
+            {
+                // Directorio ilegible: se ignora como hace la shell
+            }
+        }
+        return names;
+    }
+
     static bool IsLikelyCommand(string text)
     {
         if (string.IsNullOrWhiteSpace(text)) return false;
         
         text = text.Trim();
         
-        var commandPatterns = new[]
+        // Una pregunta va al modelo aunque empiece por el nombre de un programa
+        if (text.EndsWith('?') || text.StartsWith('¿')) return false;
+
+        var words = text.Split((char[]?)null, StringSplitOptions.RemoveEmptyEntries);
+        var i = 0;
+        while (i < words.Length && IsAssignment(words[i])) i++;   // LANG=C ls
+        if (i == words.Length) return false;
+
+        var word = words[i];
+        var end = word.IndexOfAny(new[] { ';', '|', '&', '<', '>', '(', ')' });
+        if (end >= 0) word = word[..end];
+        if (word.Length == 0) return false;
+
+        if (word.Contains('/'))
         {
-            "ls", "dir", "pwd", "cd", "cat", "grep", "find", "ps", "top", 
-            "df", "du", "free", "uname", "pacman", "yay", "systemctl", 
-            "journalctl", "sudo", "su", "chmod", "mkdir", "rm", "cp", "mv"
-        };
+            var file = new FileInfo(word);
+            return file.Exists && (file.UnixFileMode & AnyExecute) != 0;
+        }
+        return KnownCommands.Value.Contains(word);
+    }
 
-        return commandPatterns.Any(cmd => 
-            text.StartsWith(cmd, StringComparison.OrdinalIgnoreCase) &&
-            (text.Length == cmd.Length || char.IsWhiteSpace(text[cmd.Length])));
+    static bool IsAssignment(string word)
+    {
+        var eq = word.IndexOf('=');
+        if (eq <= 0 || !(char.IsAsciiLetter(word[0]) || word[0] == '_')) return false;
+        for (var k = 1; k < eq; k++)
+        {
+            if (!char.IsAsciiLetterOrDigit(word[k]) && word[k] != '_') return false;
+        }
+        return true;
     }
 
     static string DetectCommandType(string text)
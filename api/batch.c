@@ -0,0 +1,287 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../common/includes/buffer.h"
+#include "../common/includes/json_reader.h"
+#include "../common/includes/json_escape.h"
+#include "http_client.h"
+#include "openai.h"
+#include "batch.h"
+
+// Una solicitud del lote y su resultado
+typedef struct {
+    char *prompt;
+    char *id;                    // Valor JSON de "id" tal cual (cadena con comillas o número)
+    char *response;
+    long status;                 // Código HTTP (0 = error de transporte)
+    double latency_ms;
+    int done;
+} BatchItem;
+
+// Estado compartido entre los hilos del lote
+typedef struct {
+    BatchItem *items;
+    size_t count;
+    size_t next;                 // Siguiente solicitud sin asignar
+    pthread_mutex_t lock;
+    pthread_cond_t cond;         // Señala cada solicitud terminada
+    GPTConfig config;            // Copia fija para todo el lote
+    const char *api_key;
+    HttpShare *share;
+} BatchState;
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Interpreta una línea: {"id": ..., "prompt": "..."}, una cadena JSON o texto plano
+static int parse_line(const char *line, size_t len, BatchItem *item) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+    const char *p = line;
+    while (len > 0 && (*p == ' ' || *p == '\t')) { p++; len--; }
+    if (len == 0) return 0;
+
+    if (*p == '{') {
+        item->prompt = json_get_string(p, len, "prompt");
+        JsonValue id;
+        if (json_find(p, len, "id", &id)) {
+            if (id.type == JSON_TOK_STRING) {
+                item->id = malloc(id.raw_len + 3);
+                if (item->id) {
+                    item->id[0] = '"';
+                    memcpy(item->id + 1, id.raw, id.raw_len);
+                    memcpy(item->id + 1 + id.raw_len, "\"", 2);
+                }
+            } else if (id.type == JSON_TOK_NUMBER) {
+                item->id = strndup(id.raw, id.raw_len);
+            }
+        }
+    } else if (*p == '"') {
+        item->prompt = json_get_string(p, len, "");
+    } else {
+        item->prompt = strndup(p, len);
+    }
+
+    if (!item->prompt) {
+        item->response = strdup("Error: Línea sin \"prompt\" válido.");
+        item->done = 1;
+    }
+    return 1;
+}
+
+// Lee el archivo JSONL completo; las líneas vacías se ignoran
+static BatchItem* read_batch(const char *path, size_t *count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return NULL;
+    }
+
+    BatchItem *items = NULL;
+    size_t n = 0, cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &line_cap, fp)) >= 0) {
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            BatchItem *grown = realloc(items, cap * sizeof(BatchItem));
+            if (!grown) break;
+            items = grown;
+        }
+        memset(&items[n], 0, sizeof(BatchItem));
+        if (parse_line(line, (size_t)len, &items[n])) n++;
+    }
+    free(line);
+    fclose(fp);
+
+    *count = n;
+    if (n == 0) {
+        free(items);
+        items = calloc(1, sizeof(BatchItem));
+    }
+    return items;
+}
+
+static void* batch_worker(void *arg) {
+    BatchState *st = arg;
+    long connect_ms = st->config.connect_timeout > 0 ? st->config.connect_timeout * 1000L : 0;
+    long total_ms = st->config.request_timeout > 0 ? st->config.request_timeout * 1000L : 0;
+
+    // Un handle por hilo; las conexiones abiertas se reparten entre todos
+    HttpClient *http = http_client_create(connect_ms, total_ms);
+    if (http) http_client_set_share(http, st->share);
+
+    while (1) {
+        pthread_mutex_lock(&st->lock);
+        while (st->next < st->count && st->items[st->next].done) st->next++;
+        size_t i = st->next < st->count ? st->next++ : st->count;
+        pthread_mutex_unlock(&st->lock);
+        if (i == st->count) break;
+
+        BatchItem *item = &st->items[i];
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        long status = 0;
+        char *response = http
+            ? openai_complete(http, &st->config, st->api_key, item->prompt, &status)
+            : strdup("Error: No se pudo inicializar el cliente HTTP.");
+        double latency = elapsed_ms(&start);
+
+        pthread_mutex_lock(&st->lock);
+        item->response = response;
+        item->status = status;
+        item->latency_ms = latency;
+        item->done = 1;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+    }
+
+    http_client_destroy(http);
+    return NULL;
+}
+
+static int item_ok(const BatchItem *item) {
+    return item->status == 200 && item->response;
+}
+
+// Escribe el resultado de la solicitud index como una línea JSON
+static int write_result(FILE *out, size_t index, const BatchItem *item) {
+    Buffer line;
+    buffer_init(&line);
+    buffer_appendf(&line, "{\"index\": %zu", index);
+    if (item->id) buffer_appendf(&line, ", \"id\": %s", item->id);
+    buffer_appendf(&line, ", \"status\": %ld, \"latency_ms\": %.1f, \"%s\": \"",
+                   item->status, item->latency_ms, item_ok(item) ? "response" : "error");
+    const char *text = item->response ? item->response : "";
+    json_escape_append(&line, text, strlen(text));
+    int ok = buffer_append_str(&line, "\"}\n") &&
+             fwrite(line.data, 1, line.len, out) == line.len;
+    buffer_free(&line);
+    fflush(out);
+    return ok;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil por el método del rango más cercano sobre un array ordenado
+static double percentile(const double *sorted, size_t n, double p) {
+    if (n == 0) return 0.0;
+    size_t rank = (size_t)(p / 100.0 * n + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank > n ? n - 1 : rank - 1];
+}
+
+int run_batch(const char *input_path, const char *output_path, int concurrency,
+              GPTConfigStore *store) {
+    const GPTConfig *config = config_store_get(store);
+    if (!config) {
+        fprintf(stderr, "Error: Configuración no disponible.\n");
+        return -1;
+    }
+
+    BatchState st;
+    memset(&st, 0, sizeof(st));
+    st.items = read_batch(input_path, &st.count);
+    if (!st.items) return -1;
+
+    int to_stdout = !output_path || strcmp(output_path, "-") == 0;
+    FILE *out = to_stdout ? stdout : fopen(output_path, "w");
+    if (!out) {
+        perror(output_path);
+        for (size_t i = 0; i < st.count; i++) {
+            free(st.items[i].prompt);
+            free(st.items[i].id);
+            free(st.items[i].response);
+        }
+        free(st.items);
+        return -1;
+    }
+
+    if (concurrency < 1) concurrency = 1;
+    if (concurrency > BATCH_MAX_CONCURRENCY) concurrency = BATCH_MAX_CONCURRENCY;
+    if ((size_t)concurrency > st.count) concurrency = st.count > 0 ? (int)st.count : 1;
+
+    st.config = *config;
+    st.api_key = store->api_key;
+    st.share = http_share_create();
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+
+    fprintf(stderr, "📦 Lote: %zu solicitudes, %d en paralelo (modelo %s)\n",
+            st.count, concurrency, st.config.model);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t threads[BATCH_MAX_CONCURRENCY];
+    int started = 0;
+    for (int t = 0; t < concurrency && st.count > 0; t++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, &st) == 0) started++;
+    }
+    if (started == 0 && st.count > 0) {
+        // Sin hilos: procesar en el hilo principal
+        batch_worker(&st);
+    }
+
+    // Escribir en orden de entrada a medida que terminan
+    double *latencies = calloc(st.count ? st.count : 1, sizeof(double));
+    size_t measured = 0, failed = 0;
+    int write_ok = 1;
+    for (size_t i = 0; i < st.count; i++) {
+        BatchItem *item = &st.items[i];
+        pthread_mutex_lock(&st.lock);
+        while (!item->done) pthread_cond_wait(&st.cond, &st.lock);
+        pthread_mutex_unlock(&st.lock);
+
+        if (!write_result(out, i, item)) write_ok = 0;
+        if (item_ok(item)) {
+            if (latencies) latencies[measured++] = item->latency_ms;
+        } else {
+            failed++;
+        }
+        fprintf(stderr, "  [%zu/%zu] %s %ld  %.0f ms\n", i + 1, st.count,
+                item_ok(item) ? "✅" : "❌", item->status, item->latency_ms);
+
+        free(item->prompt);
+        free(item->id);
+        free(item->response);
+    }
+
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double total_ms = elapsed_ms(&start);
+
+    // Resumen: rendimiento agregado y distribución de latencias
+    double sum = 0.0;
+    for (size_t i = 0; i < measured; i++) sum += latencies[i];
+    if (latencies) qsort(latencies, measured, sizeof(double), compare_double);
+    fprintf(stderr, "📊 %zu correctas, %zu con error en %.2f s (%.2f solicitudes/s)\n",
+            st.count - failed, failed, total_ms / 1e3,
+            total_ms > 0 ? st.count / (total_ms / 1e3) : 0.0);
+    if (measured > 0) {
+        fprintf(stderr, "   Latencia: media %.0f ms, p50 %.0f ms, p95 %.0f ms, máx %.0f ms\n",
+                sum / measured, percentile(latencies, measured, 50),
+                percentile(latencies, measured, 95), latencies[measured - 1]);
+    }
+    if (!write_ok) fprintf(stderr, "Error: No se pudo escribir la salida del lote.\n");
+
+    free(latencies);
+    free(st.items);
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.cond);
+    http_share_destroy(st.share);
+    if (!to_stdout) fclose(out);
+
+    if (!write_ok) return -1;
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * batch.h - Modo por lotes: muchos prompts independientes en paralelo
+ * Cada línea de la entrada (JSONL) es una solicitud sin historial; varios hilos
+ * las envían sobre una caché de conexiones compartida y los resultados se
+ * escriben en el mismo orden que la entrada.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "../common/includes/config_manager.h"
+
+#define BATCH_DEFAULT_CONCURRENCY 4
+#define BATCH_MAX_CONCURRENCY 64
+
+// Procesa input_path y escribe los resultados en output_path (NULL o "-" = stdout).
+// Devuelve 0 si todas las solicitudes tuvieron éxito, 1 si alguna falló y -1 si
+// no se pudo leer la entrada o escribir la salida
+int run_batch(const char *input_path, const char *output_path, int concurrency,
+              GPTConfigStore *store);
+
+#endif /* BATCH_H */
@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../common/includes/buffer.h"
+#include "../common/includes/context.h"
+#include "../common/includes/context_window.h"
+#include "../common/includes/json_escape.h"
+#include "../common/includes/json_reader.h"
+#include "http_client.h"
+#include "openai.h"
+#include "compactor.h"
+#include "rate_limiter.h"
+
+#define SUMMARY_PREFIX "Resumen de la conversación anterior:\n"
+#define PREVIOUS_PREFIX "Resumen de la parte anterior:\n"
+#define CONTINUATION_PREFIX "\n\nContinuación de la conversación:\n"
+#define MESSAGE_OVERHEAD 4       // Tokens del "rol: " y el separador de cada mensaje
+#define SUMMARY_OVERHEAD 200     // Instrucciones y formato de cada petición
+#define MIN_CHUNK 1024           // Transcripción mínima por petición
+#define TRUNCATED_MARK "[…] "    // Prefijo de un mensaje recortado
+
+static const char *summary_instructions =
+    "Resume de forma concisa la conversación siguiente entre un usuario y un asistente "
+    "de terminal. Conserva los hechos que importen para continuarla: comandos ejecutados "
+    "y su resultado, archivos, particiones, paquetes instalados, configuraciones y "
+    "decisiones tomadas. Si se incluye el resumen de una parte anterior, intégralo en "
+    "el nuevo. Responde solo con el resumen.";
+
+// Tramo de la transcripción que cabe en una petición
+typedef struct {
+    Buffer text;                 // "rol: contenido" ya escapado para JSON
+    size_t tokens;
+} SummaryChunk;
+
+// Trabajo de compactación: todo lo que el hilo necesita, copiado al lanzarlo
+typedef struct {
+    SummaryChunk *chunks;        // Se resumen en orden, cada uno con el resumen del anterior
+    size_t chunk_count;
+    char auth_header[512];
+    long connect_ms;
+    long total_ms;
+    GPTConfig config;            // Para el límite de ritmo y los reintentos
+    unsigned long generation;    // Generación del almacén al tomar la instantánea
+    size_t count;                // Mensajes que sustituye el resumen
+} CompactJob;
+
+static pthread_t compact_thread;
+static int thread_started = 0;
+static volatile int compact_running = 0;
+static volatile int compact_cancel = 0;
+
+static void compact_job_free(CompactJob *job) {
+    for (size_t i = 0; i < job->chunk_count; i++) buffer_free(&job->chunks[i].text);
+    free(job->chunks);
+    free(job);
+}
+
+// Construye la petición del resumen de un tramo, precedido del resumen de los anteriores
+static int build_summary_request(Buffer *req, const GPTConfig *config, const char *previous,
+                                 const SummaryChunk *chunk) {
+    buffer_appendf(req, "{\n  \"model\": \"%s\",\n", config->model);
+    buffer_append_str(req, "  \"temperature\": 0.2,\n");
+    buffer_appendf(req, "  \"max_tokens\": %d,\n", config->max_tokens);
+    buffer_append_str(req, "  \"messages\": [\n    {\"role\": \"system\", \"content\": \"");
+    json_escape_append(req, summary_instructions, strlen(summary_instructions));
+    buffer_append_str(req, "\"},\n    {\"role\": \"user\", \"content\": \"");
+    if (previous) {
+        json_escape_append(req, PREVIOUS_PREFIX, strlen(PREVIOUS_PREFIX));
+        json_escape_append(req, previous, strlen(previous));
+        json_escape_append(req, CONTINUATION_PREFIX, strlen(CONTINUATION_PREFIX));
+    }
+    buffer_append(req, chunk->text.data, chunk->text.len);
+    return buffer_append_str(req, "\"}\n  ]\n}\n");
+}
+
+// Pide el resumen de un tramo; NULL si falló o llegó vacío
+static char* request_summary(HttpClient *http, const CompactJob *job, const char *previous,
+                             const SummaryChunk *chunk) {
+    Buffer req;
+    buffer_init(&req);
+    char *summary = NULL;
+    if (build_summary_request(&req, &job->config, previous, chunk)) {
+        const char *headers[] = { job->auth_header, "Content-Type: application/json", NULL };
+        // Para RATE_LIMIT_TPM: el tramo, el resumen anterior (como mucho una respuesta) y la respuesta
+        long tokens = (long)(chunk->tokens + SUMMARY_OVERHEAD) + job->config.max_tokens +
+                      (previous ? job->config.max_tokens : 0);
+        HttpResponse resp;
+        int ok = api_post(http, &job->config, OPENAI_CHAT_URL, headers, req.data, req.len,
+                          tokens, NULL, NULL, &resp);
+        if (ok && resp.status == 200) {
+            summary = json_get_string(resp.body.data, resp.body.len, "choices.0.message.content");
+        }
+        http_response_free(&resp);
+    }
+    buffer_free(&req);
+
+    if (summary && summary[0] == '\0') {
+        free(summary);
+        summary = NULL;
+    }
+    return summary;
+}
+
+static void* compact_worker(void *arg) {
+    CompactJob *job = arg;
+
+    HttpClient *http = http_client_create(job->connect_ms, job->total_ms);
+    if (http) {
+        http_client_set_cancel(http, &compact_cancel);
+
+        // Cada tramo se resume junto con el resumen de los anteriores
+        char *summary = NULL;
+        for (size_t i = 0; i < job->chunk_count && !compact_cancel; i++) {
+            char *next = request_summary(http, job, summary, &job->chunks[i]);
+            free(summary);
+            summary = next;
+            if (!summary) break;
+        }
+        if (summary && !compact_cancel) {
+            Buffer text;
+            buffer_init(&text);
+            buffer_append_str(&text, SUMMARY_PREFIX);
+            buffer_append_str(&text, summary);
+            if (text.data) context_compact(job->generation, job->count, text.data);
+            buffer_free(&text);
+        }
+
+        free(summary);
+        http_client_destroy(http);
+    }
+
+    compact_job_free(job);
+    __atomic_store_n(&compact_running, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Tokens de transcripción por petición: lo que cabe en CONTEXT_TOKENS (o, sin
+// límite, en COMPACT_TOKENS) tras las instrucciones, el resumen anterior y la respuesta
+static size_t chunk_budget(const GPTConfig *config) {
+    size_t window = config->context_tokens > 0 ? (size_t)config->context_tokens
+                                               : (size_t)config->compact_tokens;
+    size_t reply = config->max_tokens > 0 ? (size_t)config->max_tokens : 0;
+    size_t reserved = 2 * reply + SUMMARY_OVERHEAD;
+    return window > reserved + MIN_CHUNK ? window - reserved : MIN_CHUNK;
+}
+
+static SummaryChunk* add_chunk(CompactJob *job) {
+    SummaryChunk *chunks = realloc(job->chunks, (job->chunk_count + 1) * sizeof(SummaryChunk));
+    if (!chunks) return NULL;
+    job->chunks = chunks;
+    SummaryChunk *chunk = &chunks[job->chunk_count++];
+    buffer_init(&chunk->text);
+    chunk->tokens = 0;
+    return chunk;
+}
+
+// Copia la transcripción de los count mensajes más antiguos en tramos de como
+// mucho budget tokens; un mensaje que no cabe ni solo se recorta por el principio
+static int build_chunks(CompactJob *job, const Tokenizer *tok, size_t count, size_t budget) {
+    size_t mark_tokens = tokenizer_count(tok, TRUNCATED_MARK, strlen(TRUNCATED_MARK));
+    SummaryChunk *chunk = NULL;
+    int ok = 1;
+
+    // Copiada bajo el bloqueo del almacén
+    context_lock();
+    for (size_t i = 0; i < count && ok; i++) {
+        ContextMessage msg;
+        if (!context_get(i, &msg)) continue;
+
+        const char *text = msg.content;
+        size_t len = msg.content_len;
+        const char *mark = "";
+        size_t tokens = tokenizer_count(tok, text, len) + MESSAGE_OVERHEAD;
+        if (tokens > budget) {
+            size_t kept = 0;
+            size_t from = tokenizer_tail(tok, text, len, budget - MESSAGE_OVERHEAD - mark_tokens, &kept);
+            text += from;
+            len -= from;
+            mark = TRUNCATED_MARK;
+            tokens = kept + MESSAGE_OVERHEAD + mark_tokens;
+        }
+
+        if (!chunk || chunk->tokens + tokens > budget) {
+            chunk = add_chunk(job);
+            if (!chunk) {
+                ok = 0;
+                break;
+            }
+        }
+        buffer_appendf(&chunk->text, "%s: ", msg.role);
+        json_escape_append(&chunk->text, mark, strlen(mark));
+        json_escape_append(&chunk->text, text, len);
+        ok = buffer_append_str(&chunk->text, "\\n\\n");
+        chunk->tokens += tokens;
+    }
+    context_unlock();
+
+    return ok && job->chunk_count > 0;
+}
+
+void compactor_maybe_start(const GPTConfig *config, const char *api_key, const Tokenizer *tok) {
+    if (!config || config->compact_tokens <= 0 || !api_key || api_key[0] == '\0') return;
+    if (__atomic_load_n(&compact_running, __ATOMIC_ACQUIRE)) return;
+
+    // Recoger el hilo anterior, que ya terminó
+    if (thread_started) {
+        pthread_join(compact_thread, NULL);
+        thread_started = 0;
+    }
+
+    size_t messages = 0;
+    size_t tokens = context_window_history_tokens(tok, &messages);
+    size_t keep = config->compact_keep > 0 ? (size_t)config->compact_keep : 0;
+    if (tokens <= (size_t)config->compact_tokens || messages < keep + 2) return;
+
+    CompactJob *job = calloc(1, sizeof(CompactJob));
+    if (!job) return;
+
+    job->generation = context_generation();
+    job->count = messages - keep;
+    job->connect_ms = config->connect_timeout > 0 ? config->connect_timeout * 1000L : 0;
+    job->total_ms = config->request_timeout > 0 ? config->request_timeout * 1000L : 0;
+    snprintf(job->auth_header, sizeof(job->auth_header), "Authorization: Bearer %s", api_key);
+    job->config = *config;
+
+    if (!build_chunks(job, tok, job->count, chunk_budget(config))) {
+        compact_job_free(job);
+        return;
+    }
+
+    compact_cancel = 0;
+    __atomic_store_n(&compact_running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&compact_thread, NULL, compact_worker, job) != 0) {
+        __atomic_store_n(&compact_running, 0, __ATOMIC_RELEASE);
+        compact_job_free(job);
+        return;
+    }
+    thread_started = 1;
+}
+
+void compactor_shutdown(void) {
+    if (!thread_started) return;
+    compact_cancel = 1;
+    pthread_join(compact_thread, NULL);
+    thread_started = 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * compactor.h - Compactación de la conversación en segundo plano
+ * Cuando el historial supera COMPACT_TOKENS, un hilo pide al modelo un resumen
+ * de los turnos antiguos y los sustituye en el almacén (los originales se archivan).
+ */
+
+#ifndef COMPACTOR_H
+#define COMPACTOR_H
+
+#include "../common/includes/config_manager.h"
+#include "../common/includes/tokenizer.h"
+
+// Lanza la compactación si el historial supera el umbral y no hay otra en curso.
+// Nunca bloquea: la petición del resumen se hace en un hilo propio
+void compactor_maybe_start(const GPTConfig *config, const char *api_key, const Tokenizer *tok);
+
+// Cancela la compactación en curso (si la hay) y espera a que termine el hilo
+void compactor_shutdown(void);
+
+#endif /* COMPACTOR_H */
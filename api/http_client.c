@@ -0,0 +1,280 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <curl/curl.h>
+#include "../common/includes/metrics.h"
+#include "http_client.h"
+
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+
+static void curl_global_setup(void) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+struct HttpShare {
+    CURLSH *sh;
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+};
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)handle; (void)access;
+    HttpShare *share = userptr;
+    pthread_mutex_lock(&share->locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+    (void)handle;
+    HttpShare *share = userptr;
+    pthread_mutex_unlock(&share->locks[data]);
+}
+
+HttpShare* http_share_create(void) {
+    pthread_once(&curl_once, curl_global_setup);
+
+    HttpShare *share = calloc(1, sizeof(HttpShare));
+    if (!share) return NULL;
+
+    share->sh = curl_share_init();
+    if (!share->sh) {
+        free(share);
+        return NULL;
+    }
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&share->locks[i], NULL);
+    }
+
+    curl_share_setopt(share->sh, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share->sh, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share->sh, CURLSHOPT_USERDATA, share);
+    curl_share_setopt(share->sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(share->sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share->sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    return share;
+}
+
+void http_share_destroy(HttpShare *share) {
+    if (!share) return;
+    curl_share_cleanup(share->sh);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&share->locks[i]);
+    }
+    free(share);
+}
+
+void http_client_set_share(HttpClient *client, HttpShare *share) {
+    if (client) client->share = share;
+}
+
+// Estado de una transferencia en curso
+typedef struct {
+    CURL *curl;
+    HttpResponse *resp;
+    HttpDataCallback on_data;
+    void *userdata;
+} HttpTransfer;
+
+static size_t write_body(char *data, size_t size, size_t nmemb, void *userdata) {
+    HttpTransfer *xfer = userdata;
+    HttpResponse *resp = xfer->resp;
+    size_t n = size * nmemb;
+
+    if (xfer->on_data) {
+        if (resp->status == 0) {
+            curl_easy_getinfo(xfer->curl, CURLINFO_RESPONSE_CODE, &resp->status);
+        }
+        // Solo las respuestas correctas se entregan en streaming
+        if (resp->status >= 200 && resp->status < 300) {
+            return xfer->on_data(data, n, xfer->userdata) ? n : 0;
+        }
+    }
+
+    if (!buffer_append(&resp->body, data, n)) return 0;
+    return n;
+}
+
+static size_t write_header(char *data, size_t size, size_t nmemb, void *userdata) {
+    HttpResponse *resp = userdata;
+    size_t n = size * nmemb;
+
+    // Una nueva línea de estado (redirecciones, 100-continue) reinicia el bloque
+    if (n >= 5 && strncmp(data, "HTTP/", 5) == 0) {
+        buffer_clear(&resp->headers);
+    }
+    if (!buffer_append(&resp->headers, data, n)) return 0;
+    return n;
+}
+
+// Aborta la transferencia cuando se activa el indicador de cancelación
+static int check_cancel(void *userdata, curl_off_t dltotal, curl_off_t dlnow,
+                        curl_off_t ultotal, curl_off_t ulnow) {
+    (void)dltotal; (void)dlnow; (void)ultotal; (void)ulnow;
+    const HttpClient *client = userdata;
+    return *client->cancel ? 1 : 0;
+}
+
+// Reparte el tiempo de la transferencia en conexión, espera del primer byte y
+// recepción, y suma los bytes a los contadores
+static void record_transfer(CURL *curl, uint64_t start_ns, CURLcode rc) {
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    metrics_add(METRIC_HTTP_REQUESTS, 1);
+    if (rc != CURLE_OK || status < 200 || status >= 300) metrics_add(METRIC_HTTP_ERRORS, 1);
+    if (rc != CURLE_OK) return;
+
+    curl_off_t connect_us = 0, tls_us = 0, ttfb_us = 0, total_us = 0, up = 0, down = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect_us);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls_us);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb_us);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &up);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &down);
+    if (tls_us > connect_us) connect_us = tls_us;
+    if (ttfb_us < connect_us) ttfb_us = connect_us;
+    if (total_us < ttfb_us) total_us = ttfb_us;
+
+    metrics_span_at(METRIC_STAGE_CONNECT, start_ns, (uint64_t)connect_us * 1000);
+    metrics_span_at(METRIC_STAGE_TTFB, start_ns + (uint64_t)connect_us * 1000,
+                    (uint64_t)(ttfb_us - connect_us) * 1000);
+    metrics_span_at(METRIC_STAGE_TRANSFER, start_ns + (uint64_t)ttfb_us * 1000,
+                    (uint64_t)(total_us - ttfb_us) * 1000);
+    metrics_add(METRIC_BYTES_SENT, (uint64_t)up);
+    metrics_add(METRIC_BYTES_RECEIVED, (uint64_t)down);
+}
+
+HttpClient* http_client_create(long connect_timeout_ms, long timeout_ms) {
+    pthread_once(&curl_once, curl_global_setup);
+
+    HttpClient *client = calloc(1, sizeof(HttpClient));
+    if (!client) return NULL;
+
+    client->curl = curl_easy_init();
+    if (!client->curl) {
+        free(client);
+        return NULL;
+    }
+
+    http_client_set_timeouts(client, connect_timeout_ms, timeout_ms);
+    return client;
+}
+
+void http_client_set_timeouts(HttpClient *client, long connect_timeout_ms, long timeout_ms) {
+    if (!client) return;
+    client->connect_timeout_ms = connect_timeout_ms;
+    client->timeout_ms = timeout_ms;
+}
+
+void http_client_set_cancel(HttpClient *client, volatile int *cancel) {
+    if (client) client->cancel = cancel;
+}
+
+int http_client_post(HttpClient *client, const char *url, const char *const *headers,
+                     const char *body, size_t body_len, HttpResponse *resp) {
+    return http_client_post_stream(client, url, headers, body, body_len, NULL, NULL, resp);
+}
+
+int http_client_post_stream(HttpClient *client, const char *url, const char *const *headers,
+                            const char *body, size_t body_len,
+                            HttpDataCallback on_data, void *userdata, HttpResponse *resp) {
+    if (!client || !client->curl || !url || !resp) return 0;
+
+    memset(resp, 0, sizeof(HttpResponse));
+    CURL *curl = client->curl;
+    HttpTransfer xfer = { curl, resp, on_data, userdata };
+
+    // Reiniciar opciones conserva la caché de conexiones, DNS y sesiones TLS
+    curl_easy_reset(curl);
+
+    struct curl_slist *list = NULL;
+    for (int i = 0; headers && headers[i]; i++) {
+        list = curl_slist_append(list, headers[i]);
+    }
+    // Evitar el round-trip extra de "Expect: 100-continue" en cuerpos grandes
+    list = curl_slist_append(list, "Expect:");
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body_len);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_body);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &xfer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, resp);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, client->connect_timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, client->timeout_ms);
+    if (client->share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, ((HttpShare *)client->share)->sh);
+    }
+    if (client->cancel) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, check_cancel);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, client);
+    }
+
+    uint64_t start_ns = metrics_now();
+    CURLcode rc = curl_easy_perform(curl);
+    curl_slist_free_all(list);
+    record_transfer(curl, start_ns, rc);
+
+    if (rc != CURLE_OK) {
+        snprintf(resp->error, sizeof(resp->error), "%s", curl_easy_strerror(rc));
+        resp->timed_out = rc == CURLE_OPERATION_TIMEDOUT;
+        // Solo estos pueden salir bien al repetir; TLS, DNS o una URL mala no
+        resp->transient = rc == CURLE_COULDNT_CONNECT || rc == CURLE_SEND_ERROR ||
+                          rc == CURLE_RECV_ERROR || rc == CURLE_GOT_NOTHING;
+        return 0;
+    }
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &resp->status);
+    buffer_reserve(&resp->body, 0);
+    return 1;
+}
+
+char* http_response_header(const HttpResponse *resp, const char *name) {
+    if (!resp || !resp->headers.data || !name) return NULL;
+
+    size_t name_len = strlen(name);
+    const char *line = resp->headers.data;
+    while (*line) {
+        const char *eol = strchr(line, '\n');
+        if (!eol) eol = line + strlen(line);
+
+        if ((size_t)(eol - line) > name_len && line[name_len] == ':' &&
+            strncasecmp(line, name, name_len) == 0) {
+            const char *v = line + name_len + 1;
+            while (v < eol && isspace((unsigned char)*v)) v++;
+            const char *end = eol;
+            while (end > v && isspace((unsigned char)end[-1])) end--;
+
+            char *value = malloc(end - v + 1);
+            if (!value) return NULL;
+            memcpy(value, v, end - v);
+            value[end - v] = '\0';
+            return value;
+        }
+
+        line = *eol ? eol + 1 : eol;
+    }
+    return NULL;
+}
+
+void http_response_free(HttpResponse *resp) {
+    if (!resp) return;
+    buffer_free(&resp->headers);
+    buffer_free(&resp->body);
+    memset(resp, 0, sizeof(HttpResponse));
+}
+
+void http_client_destroy(HttpClient *client) {
+    if (!client) return;
+    if (client->curl) curl_easy_cleanup(client->curl);
+    free(client);
+}
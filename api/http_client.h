@@ -0,0 +1,76 @@
+/*
+ * http_client.h - Transporte HTTP embebido (libcurl) para la API de OpenAI
+ * Un HttpClient vive todo el proceso y reutiliza la conexión entre turnos
+ * (keep-alive), evitando el fork/exec de curl y el handshake DNS/TCP/TLS.
+ */
+
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <stddef.h>
+#include "../common/includes/buffer.h"
+
+// Respuesta HTTP con estado, cabeceras y cuerpo en memoria
+typedef struct {
+    long status;                 // Código HTTP (0 si no hubo respuesta)
+    Buffer headers;              // Bloque de cabeceras de la última respuesta
+    Buffer body;                 // Cuerpo de la respuesta (terminado en '\0')
+    char error[256];             // Mensaje de error de transporte (si lo hubo)
+    int timed_out;               // El error de transporte fue un timeout
+    int transient;               // Conexión rechazada o cortada, o fallo al enviar/recibir
+} HttpResponse;
+
+// Callback para recibir el cuerpo a medida que llega; devolver 0 aborta la transferencia
+typedef int (*HttpDataCallback)(const char *data, size_t len, void *userdata);
+
+// Cliente HTTP de larga duración (un handle de libcurl reutilizable)
+typedef struct {
+    void *curl;                  // CURL* (opaco para no exponer curl.h)
+    long connect_timeout_ms;     // Timeout de conexión
+    long timeout_ms;             // Timeout total de la petición (0 = sin límite)
+    volatile int *cancel;        // Si no es NULL y pasa a != 0, aborta la transferencia
+    void *share;                 // HttpShare* opcional (caché de conexiones compartida)
+} HttpClient;
+
+// Caché de conexiones, DNS y sesiones TLS compartida entre clientes de varios hilos
+typedef struct HttpShare HttpShare;
+
+// Crea un cliente con los timeouts indicados (en milisegundos)
+HttpClient* http_client_create(long connect_timeout_ms, long timeout_ms);
+
+// Crea una caché compartida para usar con http_client_set_share
+HttpShare* http_share_create(void);
+
+// Hace que el cliente use la caché compartida (NULL vuelve a la propia)
+void http_client_set_share(HttpClient *client, HttpShare *share);
+
+// Libera la caché compartida (después de destruir los clientes que la usan)
+void http_share_destroy(HttpShare *share);
+
+// Actualiza los timeouts de un cliente existente
+void http_client_set_timeouts(HttpClient *client, long connect_timeout_ms, long timeout_ms);
+
+// Asocia un indicador de cancelación (NULL lo quita); se comprueba durante la transferencia
+void http_client_set_cancel(HttpClient *client, volatile int *cancel);
+
+// Envía un POST; headers es un array de "Nombre: valor" terminado en NULL.
+// Devuelve 1 si hubo respuesta HTTP (cualquier código), 0 en error de transporte.
+int http_client_post(HttpClient *client, const char *url, const char *const *headers,
+                     const char *body, size_t body_len, HttpResponse *resp);
+
+// Igual que http_client_post, pero entrega el cuerpo de las respuestas 2xx a on_data
+// en cuanto llega (streaming). Los cuerpos de error se acumulan en resp->body.
+int http_client_post_stream(HttpClient *client, const char *url, const char *const *headers,
+                            const char *body, size_t body_len,
+                            HttpDataCallback on_data, void *userdata, HttpResponse *resp);
+
+// Busca una cabecera (sin distinguir mayúsculas) y devuelve una copia de su valor
+char* http_response_header(const HttpResponse *resp, const char *name);
+
+// Libera los buffers de una respuesta
+void http_response_free(HttpResponse *resp);
+
+// Libera el cliente y cierra sus conexiones
+void http_client_destroy(HttpClient *client);
+
+#endif /* HTTP_CLIENT_H */
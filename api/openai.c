@@ -3,298 +3,523 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
-#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 #include "../common/includes/utils.h"
 #include "../common/includes/config_manager.h" // Nueva inclusión
+#include "../common/includes/buffer.h"
+#include "../common/includes/json_reader.h"
+#include "../common/includes/json_escape.h"
+#include "../common/includes/utf8.h"
+#include "../common/includes/context.h"
+#include "../common/includes/context_window.h"
+#include "../common/includes/tokenizer.h"
+#include "../common/includes/response_cache.h"
+#include "../common/includes/sha256.h"
+#include "../common/includes/metrics.h"
+#include "http_client.h"
+#include "compactor.h"
+#include "rate_limiter.h"
+#include "openai.h"
 
-// Función para escapar caracteres especiales en JSON
-char* escape_json(const char* input) {
-    if (!input) return NULL;
-    
-    size_t input_len = strlen(input);
-    // Reservar espacio para el peor caso (todos los caracteres necesitan escape)
-    char* output = malloc(input_len * 6 + 1); // Aumentado para manejar casos de Unicode
-    if (!output) return NULL;
-    
-    size_t j = 0;
-    for (size_t i = 0; i < input_len; i++) {
-        unsigned char c = (unsigned char)input[i];
-        
-        // Verificar si es un carácter UTF-8 válido
-        if ((c & 0x80) == 0) {  // ASCII
-            switch (c) {
-                case '\"': // Comilla doble
-                    output[j++] = '\\';
-                    output[j++] = '\"';
-                    break;
-                case '\\': // Barra invertida
-                    output[j++] = '\\';
-                    output[j++] = '\\';
-                    break;
-                case '\b': // Retroceso
-                    output[j++] = '\\';
-                    output[j++] = 'b';
-                    break;
-                case '\f': // Avance de página
-                    output[j++] = '\\';
-                    output[j++] = 'f';
-                    break;
-                case '\n': // Nueva línea
-                    output[j++] = '\\';
-                    output[j++] = 'n';
-                    break;
-                case '\r': // Retorno de carro
-                    output[j++] = '\\';
-                    output[j++] = 'r';
-                    break;
-                case '\t': // Tabulación
-                    output[j++] = '\\';
-                    output[j++] = 't';
-                    break;
-                default:
-                    // Caracteres de control (ASCII 0-31)
-                    if (c < 32) {
-                        char hex[7];
-                        snprintf(hex, sizeof(hex), "\\u%04x", c);
-                        for (int k = 0; k < 6; k++) {
-                            output[j++] = hex[k];
-                        }
-                    } else {
-                        output[j++] = c;
-                    }
-                    break;
-            }
-        } else {
-            // Simplemente copiar caracteres UTF-8 tal cual
-            output[j++] = c;
-        }
+// Cliente HTTP de larga duración: reutiliza la conexión entre turnos
+static HttpClient *openai_http = NULL;
+
+static HttpClient* openai_http_client(const GPTConfig *config) {
+    long connect_ms = config->connect_timeout > 0 ? config->connect_timeout * 1000L : 0;
+    long total_ms = config->request_timeout > 0 ? config->request_timeout * 1000L : 0;
+
+    if (!openai_http) {
+        openai_http = http_client_create(connect_ms, total_ms);
+    } else {
+        http_client_set_timeouts(openai_http, connect_ms, total_ms);
     }
-    
-    output[j] = '\0';
-    return output;
+    return openai_http;
 }
 
-// Función modificada para usar GPTConfig
-char* send_prompt(const char *prompt, const char *config_file) {
-    // Inicializar la configuración con valores predeterminados
-    GPTConfig config;
-    config_init(&config);
-    
-    // Cargar configuración desde archivo
-    if (config_file && access(config_file, F_OK) == 0) {
-        if (!config_load_from_file(&config, config_file)) {
-            fprintf(stderr, "Advertencia: No se pudo cargar la configuración desde %s, usando valores por defecto\n", config_file);
-        }
+// Caché de respuestas (se abre al primer uso si CACHE lo permite)
+static ResponseCache *openai_cache = NULL;
+static pthread_mutex_t openai_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// La caché solo se usa con respuestas deterministas (TEMPERATURE=0) salvo CACHE=force
+static int cache_enabled(const GPTConfig *config) {
+    return config->cache == 2 || (config->cache == 1 && config->temperature <= 0.0f);
+}
+
+static ResponseCache* openai_response_cache(const GPTConfig *config) {
+    if (!cache_enabled(config)) return NULL;
+
+    // El modo por lotes la consulta desde varios hilos
+    size_t size_mb = config->cache_size_mb > 0 ? (size_t)config->cache_size_mb : 16;
+    pthread_mutex_lock(&openai_cache_lock);
+    if (!openai_cache) {
+        openai_cache = response_cache_open(RESPONSE_CACHE_FILE, size_mb);
+    } else if (response_cache_size_mb(openai_cache) != size_mb) {
+        response_cache_close(openai_cache);
+        openai_cache = response_cache_open(RESPONSE_CACHE_FILE, size_mb);
     }
-    
-    // Cargar rol desde archivo si está especificado
-    if (strlen(config.role_file) > 0) {
-        if (!config_load_role(&config)) {
-            fprintf(stderr, "Advertencia: No se pudo cargar la configuración desde %s, usando valores por defecto\n", config.role_file);
-        }
+    ResponseCache *cache = openai_cache;
+    pthread_mutex_unlock(&openai_cache_lock);
+    return cache;
+}
+
+// Clave de la caché: SHA-256 de modelo, temperatura, max_tokens y el array de mensajes
+// (que incluye el mensaje del sistema)
+static void request_key(const GPTConfig *config, const char *messages, size_t len,
+                        unsigned char key[SHA256_DIGEST_SIZE]) {
+    char params[96];
+    int n = snprintf(params, sizeof(params), "%.3f|%d|", config->temperature, config->max_tokens);
+
+    Sha256 ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, config->model, strlen(config->model) + 1);
+    sha256_update(&ctx, params, (size_t)n);
+    sha256_update(&ctx, messages, len);
+    sha256_final(&ctx, key);
+}
+
+void openai_print_cache_stats(GPTConfigStore *store) {
+    const GPTConfig *config = config_store_get(store);
+    if (!config || !cache_enabled(config)) {
+        printf("⚠️  Caché de respuestas desactivada (CACHE=off, o TEMPERATURE > 0 sin CACHE=force).\n\n");
+        return;
     }
-    
-    FILE *ctx = fopen("context.txt", "a");
-    if (ctx) {
-        fprintf(ctx, "user\t%s\n", prompt);
-        fclose(ctx);
+
+    ResponseCacheStats stats;
+    response_cache_stats(openai_response_cache(config), &stats);
+    printf("=== ⚡ Caché de respuestas ===\n");
+    printf("Entradas: %zu/%zu (%.1f MB, respuestas de hasta %zu bytes)\n",
+           stats.entries, stats.slots, stats.size_bytes / (1024.0 * 1024.0), stats.max_response);
+    printf("Aciertos: %lu  Fallos: %lu  (esta sesión: %lu/%lu)\n",
+           stats.hits, stats.misses, stats.session_hits, stats.session_misses);
+    printf("Guardadas: %lu  Reemplazadas: %lu  TTL: %ds\n\n",
+           stats.stores, stats.evictions, config->cache_ttl);
+}
+
+// Libera el cliente HTTP compartido, la caché y las tablas del tokenizador
+void openai_cleanup(void) {
+    compactor_shutdown();
+    http_client_destroy(openai_http);
+    openai_http = NULL;
+    response_cache_close(openai_cache);
+    openai_cache = NULL;
+    context_window_cleanup();
+    tokenizer_cleanup();
+}
+
+// Estado del parser de server-sent events de una respuesta en streaming
+typedef struct {
+    char line[65536];            // Línea SSE en curso
+    size_t line_len;
+    Buffer content;              // Texto completo acumulado
+    int done;                    // Se recibió "data: [DONE]"
+    uint64_t parse_ns;           // Tiempo acumulado extrayendo el texto de los eventos
+    PromptTokenCallback on_token;
+    void *userdata;
+} SSEState;
+
+static void sse_handle_line(SSEState *sse) {
+    if (strncmp(sse->line, "data:", 5) != 0) return;
+
+    const char *data = sse->line + 5;
+    while (*data == ' ') data++;
+    if (strcmp(data, "[DONE]") == 0) {
+        sse->done = 1;
+        return;
     }
 
-    FILE *rfile = fopen("req.json", "w");
-    if (!rfile) {
-        fprintf(stderr, "Error: No se pudo crear el archivo req.json\n");
-        return strdup("Error: No se pudo crear el archivo de solicitud.");
+    // Cada evento trae un fragmento en choices[0].delta.content
+    uint64_t t0 = metrics_now();
+    char *token = json_get_string(data, strlen(data), "choices.0.delta.content");
+    sse->parse_ns += metrics_now() - t0;
+    if (!token) return;
+
+    size_t len = strlen(token);
+    if (len > 0 && buffer_append(&sse->content, token, len) && sse->on_token) {
+        sse->on_token(token, len, sse->userdata);
     }
-    
-    // Escapar el prompt para JSON
-    char* escaped_prompt = escape_json(prompt);
-    if (!escaped_prompt) {
-        fprintf(stderr, "Error: No se pudo escapar el prompt.\n");
-        fclose(rfile);
-        return strdup("Error: Problemas de memoria al procesar la solicitud.");
+    free(token);
+}
+
+// Recibe bytes del transporte y los separa en líneas SSE
+static int sse_on_data(const char *data, size_t len, void *userdata) {
+    SSEState *sse = userdata;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            if (sse->line_len > 0 && sse->line[sse->line_len - 1] == '\r') sse->line_len--;
+            sse->line[sse->line_len] = '\0';
+            sse_handle_line(sse);
+            sse->line_len = 0;
+        } else if (sse->line_len < sizeof(sse->line) - 1) {
+            sse->line[sse->line_len++] = c;
+        }
     }
-    
-    // Comenzar a escribir el JSON con el modelo de la configuración
-    fprintf(rfile, "{\n  \"model\": \"%s\",\n", config.model);
-    fprintf(rfile, "  \"temperature\": %.1f,\n", config.temperature);
-    fprintf(rfile, "  \"max_tokens\": %d,\n", config.max_tokens);
-    fprintf(rfile, "  \"messages\": [\n");
-
-    // Agregar el rol del sistema de la configuración
-    char* escaped_content = escape_json(config.system_content);
-    if (escaped_content) {
-        fprintf(rfile, "    {\"role\": \"%s\", \"content\": \"%s\"},\n", 
-                config.system_role, escaped_content);
-        free(escaped_content);
+    return 1;
+}
+
+// Construye un mensaje de error legible a partir de una respuesta no 200
+static char* api_error_message(const char *body, int status_code) {
+    char error_msg[512];
+    char *message = body ? json_get_string(body, strlen(body), "error.message") : NULL;
+
+    if (message) {
+        snprintf(error_msg, sizeof(error_msg), "%.400s (HTTP %d)", message, status_code);
+        free(message);
+    } else {
+        snprintf(error_msg, sizeof(error_msg), "Error en la API de OpenAI (HTTP %d)", status_code);
     }
+    return strdup(error_msg);
+}
 
-    // Agregar el contexto previo (sin cambios)
-    // Agregar el contexto previo
-FILE *ctxin = fopen("context.txt", "r");
-if (ctxin) {
-    char line[2048];
-    int message_count = 0;
-    
-    while (fgets(line, sizeof(line), ctxin)) {
-        // Eliminar el salto de línea final
-        line[strcspn(line, "\r\n")] = 0;
-        
-        char role[16] = {0}, content[2000] = {0};
-        
-        // Usar un método más seguro para separar el rol y el contenido
-        char *tab = strchr(line, '\t');
-        if (tab) {
-            size_t role_len = tab - line;
-            if (role_len < sizeof(role)) {
-                strncpy(role, line, role_len);
-                role[role_len] = '\0';
-                
-                // Copiar el contenido después del tabulador
-                strncpy(content, tab + 1, sizeof(content) - 1);
-                
-                char* escaped_content = escape_json(content);
-                if (escaped_content) {
-                    fprintf(rfile, "    {\"role\": \"%s\", \"content\": \"%s\"},\n", 
-                            role, escaped_content);
-                    free(escaped_content);
-                    message_count++;
-                }
-            }
+// Añade {"role": ..., "content": ...} al array de mensajes de la solicitud
+static int append_message(Buffer *req, const char *role, const char *content, int *count) {
+    if (!content) return 0;
+    int ok = buffer_appendf(req, "%s\n    {\"role\": \"%s\", \"content\": \"",
+                            *count > 0 ? "," : "", role);
+
+    // Se escapa directamente sobre la solicitud, sin copia intermedia
+    uint64_t t0 = metrics_now();
+    ok = ok && json_escape_append(req, content, strlen(content));
+    metrics_span(METRIC_STAGE_ESCAPE, t0);
+
+    ok = ok && buffer_append_str(req, "\"}");
+    if (ok) (*count)++;
+    return ok;
+}
+
+static void print_window_stats(const ContextWindowStats *window) {
+    printf("📏 Contexto: %s%zu tokens", window->estimated ? "~" : "", window->tokens);
+    if (window->budget > 0) printf(" de %zu", window->budget);
+    printf(" (%zu mensajes", window->messages);
+    if (window->dropped > 0) printf(", %zu antiguos omitidos", window->dropped);
+    if (window->truncated) printf(", 1 recortado");
+    printf(")\n");
+}
+
+// Extrae choices[0].message.content de una respuesta completa
+static char* parse_completion(const HttpResponse *resp) {
+    uint64_t t0 = metrics_now();
+    char *content = json_get_string(resp->body.data, resp->body.len, "choices.0.message.content");
+    metrics_span(METRIC_STAGE_PARSE, t0);
+    return content;
+}
+
+// Guarda la respuesta en el contexto y compacta en segundo plano si el historial creció demasiado
+static void finish_turn(const GPTConfig *config, GPTConfigStore *store, const Tokenizer *tok,
+                        const char *response) {
+    metrics_add(METRIC_COMPLETION_TOKENS, tokenizer_count(tok, response, strlen(response)));
+    context_append("assistant", response);
+    compactor_maybe_start(config, store->api_key, tok);
+}
+
+// Función modificada para usar GPTConfig
+char* send_prompt(const char *prompt, GPTConfigStore *store) {
+    return send_prompt_stream(prompt, store, NULL, NULL);
+}
+
+char* send_prompt_stream(const char *prompt, GPTConfigStore *store,
+                         PromptTokenCallback on_token, void *userdata) {
+    return send_prompt_cancellable(prompt, store, on_token, userdata, NULL);
+}
+
+static char* run_turn(const char *prompt, GPTConfigStore *store,
+                      PromptTokenCallback on_token, void *userdata, volatile int *cancel,
+                      int *success);
+
+// Envía el prompt; con STREAM=true los fragmentos se entregan a on_token al llegar.
+// Toda la solicitud y la respuesta viven en memoria: solo se escribe el almacén de contexto.
+char* send_prompt_cancellable(const char *prompt, GPTConfigStore *store,
+                              PromptTokenCallback on_token, void *userdata,
+                              volatile int *cancel) {
+    uint64_t t0 = metrics_now();
+
+    // El prompt viene del terminal tal cual: se repara antes de que entre en el JSON
+    char *fixed = NULL;
+    if (prompt && !utf8_is_valid(prompt, strlen(prompt))) {
+        fixed = strdup(prompt);
+        if (fixed) {
+            utf8_sanitize(&fixed);
+            prompt = fixed;
         }
     }
-    fclose(ctxin);
-    
-    // El resto del código sigue igual...
-        
-        // Si no hay mensajes en el contexto, agregar solo el prompt actual
-        if (message_count == 0) {
-            fprintf(rfile, "    {\"role\": \"user\", \"content\": \"%s\"}\n", escaped_prompt);
-        } else {
-            // Eliminar la última coma
-            fseek(rfile, -2, SEEK_CUR);
-            fprintf(rfile, "\n");
-        }
-    } else {
-        // Si no hay contexto, agregar solo el prompt actual
-        fprintf(rfile, "    {\"role\": \"user\", \"content\": \"%s\"}\n", escaped_prompt);
+    // El historial que se envía ya incluye el prompt. Un turno fallido o cancelado
+    // lo retira: si no, la siguiente solicitud llevaría dos turnos de usuario seguidos
+    int stored = prompt && context_append("user", prompt);
+    int success = 0;
+    char *response = run_turn(prompt, store, on_token, userdata, cancel, &success);
+    if (!success && stored) context_drop_last("user", prompt);
+    free(fixed);
+    metrics_span(METRIC_STAGE_TURN, t0);
+    metrics_add(METRIC_TURNS, 1);
+    return response;
+}
+
+static char* run_turn_with(const GPTConfig *config, const Tokenizer *tok, const char *prompt,
+                           GPTConfigStore *store, PromptTokenCallback on_token, void *userdata,
+                           volatile int *cancel, int *success) {
+    // Construir el JSON de la solicitud en memoria
+    Buffer req;
+    buffer_init(&req);
+    int streaming = config->stream && on_token;
+
+    buffer_appendf(&req, "{\n  \"model\": \"%s\",\n", config->model);
+    buffer_appendf(&req, "  \"temperature\": %.1f,\n", config->temperature);
+    buffer_appendf(&req, "  \"max_tokens\": %d,\n", config->max_tokens);
+    if (streaming) {
+        buffer_append_str(&req, "  \"stream\": true,\n");
+    }
+    buffer_append_str(&req, "  \"messages\": [");
+    size_t messages_start = req.len;
+
+    // Agregar el sistema y el historial que cabe en CONTEXT_TOKENS; cada
+    // mensaje guardado ya está escapado en el almacén
+    size_t budget = config->context_tokens > 0 ? (size_t)config->context_tokens : 0;
+    ContextWindowStats window;
+    uint64_t t0 = metrics_now();
+    int message_count = context_window_append(&req, tok, budget, config->system_role,
+                                              config->system_content, &window);
+    metrics_span(METRIC_STAGE_CONTEXT, t0);
+
+    // Si no hay contexto, agregar solo el prompt actual
+    if (window.messages == 0 && window.dropped == 0) {
+        append_message(&req, "user", prompt, &message_count);
+        window.tokens += tokenizer_count(tok, prompt, strlen(prompt));
     }
     
-    free(escaped_prompt);
-    
+    size_t messages_end = req.len;
+
     // Cerrar el JSON
-    fprintf(rfile, "  ]\n}\n");
-    fclose(rfile);
-    
-    // Enviar la solicitud
-    char cmd[1024];
+    if (!buffer_append_str(&req, "\n  ]\n}\n")) {
+        buffer_free(&req);
+        return strdup("Error: Problemas de memoria al procesar la solicitud.");
+    }
+
+    // Responder desde la caché si esta misma solicitud ya se hizo
+    ResponseCache *cache = openai_response_cache(config);
+    unsigned char cache_key[SHA256_DIGEST_SIZE];
+    if (cache) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        request_key(config, req.data + messages_start, messages_end - messages_start, cache_key);
+        char *cached = response_cache_get(cache, cache_key, config->cache_ttl);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        if (cached) {
+            buffer_free(&req);
+            double us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+            print_window_stats(&window);
+            printf("⚡ Respuesta desde la caché (%.0f µs)\n", us);
+            if (streaming) on_token(cached, strlen(cached), userdata);
+            metrics_add(METRIC_CACHE_HITS, 1);
+            finish_turn(config, store, tok, cached);
+            *success = 1;
+            return cached;
+        }
+    }
     
-    // Obtener la clave API usando la configuración
-    char *api_key = config_get_api_key(&config);
-    if (!api_key) {
+    // La clave API se leyó al cargar la configuración
+    if (strlen(store->api_key) == 0) {
+        buffer_free(&req);
         return strdup("Error: No se pudo obtener la clave API.");
     }
 
-    snprintf(cmd, sizeof(cmd),
-        "curl -s -w \"\\nHTTP_STATUS:%%{http_code}\" https://api.openai.com/v1/chat/completions "
-        "-H \"Authorization: Bearer %s\" "
-        "-H \"Content-Type: application/json\" "
-        "--data @req.json > resp.json", api_key);
+    char auth_header[512];
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", store->api_key);
 
-    free(api_key);
-    
-    // Ejecutar la solicitud
-    printf("Enviando solicitud a OpenAI con el modelo %s...\n", config.model);
-    system(cmd);
-    
-    // Verificar código de estado HTTP y procesar respuesta
-    // [resto del código sin cambios]
-    
-    FILE *resp = fopen("resp.json", "r");
-    if (!resp) {
-        return strdup("Error: No se pudo obtener respuesta de la API.");
+    const char *headers[] = {
+        auth_header,
+        "Content-Type: application/json",
+        NULL
+    };
+
+    HttpClient *http = openai_http_client(config);
+    if (!http) {
+        buffer_free(&req);
+        return strdup("Error: No se pudo inicializar el cliente HTTP.");
     }
-    
-    // Buscar el código de estado HTTP
-    char buffer[16384] = {0};
-    size_t bytes_read = fread(buffer, 1, sizeof(buffer) - 1, resp);
-    fclose(resp);
-    
-    if (bytes_read == 0) {
-        return strdup("Error: Respuesta vacía de la API.");
+
+    // Ejecutar la solicitud (con límite de ritmo y reintentos); cuenta para
+    // RATE_LIMIT_TPM lo enviado más lo que puede generar la respuesta
+    printf("Enviando solicitud a OpenAI con el modelo %s...\n", config->model);
+    print_window_stats(&window);
+    long tokens = (long)window.tokens + config->max_tokens;
+    metrics_add(METRIC_PROMPT_TOKENS, window.tokens);
+    http_client_set_cancel(http, cancel);
+    HttpResponse http_resp;
+    SSEState *sse = NULL;
+    int ok;
+    if (streaming) {
+        sse = calloc(1, sizeof(SSEState));
+        if (!sse) {
+            http_client_set_cancel(http, NULL);
+            buffer_free(&req);
+            return strdup("Error: Problemas de memoria al procesar la solicitud.");
+        }
+        sse->on_token = on_token;
+        sse->userdata = userdata;
+        ok = api_post(http, config, OPENAI_CHAT_URL, headers, req.data, req.len, tokens,
+                      sse_on_data, sse, &http_resp);
+    } else {
+        ok = api_post(http, config, OPENAI_CHAT_URL, headers, req.data, req.len, tokens,
+                      NULL, NULL, &http_resp);
     }
-    
-    char *status_marker = strstr(buffer, "HTTP_STATUS:");
-    if (status_marker) {
-        int status_code = atoi(status_marker + 12);
-        *status_marker = '\0'; // Truncar el buffer al marcador de estado
-        
-        if (status_code != 200) {
-            // Si el código no es 200, intentar extraer el mensaje de error
-            char error_msg[512] = "Error en la API de OpenAI";
-            
-            // Buscar mensaje de error en el JSON
-            char *error_json = buffer;
-            char *error_msg_start = strstr(error_json, "\"message\"");
-            if (error_msg_start) {
-                error_msg_start = strchr(error_msg_start, ':');
-                if (error_msg_start) {
-                    error_msg_start++; // Saltar los dos puntos
-                    while (isspace((unsigned char)*error_msg_start)) error_msg_start++; // Saltar espacios
-                    if (*error_msg_start == '\"') error_msg_start++; // Saltar comilla inicial
-                    
-                    char *error_msg_end = strchr(error_msg_start, '\"');
-                    if (error_msg_end) {
-                        size_t len = error_msg_end - error_msg_start;
-                        if (len > sizeof(error_msg) - 20) len = sizeof(error_msg) - 20;
-                        strncpy(error_msg, error_msg_start, len);
-                        error_msg[len] = '\0';
-                        sprintf(error_msg + strlen(error_msg), " (HTTP %d)", status_code);
-                    } else {
-                        sprintf(error_msg, "Error en la API de OpenAI (HTTP %d)", status_code);
-                    }
-                }
-            } else {
-                sprintf(error_msg, "Error en la API de OpenAI (HTTP %d)", status_code);
-            }
-            
-            return strdup(error_msg);
+    http_client_set_cancel(http, NULL);
+    buffer_free(&req);
+    if (sse) metrics_observe(METRIC_STAGE_PARSE, sse->parse_ns);
+
+    char *response = NULL;
+    if (!ok && cancel && *cancel) {
+        response = strdup("Error: Solicitud cancelada.");
+    } else if (!ok) {
+        char error_msg[512];
+        snprintf(error_msg, sizeof(error_msg), "Error: No se pudo conectar con la API (%s).", http_resp.error);
+        response = strdup(error_msg);
+    } else if (http_resp.status != 200) {
+        response = api_error_message(http_resp.body.data, (int)http_resp.status);
+    } else if (sse) {
+        // El texto ya se mostró por partes; se conserva completo para el contexto
+        if (sse->content.len > 0) response = buffer_detach(&sse->content);
+    } else if (http_resp.body.len > 0) {
+        response = parse_completion(&http_resp);
+    }
+
+    // \uD800 sueltos y similares se decodifican como bytes inválidos
+    if (response) utf8_sanitize(&response);
+
+    *success = ok && http_resp.status == 200 && response != NULL;
+    if (!response) {
+        if (http_resp.body.data && strstr(http_resp.body.data, "\"error\"")) {
+            response = strdup("Error: La API de OpenAI devolvió un error.");
+        } else {
+            response = strdup("Error: Respuesta vacía de la API. Posible error en el formato JSON.");
         }
     }
-    
-    // Extraer el contenido de la respuesta with jq
-    system("sed '/^HTTP_STATUS/d' resp.json > resp_clean.json && cat resp_clean.json | jq -r '.choices[0].message.content' | iconv -f UTF-8 -t UTF-8//IGNORE > out.txt 2>/dev/null || echo 'Error al procesar la respuesta' > out.txt");    if (system("which jq > /dev/null 2>&1") != 0) {
-        return strdup("Error: No se pudo procesar la respuesta. Por favor instala 'jq' (sudo apt install jq).");
+
+    http_response_free(&http_resp);
+    if (sse) buffer_free(&sse->content);
+    free(sse);
+
+    // Guardar la respuesta en el contexto
+    if (*success) {
+        if (cache) response_cache_put(cache, cache_key, config->cache_ttl, response, strlen(response));
+        finish_turn(config, store, tok, response);
     }
     
-    FILE *r = fopen("out.txt", "r");
-    if (!r) {
-        return strdup("Error: No se pudo leer la respuesta procesada.");
+    return response;
+}
+
+static char* run_turn(const char *prompt, GPTConfigStore *store,
+                      PromptTokenCallback on_token, void *userdata, volatile int *cancel,
+                      int *success) {
+    // Configuración ya cargada en memoria (se recarga sola si cambia en disco)
+    uint64_t t0 = metrics_now();
+    const GPTConfig *config = config_store_get(store);
+    metrics_span(METRIC_STAGE_CONFIG, t0);
+    if (!config) {
+        return strdup("Error: Configuración no disponible.");
     }
-    
-    char response[8192] = {0};
-    bytes_read = fread(response, 1, sizeof(response) - 1, r);
-    fclose(r);
-    
-    if (bytes_read == 0) {
-        // Si no hay contenido, revisar si hay un error en el JSON
-        FILE *err_check = fopen("resp.json", "r");
-        char err_buffer[1024] = {0};
-        fread(err_buffer, 1, sizeof(err_buffer) - 1, err_check);
-        fclose(err_check);
-        
-        if (strstr(err_buffer, "\"error\"")) {
-            return strdup("Error: La API de OpenAI devolvió un error. Verifica el archivo resp.json para más detalles.");
+
+    // Las tablas siguen siendo válidas durante todo el turno aunque se recargue
+    // TOKENIZER_FILE desde otro hilo
+    const Tokenizer *tok = tokenizer_acquire(config->tokenizer_file);
+    char *response = run_turn_with(config, tok, prompt, store, on_token, userdata, cancel, success);
+    tokenizer_release(tok);
+    return response;
+}
+
+static char* complete_request(HttpClient *http, const GPTConfig *config, const char *api_key,
+                              const char *prompt, long *status);
+
+// Solicitud independiente (sistema + prompt, sin historial ni streaming) con el
+// cliente HTTP del llamador; la usa el modo por lotes desde varios hilos
+char* openai_complete(HttpClient *http, const GPTConfig *config, const char *api_key,
+                      const char *prompt, long *status) {
+    uint64_t t0 = metrics_now();
+    char *response = complete_request(http, config, api_key, prompt, status);
+    metrics_span(METRIC_STAGE_TURN, t0);
+    metrics_add(METRIC_TURNS, 1);
+    return response;
+}
+
+static char* complete_request(HttpClient *http, const GPTConfig *config, const char *api_key,
+                              const char *prompt, long *status) {
+    if (status) *status = 0;
+
+    Buffer req;
+    buffer_init(&req);
+    buffer_appendf(&req, "{\n  \"model\": \"%s\",\n", config->model);
+    buffer_appendf(&req, "  \"temperature\": %.1f,\n", config->temperature);
+    buffer_appendf(&req, "  \"max_tokens\": %d,\n", config->max_tokens);
+    buffer_append_str(&req, "  \"messages\": [");
+    size_t messages_start = req.len;
+
+    int message_count = 0;
+    append_message(&req, config->system_role, config->system_content, &message_count);
+    append_message(&req, "user", prompt, &message_count);
+    size_t messages_end = req.len;
+
+    if (message_count != 2 || !buffer_append_str(&req, "\n  ]\n}\n")) {
+        buffer_free(&req);
+        return strdup("Error: Problemas de memoria al procesar la solicitud.");
+    }
+
+    ResponseCache *cache = openai_response_cache(config);
+    unsigned char cache_key[SHA256_DIGEST_SIZE];
+    if (cache) {
+        request_key(config, req.data + messages_start, messages_end - messages_start, cache_key);
+        char *cached = response_cache_get(cache, cache_key, config->cache_ttl);
+        if (cached) {
+            buffer_free(&req);
+            metrics_add(METRIC_CACHE_HITS, 1);
+            if (status) *status = 200;
+            return cached;
         }
-        return strdup("Error: Respuesta vacía de la API. Posible error en el formato JSON.");
     }
-    
-    // Guardar la respuesta en el contexto
-    ctx = fopen("context.txt", "a");
-    if (ctx) {
-        fprintf(ctx, "assistant\t%s\n", response);
-        fclose(ctx);
+
+    if (!api_key || strlen(api_key) == 0) {
+        buffer_free(&req);
+        return strdup("Error: No se pudo obtener la clave API.");
     }
-    
-    return strdup(response);
-}
\ No newline at end of file
+
+    char auth_header[512];
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", api_key);
+    const char *headers[] = {
+        auth_header,
+        "Content-Type: application/json",
+        NULL
+    };
+
+    long tokens = (long)tokenizer_count(NULL, config->system_content, strlen(config->system_content)) +
+                  (long)tokenizer_count(NULL, prompt, strlen(prompt));
+    metrics_add(METRIC_PROMPT_TOKENS, (uint64_t)tokens);
+    tokens += config->max_tokens;
+    HttpResponse http_resp;
+    int ok = api_post(http, config, OPENAI_CHAT_URL, headers, req.data, req.len, tokens,
+                      NULL, NULL, &http_resp);
+    buffer_free(&req);
+
+    char *response = NULL;
+    if (!ok) {
+        char error_msg[512];
+        snprintf(error_msg, sizeof(error_msg), "Error: No se pudo conectar con la API (%s).", http_resp.error);
+        response = strdup(error_msg);
+    } else if (http_resp.status != 200) {
+        response = api_error_message(http_resp.body.data, (int)http_resp.status);
+    } else if (http_resp.body.len > 0) {
+        response = parse_completion(&http_resp);
+    }
+    if (status) *status = ok ? http_resp.status : 0;
+
+    if (response && ok && http_resp.status == 200) {
+        metrics_add(METRIC_COMPLETION_TOKENS, tokenizer_count(NULL, response, strlen(response)));
+        if (cache) response_cache_put(cache, cache_key, config->cache_ttl, response, strlen(response));
+    } else if (!response) {
+        if (status && *status == 200) *status = 0;
+        response = strdup("Error: Respuesta vacía de la API. Posible error en el formato JSON.");
+    }
+
+    http_response_free(&http_resp);
+    return response;
+}
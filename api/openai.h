@@ -1,7 +1,43 @@
 #ifndef OPENAI_H
 #define OPENAI_H
 
-// Función para enviar un prompt a la API de OpenAI
-char* send_prompt(const char* prompt, const char* config_file);
+#include <stddef.h>
+#include "../common/includes/config_manager.h"
+#include "http_client.h"
+
+#ifndef OPENAI_CHAT_URL
+#define OPENAI_CHAT_URL "https://api.openai.com/v1/chat/completions"
+#endif
+
+// Callback que recibe cada fragmento de texto de una respuesta en streaming
+typedef void (*PromptTokenCallback)(const char* token, size_t len, void* userdata);
+
+// Función para enviar un prompt a la API de OpenAI con la configuración del proceso
+char* send_prompt(const char* prompt, GPTConfigStore* config);
+
+// Igual que send_prompt; si el módulo tiene STREAM=true, cada fragmento se
+// entrega a on_token en cuanto llega. Devuelve siempre el texto completo.
+char* send_prompt_stream(const char* prompt, GPTConfigStore* config,
+                         PromptTokenCallback on_token, void* userdata);
+
+// Igual que send_prompt_stream; si cancel pasa a != 0 se aborta la transferencia
+// y se devuelve "Error: Solicitud cancelada.". Si el turno se cancela o falla,
+// el mensaje del usuario se retira del contexto: no queda nada guardado
+char* send_prompt_cancellable(const char* prompt, GPTConfigStore* config,
+                              PromptTokenCallback on_token, void* userdata,
+                              volatile int* cancel);
+
+// Envía prompt como solicitud independiente (mensaje del sistema + prompt, sin
+// historial) por el cliente http indicado. Usa la caché de respuestas si está
+// activa. *status recibe el código HTTP (200 si hubo respuesta válida, 0 si falló
+// el transporte). Devuelve siempre un texto (liberar con free)
+char* openai_complete(HttpClient* http, const GPTConfig* config, const char* api_key,
+                      const char* prompt, long* status);
+
+// Muestra los contadores de la caché de respuestas (comando /cache)
+void openai_print_cache_stats(GPTConfigStore* config);
+
+// Libera el cliente HTTP persistente y las cachés de tokens (llamar al salir)
+void openai_cleanup(void);
 
 #endif /* OPENAI_H */
\ No newline at end of file
@@ -0,0 +1,282 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "rate_limiter.h"
+
+#define RETRY_BASE_MS 500        // Primera espera entre reintentos
+#define RETRY_MAX_MS 60000       // Espera máxima; si Retry-After pide más, no se reintenta
+#define WAIT_SLICE_MS 100        // Granularidad de las esperas (para poder cancelar)
+#define BURST_SECONDS 10         // Ráfaga máxima: lo que se rellena en este tiempo
+
+// Cubeta de fichas que se rellena de forma continua a capacity por minuto.
+// El nivel puede quedar negativo: una petición grande se cobra entera y las
+// siguientes esperan a que se recupere
+typedef struct {
+    double level;                // Fichas disponibles
+    long capacity;               // Fichas por minuto (0 = sin límite)
+    double burst;                // Nivel máximo
+} Bucket;
+
+// Estado compartido por todos los hilos del proceso
+static struct {
+    pthread_mutex_t lock;
+    Bucket requests;
+    Bucket tokens;
+    int64_t last_refill_ms;
+    int64_t paused_until_ms;     // Pausa global tras un 429 o con los restantes agotados
+    uint64_t seed;
+} limiter = { PTHREAD_MUTEX_INITIALIZER, { 0, 0, 0 }, { 0, 0, 0 }, 0, 0, 0 };
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void bucket_configure(Bucket *b, long capacity) {
+    if (capacity < 0) capacity = 0;
+    if (b->capacity == capacity) return;
+
+    double burst = (double)capacity * BURST_SECONDS / 60.0;
+    if (burst < 1.0) burst = 1.0;
+    // Al activar el límite se empieza con la cubeta llena
+    if (b->capacity == 0 || b->level > burst) b->level = burst;
+    b->capacity = capacity;
+    b->burst = burst;
+}
+
+static void bucket_refill(Bucket *b, int64_t elapsed_ms) {
+    if (b->capacity == 0) return;
+    b->level += (double)b->capacity * elapsed_ms / 60000.0;
+    if (b->level > b->burst) b->level = b->burst;
+}
+
+// Milisegundos hasta que haya need fichas
+static int64_t bucket_wait_ms(const Bucket *b, double need) {
+    if (b->capacity == 0 || b->level >= need) return 0;
+    return (int64_t)((need - b->level) * 60000.0 / b->capacity) + 1;
+}
+
+// Número pseudoaleatorio (xorshift) para el jitter; llamar con el bloqueo tomado
+static uint64_t next_random(void) {
+    if (limiter.seed == 0) limiter.seed = (uint64_t)now_ms() * 2654435761u ^ (uint64_t)getpid();
+    limiter.seed ^= limiter.seed << 13;
+    limiter.seed ^= limiter.seed >> 7;
+    limiter.seed ^= limiter.seed << 17;
+    return limiter.seed;
+}
+
+// Duerme ms en tramos cortos; devuelve 0 si se canceló
+static int sleep_ms(int64_t ms, volatile int *cancel) {
+    while (ms > 0) {
+        if (cancel && *cancel) return 0;
+        int64_t slice = ms < WAIT_SLICE_MS ? ms : WAIT_SLICE_MS;
+        struct timespec ts = { slice / 1000, (slice % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+        ms -= slice;
+    }
+    return !(cancel && *cancel);
+}
+
+int rate_limiter_acquire(const GPTConfig *config, long tokens, volatile int *cancel) {
+    while (1) {
+        pthread_mutex_lock(&limiter.lock);
+        int64_t now = now_ms();
+        bucket_configure(&limiter.requests, config->rate_limit_rpm);
+        bucket_configure(&limiter.tokens, config->rate_limit_tpm);
+        if (limiter.last_refill_ms > 0) {
+            bucket_refill(&limiter.requests, now - limiter.last_refill_ms);
+            bucket_refill(&limiter.tokens, now - limiter.last_refill_ms);
+        }
+        limiter.last_refill_ms = now;
+
+        // Una petición mayor que la ráfaga solo espera a tenerla llena
+        double cost = tokens > 0 ? (double)tokens : 0.0;
+        double need = cost < limiter.tokens.burst ? cost : limiter.tokens.burst;
+
+        int64_t wait = limiter.paused_until_ms > now ? limiter.paused_until_ms - now : 0;
+        int64_t w = bucket_wait_ms(&limiter.requests, 1.0);
+        if (w > wait) wait = w;
+        w = bucket_wait_ms(&limiter.tokens, need);
+        if (w > wait) wait = w;
+
+        if (wait == 0) {
+            if (limiter.requests.capacity > 0) limiter.requests.level -= 1.0;
+            if (limiter.tokens.capacity > 0) limiter.tokens.level -= cost;
+            pthread_mutex_unlock(&limiter.lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&limiter.lock);
+
+        if (!sleep_ms(wait, cancel)) return 0;
+    }
+}
+
+// Interpreta duraciones como "20ms", "1.5s", "6m0s" o "1h2m3s"; -1 si no es válida
+static int64_t parse_duration_ms(const char *s) {
+    if (!s || !*s) return -1;
+
+    double total = 0.0;
+    const char *p = s;
+    while (*p) {
+        char *end;
+        double v = strtod(p, &end);
+        if (end == p) return -1;
+        p = end;
+        if (strncmp(p, "ms", 2) == 0) { total += v; p += 2; }
+        else if (*p == 'h') { total += v * 3600000.0; p++; }
+        else if (*p == 'm') { total += v * 60000.0; p++; }
+        else if (*p == 's' || *p == '\0') { total += v * 1000.0; if (*p) p++; }
+        else return -1;
+    }
+    return (int64_t)(total + 0.5);
+}
+
+// Lee la cabecera name como número; -1 si no está
+static double header_number(const HttpResponse *resp, const char *name) {
+    char *value = http_response_header(resp, name);
+    if (!value) return -1;
+    char *end;
+    double n = strtod(value, &end);
+    int valid = end != value;
+    free(value);
+    return valid ? n : -1;
+}
+
+static int64_t header_duration_ms(const HttpResponse *resp, const char *name) {
+    char *value = http_response_header(resp, name);
+    int64_t ms = parse_duration_ms(value);
+    free(value);
+    return ms;
+}
+
+// Limita la cubeta a lo que la API dice que queda y pausa hasta el reinicio si se agotó
+static void observe_bucket(Bucket *b, double remaining, int64_t reset_ms, int64_t now) {
+    if (remaining < 0) return;
+    if (b->capacity > 0 && b->level > remaining) b->level = remaining;
+    if (remaining < 1 && reset_ms > 0 && now + reset_ms > limiter.paused_until_ms) {
+        limiter.paused_until_ms = now + reset_ms;
+    }
+}
+
+void rate_limiter_observe(const HttpResponse *resp) {
+    if (!resp || resp->status == 0) return;
+
+    double remaining_requests = header_number(resp, "x-ratelimit-remaining-requests");
+    double remaining_tokens = header_number(resp, "x-ratelimit-remaining-tokens");
+    if (remaining_requests < 0 && remaining_tokens < 0) return;
+    int64_t reset_requests = header_duration_ms(resp, "x-ratelimit-reset-requests");
+    int64_t reset_tokens = header_duration_ms(resp, "x-ratelimit-reset-tokens");
+
+    pthread_mutex_lock(&limiter.lock);
+    int64_t now = now_ms();
+    observe_bucket(&limiter.requests, remaining_requests, reset_requests, now);
+    observe_bucket(&limiter.tokens, remaining_tokens, reset_tokens, now);
+    pthread_mutex_unlock(&limiter.lock);
+}
+
+// Espera pedida por el servidor (retry-after-ms o Retry-After en segundos); -1 si no la hay
+static int64_t retry_after_ms(const HttpResponse *resp) {
+    double ms = header_number(resp, "retry-after-ms");
+    if (ms >= 0) return (int64_t)ms;
+    double seconds = header_number(resp, "retry-after");
+    if (seconds >= 0) return (int64_t)(seconds * 1000.0);
+    return -1;
+}
+
+// Espera exponencial con jitter: entre la mitad y el total de base * 2^attempt
+static int64_t backoff_ms(int attempt) {
+    int64_t exp = RETRY_BASE_MS;
+    for (int i = 0; i < attempt && exp < RETRY_MAX_MS; i++) exp *= 2;
+    if (exp > RETRY_MAX_MS) exp = RETRY_MAX_MS;
+
+    pthread_mutex_lock(&limiter.lock);
+    int64_t delay = exp / 2 + (int64_t)(next_random() % (uint64_t)(exp / 2 + 1));
+    pthread_mutex_unlock(&limiter.lock);
+    return delay;
+}
+
+// Se repiten los cortes de conexión y los 429/5xx; un timeout, un error de TLS o
+// de DNS y el resto de códigos darían lo mismo otra vez
+static int should_retry(int ok, const HttpResponse *resp) {
+    if (!ok) return resp->transient;
+    if (resp->status == 429) {
+        // Sin saldo no sirve de nada reintentar
+        return !(resp->body.data && strstr(resp->body.data, "insufficient_quota"));
+    }
+    return resp->status >= 500 && resp->status <= 599;
+}
+
+// Reenvía los datos y recuerda si ya se entregó algo (entonces no se reintenta)
+typedef struct {
+    HttpDataCallback on_data;
+    void *userdata;
+    int delivered;
+} RetryStream;
+
+static int retry_on_data(const char *data, size_t len, void *userdata) {
+    RetryStream *rs = userdata;
+    rs->delivered = 1;
+    return rs->on_data(data, len, rs->userdata);
+}
+
+static int cancelled(HttpResponse *resp) {
+    memset(resp, 0, sizeof(HttpResponse));
+    snprintf(resp->error, sizeof(resp->error), "Operación cancelada");
+    return 0;
+}
+
+int api_post(HttpClient *client, const GPTConfig *config, const char *url,
+             const char *const *headers, const char *body, size_t body_len, long tokens,
+             HttpDataCallback on_data, void *userdata, HttpResponse *resp) {
+    volatile int *cancel = client ? client->cancel : NULL;
+    int max_retries = config->max_retries > 0 ? config->max_retries : 0;
+    RetryStream rs = { on_data, userdata, 0 };
+
+    for (int attempt = 0; ; attempt++) {
+        if (!rate_limiter_acquire(config, tokens, cancel)) return cancelled(resp);
+
+        int ok = http_client_post_stream(client, url, headers, body, body_len,
+                                         on_data ? retry_on_data : NULL, &rs, resp);
+        if (ok) rate_limiter_observe(resp);
+
+        if (attempt >= max_retries || rs.delivered || (cancel && *cancel) ||
+            !should_retry(ok, resp)) {
+            return ok;
+        }
+
+        int64_t delay = ok ? retry_after_ms(resp) : -1;
+        if (delay > RETRY_MAX_MS) return ok;
+        if (delay >= 0) {
+            // Pequeño jitter para que los hilos en espera no vuelvan a la vez
+            pthread_mutex_lock(&limiter.lock);
+            delay += (int64_t)(next_random() % 250);
+            pthread_mutex_unlock(&limiter.lock);
+        } else {
+            delay = backoff_ms(attempt);
+        }
+
+        // Un 429 detiene a todos los hilos, no solo a este
+        if (ok && resp->status == 429) {
+            pthread_mutex_lock(&limiter.lock);
+            int64_t until = now_ms() + delay;
+            if (until > limiter.paused_until_ms) limiter.paused_until_ms = until;
+            pthread_mutex_unlock(&limiter.lock);
+        }
+
+        char reason[300];
+        if (ok) snprintf(reason, sizeof(reason), "HTTP %ld", resp->status);
+        else snprintf(reason, sizeof(reason), "%s", resp->error);
+        fprintf(stderr, "%s⏳ %s; reintento %d/%d en %.1f s\n",
+                isatty(STDERR_FILENO) ? "\r\033[K" : "", reason, attempt + 1, max_retries,
+                delay / 1000.0);
+
+        http_response_free(resp);
+        if (!sleep_ms(delay, cancel)) return cancelled(resp);
+    }
+}
@@ -0,0 +1,29 @@
+/*
+ * rate_limiter.h - Límite de peticiones del lado del cliente y reintentos
+ * Dos cubetas de fichas (peticiones/min y tokens/min) compartidas por todo el
+ * proceso, sincronizadas con las cabeceras x-ratelimit-* de la API. Los 429 y
+ * 5xx se reintentan con espera exponencial con jitter o la que pida Retry-After.
+ */
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include "../common/includes/config_manager.h"
+#include "http_client.h"
+
+// Envía un POST respetando RATE_LIMIT_RPM / RATE_LIMIT_TPM; tokens es lo que
+// consumirá la petición (prompt + max_tokens). Reintenta hasta MAX_RETRIES
+// veces los 429, 5xx y cortes de conexión siempre que on_data no haya recibido
+// nada todavía. Mismo contrato que http_client_post_stream (on_data puede ser NULL)
+int api_post(HttpClient *client, const GPTConfig *config, const char *url,
+             const char *const *headers, const char *body, size_t body_len, long tokens,
+             HttpDataCallback on_data, void *userdata, HttpResponse *resp);
+
+// Espera hasta que las cubetas permitan una petición de tokens tokens.
+// Devuelve 0 si se canceló (cancel != NULL y *cancel != 0) durante la espera
+int rate_limiter_acquire(const GPTConfig *config, long tokens, volatile int *cancel);
+
+// Ajusta las cubetas con lo que informa la API (restantes y tiempo de reinicio)
+void rate_limiter_observe(const HttpResponse *resp);
+
+#endif /* RATE_LIMITER_H */
@@ -0,0 +1,296 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../common/includes/buffer.h"
+#include "request_engine.h"
+
+struct PromptRequest {
+    char *prompt;
+    GPTConfigStore *store;
+    PromptTokenCallback on_token;
+    void *userdata;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;         // Señala fragmentos nuevos o fin
+    Buffer pending;              // Fragmentos aún no entregados
+    int has_output;
+    int done;
+    volatile int cancel;         // Lo comprueba el transporte HTTP
+    char *result;
+    int refs;                    // Handle del llamador + cola del trabajador
+    struct timespec start;
+    PromptRequest *next;
+};
+
+// Cola de solicitudes y su hilo trabajador
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    PromptRequest *head;
+    PromptRequest *tail;
+    pthread_t thread;
+    int started;
+    int stopping;
+} engine = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0, 0, 0 };
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void release(PromptRequest *req) {
+    pthread_mutex_lock(&req->lock);
+    int refs = --req->refs;
+    pthread_mutex_unlock(&req->lock);
+    if (refs > 0) return;
+
+    pthread_mutex_destroy(&req->lock);
+    pthread_cond_destroy(&req->cond);
+    buffer_free(&req->pending);
+    free(req->result);
+    free(req->prompt);
+    free(req);
+}
+
+// Recibe los fragmentos en el hilo trabajador y los deja para quien espera
+static void queue_token(const char *token, size_t len, void *userdata) {
+    PromptRequest *req = userdata;
+    pthread_mutex_lock(&req->lock);
+    buffer_append(&req->pending, token, len);
+    req->has_output = 1;
+    pthread_cond_signal(&req->cond);
+    pthread_mutex_unlock(&req->lock);
+}
+
+static void* engine_worker(void *arg) {
+    (void)arg;
+
+    // Ctrl-C lo atiende el hilo del REPL, no este
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    while (1) {
+        pthread_mutex_lock(&engine.lock);
+        while (!engine.head && !engine.stopping) {
+            pthread_cond_wait(&engine.cond, &engine.lock);
+        }
+        PromptRequest *req = engine.head;
+        if (req) {
+            engine.head = req->next;
+            if (!engine.head) engine.tail = NULL;
+        }
+        pthread_mutex_unlock(&engine.lock);
+        if (!req) break;
+
+        char *response = req->cancel
+            ? strdup("Error: Solicitud cancelada.")
+            : send_prompt_cancellable(req->prompt, req->store,
+                                      req->on_token ? queue_token : NULL, req, &req->cancel);
+
+        pthread_mutex_lock(&req->lock);
+        req->result = response;
+        req->done = 1;
+        pthread_cond_broadcast(&req->cond);
+        pthread_mutex_unlock(&req->lock);
+        release(req);
+    }
+    return NULL;
+}
+
+PromptRequest* prompt_submit(const char *prompt, GPTConfigStore *store,
+                             PromptTokenCallback on_token, void *userdata) {
+    PromptRequest *req = calloc(1, sizeof(PromptRequest));
+    if (!req) return NULL;
+
+    req->prompt = strdup(prompt);
+    if (!req->prompt) {
+        free(req);
+        return NULL;
+    }
+    req->store = store;
+    req->on_token = on_token;
+    req->userdata = userdata;
+    req->refs = 2;
+    pthread_mutex_init(&req->lock, NULL);
+    pthread_cond_init(&req->cond, NULL);
+    buffer_init(&req->pending);
+    clock_gettime(CLOCK_MONOTONIC, &req->start);
+
+    pthread_mutex_lock(&engine.lock);
+    if (!engine.started) {
+        if (pthread_create(&engine.thread, NULL, engine_worker, NULL) != 0) {
+            pthread_mutex_unlock(&engine.lock);
+            req->refs = 1;
+            release(req);
+            return NULL;
+        }
+        engine.started = 1;
+    }
+    if (engine.tail) engine.tail->next = req;
+    else engine.head = req;
+    engine.tail = req;
+    pthread_cond_signal(&engine.cond);
+    pthread_mutex_unlock(&engine.lock);
+    return req;
+}
+
+int prompt_wait(PromptRequest *req, int timeout_ms) {
+    if (!req) return 1;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&req->lock);
+    while (!req->done && req->pending.len == 0 && timeout_ms != 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&req->cond, &req->lock);
+        } else if (pthread_cond_timedwait(&req->cond, &req->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    // Sacar los fragmentos pendientes y entregarlos fuera del bloqueo
+    Buffer chunk = req->pending;
+    buffer_init(&req->pending);
+    int done = req->done;
+    pthread_mutex_unlock(&req->lock);
+
+    if (chunk.len > 0 && req->on_token) {
+        req->on_token(chunk.data, chunk.len, req->userdata);
+    }
+    buffer_free(&chunk);
+    return done;
+}
+
+int prompt_poll(PromptRequest *req) {
+    return prompt_wait(req, 0);
+}
+
+void prompt_cancel(PromptRequest *req) {
+    if (req) req->cancel = 1;
+}
+
+double prompt_elapsed(const PromptRequest *req) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - req->start.tv_sec) + (now.tv_nsec - req->start.tv_nsec) / 1e9;
+}
+
+int prompt_has_output(const PromptRequest *req) {
+    return req->has_output;
+}
+
+char* prompt_take_result(PromptRequest *req) {
+    if (!req) return NULL;
+    pthread_mutex_lock(&req->lock);
+    char *result = req->done ? req->result : NULL;
+    if (result) req->result = NULL;
+    pthread_mutex_unlock(&req->lock);
+    return result;
+}
+
+void prompt_free(PromptRequest *req) {
+    if (!req) return;
+    prompt_cancel(req);
+    release(req);
+}
+
+static void on_sigint(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+void request_engine_install_sigint(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;  // Sin SA_RESTART: fgets vuelve con EINTR en el prompt
+    sigaction(SIGINT, &sa, NULL);
+}
+
+int request_engine_interrupted(void) {
+    int was = interrupted;
+    interrupted = 0;
+    return was;
+}
+
+// Borra el indicador de espera antes de mostrar el primer fragmento
+typedef struct {
+    PromptTokenCallback on_token;
+    void *userdata;
+    int indicator;
+} InteractiveState;
+
+static void clear_indicator(InteractiveState *st) {
+    if (!st->indicator) return;
+    printf("\r\033[K");
+    fflush(stdout);
+    st->indicator = 0;
+}
+
+static void interactive_token(const char *token, size_t len, void *userdata) {
+    InteractiveState *st = userdata;
+    clear_indicator(st);
+    st->on_token(token, len, st->userdata);
+}
+
+char* prompt_run_interactive(const char *prompt, GPTConfigStore *store,
+                             PromptTokenCallback on_token, void *userdata) {
+    InteractiveState st = { on_token, userdata, 0 };
+    request_engine_interrupted();
+
+    PromptRequest *req = prompt_submit(prompt, store, on_token ? interactive_token : NULL, &st);
+    if (!req) return strdup("Error: No se pudo encolar la solicitud.");
+
+    int tty = isatty(STDOUT_FILENO);
+    int cancelled = 0;
+    while (!prompt_wait(req, 100)) {
+        if (request_engine_interrupted() && !cancelled) {
+            cancelled = 1;
+            prompt_cancel(req);
+            clear_indicator(&st);
+            printf("\n⛔ Cancelando la solicitud...\n");
+            fflush(stdout);
+        }
+        if (tty && !cancelled && !prompt_has_output(req)) {
+            printf("\r⏳ Esperando respuesta... %.1fs", prompt_elapsed(req));
+            fflush(stdout);
+            st.indicator = 1;
+        }
+    }
+    clear_indicator(&st);
+
+    char *result = prompt_take_result(req);
+    prompt_free(req);
+    return result ? result : strdup("Error: Solicitud cancelada.");
+}
+
+void request_engine_shutdown(void) {
+    pthread_mutex_lock(&engine.lock);
+    if (!engine.started) {
+        pthread_mutex_unlock(&engine.lock);
+        return;
+    }
+    for (PromptRequest *req = engine.head; req; req = req->next) {
+        req->cancel = 1;
+    }
+    engine.stopping = 1;
+    pthread_cond_broadcast(&engine.cond);
+    pthread_mutex_unlock(&engine.lock);
+
+    pthread_join(engine.thread, NULL);
+    engine.started = 0;
+    engine.stopping = 0;
+}
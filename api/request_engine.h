@@ -0,0 +1,55 @@
+/*
+ * request_engine.h - Solicitudes a la API sin bloquear el REPL
+ * Un hilo trabajador atiende una cola de solicitudes; cada solicitud tiene un
+ * handle que se puede consultar, esperar o cancelar. Los fragmentos de texto
+ * se entregan en el hilo que espera, así toda la salida sale del REPL.
+ */
+
+#ifndef REQUEST_ENGINE_H
+#define REQUEST_ENGINE_H
+
+#include "openai.h"
+
+typedef struct PromptRequest PromptRequest;
+
+// Encola prompt; on_token se llamará desde prompt_wait/prompt_poll
+PromptRequest* prompt_submit(const char *prompt, GPTConfigStore *store,
+                             PromptTokenCallback on_token, void *userdata);
+
+// Entrega los fragmentos pendientes sin esperar. Devuelve 1 si terminó
+int prompt_poll(PromptRequest *req);
+
+// Espera hasta timeout_ms (-1 = sin límite) a que haya fragmentos o termine.
+// Entrega los fragmentos pendientes y devuelve 1 si terminó
+int prompt_wait(PromptRequest *req, int timeout_ms);
+
+// Pide cancelar la solicitud (aborta la transferencia en curso)
+void prompt_cancel(PromptRequest *req);
+
+// Segundos desde que se encoló
+double prompt_elapsed(const PromptRequest *req);
+
+// 1 si ya llegó algún fragmento de la respuesta
+int prompt_has_output(const PromptRequest *req);
+
+// Devuelve la respuesta (el llamador la libera) una vez terminada; NULL si no
+char* prompt_take_result(PromptRequest *req);
+
+// Libera el handle; si sigue en curso, se cancela
+void prompt_free(PromptRequest *req);
+
+// Instala un manejador de SIGINT que marca la interrupción en vez de terminar
+void request_engine_install_sigint(void);
+
+// Devuelve 1 (y limpia la marca) si se pulsó Ctrl-C desde la última consulta
+int request_engine_interrupted(void);
+
+// Envía prompt y espera mostrando el tiempo transcurrido; Ctrl-C cancela la
+// solicitud sin salir del programa. Devuelve siempre un texto (liberar con free)
+char* prompt_run_interactive(const char *prompt, GPTConfigStore *store,
+                             PromptTokenCallback on_token, void *userdata);
+
+// Cancela lo pendiente y detiene el hilo trabajador
+void request_engine_shutdown(void);
+
+#endif /* REQUEST_ENGINE_H */
@@ -0,0 +1,370 @@
+/*
+ * bench.c - Benchmark de extremo a extremo del cliente contra el mock local
+ * Mide la latencia por turno (p50/p95/p99) y el tiempo de CPU del cliente en
+ * función de la longitud del historial y del tamaño de la respuesta:
+ *   - send_prompt / send_prompt_stream dentro de este proceso
+ *   - el REPL real (gpt_chat) manejado a través de un pseudoterminal
+ * Con el mock sin latencia, lo medido es la sobrecarga propia del cliente.
+ *
+ * Uso: bench [--turns N] [--quick] [--latency-ms N] [--chunk-ms N]
+ *            [--mock RUTA] [--repl RUTA]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <ftw.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../api/openai.h"
+#include "../common/includes/context.h"
+
+#ifndef BENCH_PORT
+#define BENCH_PORT 18181
+#endif
+
+#define WARMUP_TURNS 2
+#define REPL_TIMEOUT_MS 30000
+
+static const char *bench_config =
+    "MODEL=gpt-4o\n"
+    "TEMPERATURE=0.7\n"
+    "MAX_TOKENS=2000\n"
+    "API_KEY_FILE=api_key.txt\n"
+    "SYSTEM_ROLE=system\n"
+    "SYSTEM_CONTENT=Eres un asistente de terminal para Arch Linux.\n"
+    "STREAM=true\n"
+    "CONTEXT_TOKENS=0\n"
+    "COMPACT_TOKENS=0\n"
+    "CACHE=off\n"
+    "MAX_RETRIES=0\n";
+
+// Mensaje de historial típico: comillas, saltos de línea y acentos que hay que escapar
+static const char *history_message =
+    "Para revisar el estado de los \"servicios\" ejecuta:\n"
+    "systemctl --failed\n"
+    "journalctl -p 3 -xb\n"
+    "Si la partición raíz está llena, limpia la caché de pacman con paccache -r y "
+    "revisa /var/log/journal. La configuración de red está en /etc/systemd/network/ "
+    "y el año pasado se cambió el arranque a systemd-boot; comprueba bootctl status "
+    "antes de actualizar el núcleo.\t(fin)";
+
+// Parámetros del benchmark
+static struct {
+    int turns;
+    int quick;
+    int latency_ms;
+    int chunk_ms;
+    char mock[4096];
+    char repl[4096];
+} opts = { 30, 0, 0, 0, "out/bench/mock_server", "out/bench/gpt_chat" };
+
+static FILE *report;             // La salida real; stdout queda para el cliente
+
+typedef struct {
+    double *v;
+    size_t n;
+} Series;
+
+static double now_ms(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil por el método del rango más cercano (s->v ya ordenado)
+static double percentile(const Series *s, double p) {
+    if (s->n == 0) return 0.0;
+    size_t rank = (size_t)(p / 100.0 * s->n + 0.999999);
+    if (rank < 1) rank = 1;
+    return s->v[rank > s->n ? s->n - 1 : rank - 1];
+}
+
+static void print_row(const char *mode, int history, size_t response, Series *lat,
+                      double cpu_ms, int errors) {
+    qsort(lat->v, lat->n, sizeof(double), compare_double);
+    fprintf(report, "%-12s %9d %10zu %7zu %9.2f %9.2f %9.2f %12.3f %8d\n",
+            mode, history, response, lat->n, percentile(lat, 50), percentile(lat, 95),
+            percentile(lat, 99), cpu_ms, errors);
+    fflush(report);
+}
+
+// Lanza el mock y espera a que acepte conexiones. Devuelve su pid o -1
+static pid_t start_mock(size_t response_bytes) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        char port[16], bytes[32], latency[16], chunk[16];
+        snprintf(port, sizeof(port), "%d", BENCH_PORT);
+        snprintf(bytes, sizeof(bytes), "%zu", response_bytes);
+        snprintf(latency, sizeof(latency), "%d", opts.latency_ms);
+        snprintf(chunk, sizeof(chunk), "%d", opts.chunk_ms);
+        execl(opts.mock, opts.mock, "--port", port, "--response-bytes", bytes,
+              "--latency-ms", latency, "--chunk-ms", chunk, (char *)NULL);
+        perror(opts.mock);
+        _exit(127);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return -1;
+    }
+
+    char line[64] = {0};
+    ssize_t r = read(fds[0], line, sizeof(line) - 1);
+    close(fds[0]);
+    if (r <= 0 || strncmp(line, "LISTENING", 9) != 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+static void stop_mock(pid_t pid) {
+    if (pid <= 0) return;
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+// Deja el almacén con history mensajes alternando usuario y asistente
+static void fill_history(int history) {
+    context_clear();
+    for (int i = 0; i < history; i++) {
+        context_append(i % 2 == 0 ? "user" : "assistant", history_message);
+    }
+}
+
+static void discard_token(const char *token, size_t len, void *userdata) {
+    (void)token; (void)len; (void)userdata;
+}
+
+// Turnos con send_prompt (o send_prompt_stream) en este proceso
+static void bench_in_process(GPTConfigStore *store, int history, size_t response, int stream) {
+    Series lat = { calloc((size_t)opts.turns, sizeof(double)), 0 };
+    double cpu_total = 0.0;
+    int errors = 0;
+    if (!lat.v) return;
+
+    for (int t = 0; t < opts.turns + WARMUP_TURNS; t++) {
+        fill_history(history);
+        char prompt[64];
+        snprintf(prompt, sizeof(prompt), "¿Qué servicio falló en el turno %d?", t);
+
+        double w0 = now_ms(CLOCK_MONOTONIC), c0 = now_ms(CLOCK_PROCESS_CPUTIME_ID);
+        char *reply = stream ? send_prompt_stream(prompt, store, discard_token, NULL)
+                             : send_prompt(prompt, store);
+        double w1 = now_ms(CLOCK_MONOTONIC), c1 = now_ms(CLOCK_PROCESS_CPUTIME_ID);
+
+        if (!reply || strncmp(reply, "Error", 5) == 0) errors++;
+        free(reply);
+        if (t < WARMUP_TURNS) continue;
+        lat.v[lat.n++] = w1 - w0;
+        cpu_total += c1 - c0;
+    }
+
+    print_row(stream ? "stream" : "send_prompt", history, response, &lat,
+              lat.n ? cpu_total / lat.n : 0.0, errors);
+    free(lat.v);
+}
+
+// Lee del REPL hasta que vuelve a mostrar el prompt ("\n> "). 1 = encontrado
+static int read_until_prompt(int fd) {
+    char buf[8192];
+    char tail[3] = {0};
+    double deadline = now_ms(CLOCK_MONOTONIC) + REPL_TIMEOUT_MS;
+
+    while (1) {
+        int left = (int)(deadline - now_ms(CLOCK_MONOTONIC));
+        if (left <= 0) return 0;
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, left) <= 0) continue;
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return 0;
+        }
+        for (ssize_t i = 0; i < r; i++) {
+            tail[0] = tail[1];
+            tail[1] = tail[2];
+            tail[2] = buf[i];
+            if (tail[0] == '\n' && tail[1] == '>' && tail[2] == ' ') return 1;
+        }
+    }
+}
+
+static int write_line(int fd, const char *line) {
+    size_t len = strlen(line);
+    return write(fd, line, len) == (ssize_t)len && write(fd, "\n", 1) == 1;
+}
+
+// Turnos con el REPL real; el historial crece dos mensajes por turno.
+// El CPU por turno incluye el arranque y la carga del historial
+static void bench_repl(int history, size_t response) {
+    fill_history(history);
+    context_close();
+
+    // Terminal en modo crudo: sin eco ni traducción de saltos de línea
+    struct termios tio;
+    memset(&tio, 0, sizeof(tio));
+    cfmakeraw(&tio);
+    int master;
+    pid_t pid = forkpty(&master, NULL, &tio, NULL);
+    if (pid == 0) {
+        execl(opts.repl, opts.repl, (char *)NULL);
+        perror(opts.repl);
+        _exit(127);
+    }
+    if (pid < 0) {
+        perror("forkpty");
+        return;
+    }
+
+    Series lat = { calloc((size_t)opts.turns, sizeof(double)), 0 };
+    int errors = 0;
+    int alive = lat.v && read_until_prompt(master);
+    for (int t = 0; alive && t < opts.turns + WARMUP_TURNS; t++) {
+        char prompt[64];
+        snprintf(prompt, sizeof(prompt), "¿Qué servicio falló en el turno %d?", t);
+        double w0 = now_ms(CLOCK_MONOTONIC);
+        alive = write_line(master, prompt) && read_until_prompt(master);
+        double w1 = now_ms(CLOCK_MONOTONIC);
+        if (!alive) errors++;
+        else if (t >= WARMUP_TURNS) lat.v[lat.n++] = w1 - w0;
+    }
+    write_line(master, "salir");
+
+    int status;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    if (!alive) kill(pid, SIGTERM);
+    wait4(pid, &status, 0, &ru);
+    close(master);
+
+    double cpu = ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3 +
+                 ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+    int turns = opts.turns + WARMUP_TURNS;
+    print_row("repl", history, response, &lat, cpu / turns, errors);
+    free(lat.v);
+}
+
+static int write_file(const char *path, const char *text) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    fputs(text, fp);
+    return fclose(fp) == 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [--turns N] [--quick] [--latency-ms N] [--chunk-ms N]\n"
+                    "          [--mock RUTA] [--repl RUTA]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--quick") == 0) { opts.quick = 1; continue; }
+        if (!v) { usage(argv[0]); return 2; }
+        if (strcmp(argv[i], "--turns") == 0) opts.turns = atoi(v);
+        else if (strcmp(argv[i], "--latency-ms") == 0) opts.latency_ms = atoi(v);
+        else if (strcmp(argv[i], "--chunk-ms") == 0) opts.chunk_ms = atoi(v);
+        else if (strcmp(argv[i], "--mock") == 0) snprintf(opts.mock, sizeof(opts.mock), "%s", v);
+        else if (strcmp(argv[i], "--repl") == 0) snprintf(opts.repl, sizeof(opts.repl), "%s", v);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+    if (opts.turns < 1) opts.turns = 1;
+
+    // Rutas absolutas antes de cambiar al directorio de trabajo temporal
+    char path[4096];
+    if (!realpath(opts.mock, path)) { perror(opts.mock); return 1; }
+    snprintf(opts.mock, sizeof(opts.mock), "%s", path);
+    int have_repl = realpath(opts.repl, path) != NULL;
+    if (have_repl) snprintf(opts.repl, sizeof(opts.repl), "%s", path);
+
+    char workdir[] = "/tmp/gpt-bench-XXXXXX";
+    if (!mkdtemp(workdir) || chdir(workdir) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    mkdir("modulos", 0755);
+    mkdir("modulos/chat", 0755);
+    if (!write_file("config.ini", bench_config) ||
+        !write_file("modulos/chat/config.ini", bench_config) ||
+        !write_file("api_key.txt", "API_KEY=sk-bench\n")) {
+        perror(workdir);
+        return 1;
+    }
+
+    // Lo que imprime el cliente va a /dev/null; el informe, a la salida real
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || !freopen("/dev/null", "w", stdout)) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    GPTConfigStore *store = config_store_open("config.ini");
+    if (!store) return 1;
+
+    static const int full_history[] = { 0, 20, 100, 400 };
+    static const int quick_history[] = { 0, 100 };
+    static const size_t full_sizes[] = { 256, 4096, 32768 };
+    static const size_t quick_sizes[] = { 256, 4096 };
+    const int *histories = opts.quick ? quick_history : full_history;
+    size_t n_histories = opts.quick ? 2 : 4;
+    const size_t *sizes = opts.quick ? quick_sizes : full_sizes;
+    size_t n_sizes = opts.quick ? 2 : 3;
+
+    fprintf(report, "=== Benchmark del cliente (mock en 127.0.0.1:%d, latencia %d ms, %d turnos) ===\n",
+            BENCH_PORT, opts.latency_ms, opts.turns);
+    fprintf(report, "%-12s %9s %10s %7s %9s %9s %9s %12s %8s\n", "modo", "historial",
+            "respuesta", "turnos", "p50 ms", "p95 ms", "p99 ms", "CPU ms/turno", "errores");
+
+    int failed = 0;
+    for (size_t s = 0; s < n_sizes && !failed; s++) {
+        pid_t mock = start_mock(sizes[s]);
+        if (mock < 0) {
+            fprintf(stderr, "Error: No se pudo iniciar el mock en el puerto %d\n", BENCH_PORT);
+            failed = 1;
+            break;
+        }
+        for (size_t h = 0; h < n_histories; h++) {
+            bench_in_process(store, histories[h], sizes[s], 0);
+            bench_in_process(store, histories[h], sizes[s], 1);
+            if (have_repl) bench_repl(histories[h], sizes[s]);
+        }
+        stop_mock(mock);
+    }
+    if (!have_repl) fprintf(report, "(REPL omitido: no existe %s)\n", opts.repl);
+    fprintf(report, "El REPL se mide con el historial creciendo 2 mensajes por turno; "
+                    "su CPU incluye el arranque.\n");
+
+    openai_cleanup();
+    config_store_close(store);
+    context_close();
+    nftw(workdir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    fclose(report);
+    return failed;
+}
@@ -0,0 +1,150 @@
+/*
+ * escape_bench.c - Microbenchmark de json_escape_append
+ * Compara el escapador vectorizado con la versión byte a byte anterior sobre
+ * textos típicos (prompt en español, salida de comandos, código y texto lleno
+ * de escapes) y muestra GB/s de entrada. Antes de medir comprueba que ambas
+ * versiones producen exactamente lo mismo.
+ *
+ * Uso: escape_bench [--mb N] [--rounds N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../common/includes/json_escape.h"
+
+// Versión anterior: reserva el peor caso y recorre byte a byte con snprintf para los controles
+static int escape_reference(Buffer *out, const char *input, size_t input_len) {
+    if (!buffer_reserve(out, input_len * 6)) return 0;
+    char *output = out->data;
+    size_t j = out->len;
+    for (size_t i = 0; i < input_len; i++) {
+        unsigned char c = (unsigned char)input[i];
+        switch (c) {
+            case '"':  output[j++] = '\\'; output[j++] = '"'; break;
+            case '\\': output[j++] = '\\'; output[j++] = '\\'; break;
+            case '\b': output[j++] = '\\'; output[j++] = 'b'; break;
+            case '\f': output[j++] = '\\'; output[j++] = 'f'; break;
+            case '\n': output[j++] = '\\'; output[j++] = 'n'; break;
+            case '\r': output[j++] = '\\'; output[j++] = 'r'; break;
+            case '\t': output[j++] = '\\'; output[j++] = 't'; break;
+            default:
+                if (c < 32) {
+                    char hex[7];
+                    snprintf(hex, sizeof(hex), "\\u%04x", c);
+                    memcpy(output + j, hex, 6);
+                    j += 6;
+                } else {
+                    output[j++] = (char)c;
+                }
+        }
+    }
+    output[j] = '\0';
+    out->len = j;
+    return 1;
+}
+
+// Muestras que se repiten hasta el tamaño pedido
+static const struct {
+    const char *name;
+    const char *text;
+} samples[] = {
+    { "prompt",
+      "Para revisar el estado de los \"servicios\" ejecuta systemctl --failed y después "
+      "journalctl -p 3 -xb. Si la partición raíz está llena, limpia la caché de pacman con "
+      "paccache -r y revisa /var/log/journal; la configuración de red está en "
+      "/etc/systemd/network/ y el arranque usa systemd-boot desde el año pasado.\n" },
+    { "salida",
+      "Oct 18 10:42:07 archlinux kernel: usb 1-2: new high-speed USB device number 5 using xhci_hcd\n"
+      "Oct 18 10:42:07 archlinux systemd[1]: Started Journal Service.\n"
+      "/dev/nvme0n1p2  477G  201G  252G  45% /\n" },
+    { "fuente",
+      "int main(void) {\n\tprintf(\"%s\\n\", \"hola\");\n\tif (x < 0) return -1;\n\treturn 0;\n}\n" },
+    { "escapes",
+      "\"\\\"\n\t\"\\\r\n\"\\\b\f\x01\x1f\"\\" },
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char* make_input(const char *sample, size_t size) {
+    size_t slen = strlen(sample);
+    char *text = malloc(size + 1);
+    if (!text) return NULL;
+    for (size_t i = 0; i < size; i += slen) {
+        memcpy(text + i, sample, size - i < slen ? size - i : slen);
+    }
+    text[size] = '\0';
+    return text;
+}
+
+// Mejor de rounds pasadas sobre input, en GB/s de entrada
+static double measure(int (*fn)(Buffer *, const char *, size_t), const char *input, size_t len,
+                      int rounds, size_t *out_len) {
+    double best = 0;
+    Buffer out;
+    buffer_init(&out);
+    for (int r = 0; r < rounds; r++) {
+        buffer_clear(&out);
+        double t0 = now_s();
+        fn(&out, input, len);
+        double elapsed = now_s() - t0;
+        double gbs = len / elapsed / 1e9;
+        if (gbs > best) best = gbs;
+    }
+    *out_len = out.len;
+    buffer_free(&out);
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t mb = 16;
+    int rounds = 20;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mb") == 0 && i + 1 < argc) {
+            mb = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Uso: %s [--mb N] [--rounds N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (mb == 0 || rounds <= 0) return 1;
+
+    printf("json_escape_append: implementación %s, %zu MiB por pasada, mejor de %d\n\n",
+           json_escape_impl(), mb, rounds);
+    printf("%-10s %12s %12s %9s %10s\n", "texto", "anterior", "actual", "mejora", "salida");
+
+    int failed = 0;
+    for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+        size_t len = mb << 20;
+        char *input = make_input(samples[s].text, len);
+        if (!input) return 1;
+
+        // Las dos versiones deben coincidir byte a byte
+        Buffer a, b;
+        buffer_init(&a);
+        buffer_init(&b);
+        escape_reference(&a, input, len);
+        json_escape_append(&b, input, len);
+        if (a.len != b.len || memcmp(a.data, b.data, a.len) != 0) {
+            fprintf(stderr, "❌ %s: la salida no coincide con la versión anterior\n", samples[s].name);
+            failed = 1;
+        }
+        buffer_free(&a);
+        buffer_free(&b);
+
+        size_t out_len;
+        double old_gbs = measure(escape_reference, input, len, rounds, &out_len);
+        double new_gbs = measure(json_escape_append, input, len, rounds, &out_len);
+        printf("%-10s %7.2f GB/s %7.2f GB/s %8.1fx %9.2fx\n", samples[s].name,
+               old_gbs, new_gbs, new_gbs / old_gbs, (double)out_len / len);
+        free(input);
+    }
+    return failed;
+}
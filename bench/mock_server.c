@@ -0,0 +1,315 @@
+/*
+ * mock_server.c - Servidor local que imita /v1/chat/completions
+ * Responde con un texto sintético del tamaño pedido, en JSON o en streaming
+ * (SSE con transferencia chunked), con latencia configurable e inyección de
+ * errores. Un hilo por conexión y keep-alive, como la API real.
+ *
+ * Uso: mock_server [--port N] [--latency-ms N] [--chunk-ms N] [--chunks N]
+ *                  [--response-bytes N] [--error-rate P] [--error-status N]
+ *                  [--retry-after-ms N]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define MAX_HEADER 65536
+
+// Parámetros del servidor (fijos tras arrancar)
+static struct {
+    int port;
+    int latency_ms;              // Espera antes de la primera respuesta
+    int chunk_ms;                // Espera entre fragmentos SSE
+    int chunks;                  // Fragmentos en que se parte una respuesta en streaming
+    size_t response_bytes;       // Tamaño del texto de la respuesta
+    double error_rate;           // Fracción de peticiones que fallan
+    int error_status;            // Código de los errores inyectados
+    int retry_after_ms;          // Valor de retry-after-ms en los errores
+} opts = { 18181, 0, 0, 16, 256, 0.0, 429, 1000 };
+
+static char *response_text;      // Texto sintético de response_bytes bytes
+static unsigned long request_count = 0;
+static pthread_mutex_t count_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void sleep_ms(int ms) {
+    if (ms <= 0) return;
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+// Texto de relleno con acentos y comillas (para que el cliente tenga que escaparlo)
+static char* make_text(size_t len) {
+    static const char *words[] = {
+        "el", "paquete", "pacman", "instalado", "\"correctamente\"", "año", "configuración",
+        "sistema", "disco", "partición", "red", "usuario", "servicio", "arranque"
+    };
+    char *text = malloc(len + 1);
+    if (!text) return NULL;
+
+    size_t n = 0, w = 0;
+    while (n < len) {
+        const char *word = words[w++ % (sizeof(words) / sizeof(words[0]))];
+        size_t wl = strlen(word);
+        if (n + wl + 1 > len) break;
+        memcpy(text + n, word, wl);
+        n += wl;
+        text[n++] = (w % 12 == 0) ? '\n' : ' ';
+    }
+    while (n < len) text[n++] = '.';
+    text[len] = '\0';
+    return text;
+}
+
+// Escapa text[0..len) como contenido de una cadena JSON
+static size_t json_escape(const char *text, size_t len, char *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == '"' || c == '\\') { out[n++] = '\\'; out[n++] = c; }
+        else if (c == '\n') { out[n++] = '\\'; out[n++] = 'n'; }
+        else out[n++] = c;
+    }
+    return n;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t w = send(fd, data, len, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        data += w;
+        len -= (size_t)w;
+    }
+    return 1;
+}
+
+static int send_simple(int fd, int status, const char *reason, const char *extra_headers,
+                       const char *body) {
+    char head[512];
+    size_t body_len = strlen(body);
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %zu\r\n%s\r\n", status, reason, body_len, extra_headers);
+    return write_all(fd, head, (size_t)n) && write_all(fd, body, body_len);
+}
+
+static int send_error(int fd) {
+    char extra[128];
+    snprintf(extra, sizeof(extra), "retry-after-ms: %d\r\nRetry-After: %d\r\n",
+             opts.retry_after_ms, (opts.retry_after_ms + 999) / 1000);
+    return send_simple(fd, opts.error_status, "Mock Error", extra,
+                       "{\"error\": {\"message\": \"Error inyectado por el mock\", \"type\": \"mock\"}}");
+}
+
+static int send_completion(int fd) {
+    size_t len = opts.response_bytes;
+    char *escaped = malloc(len * 2 + 1);
+    if (!escaped) return 0;
+    size_t elen = json_escape(response_text, len, escaped);
+
+    size_t cap = elen + 512;
+    char *body = malloc(cap);
+    if (!body) {
+        free(escaped);
+        return 0;
+    }
+    snprintf(body, cap,
+             "{\"id\": \"chatcmpl-mock\", \"object\": \"chat.completion\", \"choices\": "
+             "[{\"index\": 0, \"message\": {\"role\": \"assistant\", \"content\": \"%.*s\"}, "
+             "\"finish_reason\": \"stop\"}], \"usage\": {\"completion_tokens\": %zu}}",
+             (int)elen, escaped, len / 4);
+    int ok = send_simple(fd, 200, "OK", "x-ratelimit-remaining-requests: 10000\r\n", body);
+    free(body);
+    free(escaped);
+    return ok;
+}
+
+static int send_chunk(int fd, const char *data, size_t len) {
+    char size[32];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", len);
+    return write_all(fd, size, (size_t)n) && write_all(fd, data, len) && write_all(fd, "\r\n", 2);
+}
+
+static int send_stream(int fd) {
+    const char *head = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                       "Transfer-Encoding: chunked\r\n\r\n";
+    if (!write_all(fd, head, strlen(head))) return 0;
+
+    size_t len = opts.response_bytes;
+    size_t parts = opts.chunks > 0 ? (size_t)opts.chunks : 1;
+    size_t step = (len + parts - 1) / parts;
+    if (step == 0) step = 1;
+
+    char *event = malloc(step * 2 + 128);
+    if (!event) return 0;
+    size_t off = 0;
+    while (off < len) {
+        size_t piece = len - off < step ? len - off : step;
+        // No partir una secuencia UTF-8 entre dos eventos
+        while (off + piece < len && ((unsigned char)response_text[off + piece] & 0xC0) == 0x80) piece++;
+
+        int n = sprintf(event, "data: {\"choices\": [{\"index\": 0, \"delta\": {\"content\": \"");
+        n += (int)json_escape(response_text + off, piece, event + n);
+        n += sprintf(event + n, "\"}}]}\n\n");
+        if (!send_chunk(fd, event, (size_t)n)) {
+            free(event);
+            return 0;
+        }
+        off += piece;
+        sleep_ms(opts.chunk_ms);
+    }
+    free(event);
+
+    const char *done = "data: [DONE]\n\n";
+    return send_chunk(fd, done, strlen(done)) && write_all(fd, "0\r\n\r\n", 5);
+}
+
+// Decide si la petición número n falla (reparto uniforme de error_rate)
+static int inject_error(unsigned long n) {
+    if (opts.error_rate <= 0.0) return 0;
+    return (unsigned long)(n * opts.error_rate) != (unsigned long)((n + 1) * opts.error_rate);
+}
+
+// Atiende una conexión: varias peticiones seguidas (keep-alive)
+static void* serve_connection(void *arg) {
+    int fd = (int)(long)arg;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    char *buf = malloc(MAX_HEADER);
+    size_t have = 0;
+    while (buf) {
+        // Leer hasta el final de las cabeceras
+        char *end = NULL;
+        while (!(end = have >= 4 ? strstr(buf, "\r\n\r\n") : NULL)) {
+            if (have >= MAX_HEADER - 1) goto done;
+            ssize_t r = recv(fd, buf + have, MAX_HEADER - 1 - have, 0);
+            if (r <= 0) goto done;
+            have += (size_t)r;
+            buf[have] = '\0';
+        }
+        size_t header_len = (size_t)(end - buf) + 4;
+
+        size_t content_length = 0;
+        const char *cl = strcasestr(buf, "\r\ncontent-length:");
+        if (cl && cl < end) content_length = strtoul(cl + 17, NULL, 10);
+        int is_post = strncmp(buf, "POST /v1/chat/completions ", 26) == 0;
+
+        // Leer el cuerpo completo
+        char *body = malloc(content_length + 1);
+        if (!body) goto done;
+        size_t got = have - header_len < content_length ? have - header_len : content_length;
+        memcpy(body, buf + header_len, got);
+        size_t leftover = have - header_len - got;
+        memmove(buf, buf + header_len + got, leftover);
+        have = leftover;
+        buf[have] = '\0';
+        while (got < content_length) {
+            ssize_t r = recv(fd, body + got, content_length - got, 0);
+            if (r <= 0) {
+                free(body);
+                goto done;
+            }
+            got += (size_t)r;
+        }
+        body[content_length] = '\0';
+
+        int streaming = strstr(body, "\"stream\": true") || strstr(body, "\"stream\":true");
+        free(body);
+
+        pthread_mutex_lock(&count_lock);
+        unsigned long n = request_count++;
+        pthread_mutex_unlock(&count_lock);
+
+        sleep_ms(opts.latency_ms);
+        int ok;
+        if (!is_post) {
+            ok = send_simple(fd, 404, "Not Found", "", "{\"error\": {\"message\": \"not found\"}}");
+        } else if (inject_error(n)) {
+            ok = send_error(fd);
+        } else {
+            ok = streaming ? send_stream(fd) : send_completion(fd);
+        }
+        if (!ok) break;
+    }
+
+done:
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [--port N] [--latency-ms N] [--chunk-ms N] [--chunks N]\n"
+                    "          [--response-bytes N] [--error-rate P] [--error-status N]\n"
+                    "          [--retry-after-ms N]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!v) { usage(argv[0]); return 2; }
+        if (strcmp(argv[i], "--port") == 0) opts.port = atoi(v);
+        else if (strcmp(argv[i], "--latency-ms") == 0) opts.latency_ms = atoi(v);
+        else if (strcmp(argv[i], "--chunk-ms") == 0) opts.chunk_ms = atoi(v);
+        else if (strcmp(argv[i], "--chunks") == 0) opts.chunks = atoi(v);
+        else if (strcmp(argv[i], "--response-bytes") == 0) opts.response_bytes = strtoul(v, NULL, 10);
+        else if (strcmp(argv[i], "--error-rate") == 0) opts.error_rate = atof(v);
+        else if (strcmp(argv[i], "--error-status") == 0) opts.error_status = atoi(v);
+        else if (strcmp(argv[i], "--retry-after-ms") == 0) opts.retry_after_ms = atoi(v);
+        else { usage(argv[0]); return 2; }
+        i++;
+    }
+
+    response_text = make_text(opts.response_bytes);
+    if (!response_text) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    int srv = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)opts.port);
+    if (srv < 0 || bind(srv, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(srv, 128) != 0) {
+        perror("mock_server");
+        return 1;
+    }
+
+    // Quien lanza el mock espera esta línea para saber que ya acepta conexiones
+    printf("LISTENING %d\n", opts.port);
+    fflush(stdout);
+
+    while (1) {
+        int fd = accept(srv, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_connection, (void *)(long)fd) == 0) {
+            pthread_detach(thread);
+        } else {
+            close(fd);
+        }
+    }
+    close(srv);
+    free(response_text);
+    return 0;
+}
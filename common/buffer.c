@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "includes/buffer.h"
+
+void buffer_init(Buffer *buf) {
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+int buffer_reserve(Buffer *buf, size_t extra) {
+    size_t needed = buf->len + extra + 1;
+    if (needed <= buf->cap) return 1;
+
+    size_t new_cap = buf->cap ? buf->cap : 256;
+    while (new_cap < needed) new_cap *= 2;
+
+    char *tmp = realloc(buf->data, new_cap);
+    if (!tmp) return 0;
+    buf->data = tmp;
+    buf->cap = new_cap;
+    return 1;
+}
+
+int buffer_append(Buffer *buf, const char *data, size_t len) {
+    if (!buffer_reserve(buf, len)) return 0;
+    if (len > 0) memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 1;
+}
+
+int buffer_append_str(Buffer *buf, const char *str) {
+    return buffer_append(buf, str, strlen(str));
+}
+
+int buffer_appendf(Buffer *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (needed < 0 || !buffer_reserve(buf, (size_t)needed)) return 0;
+
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->len, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    buf->len += (size_t)needed;
+    return 1;
+}
+
+void buffer_clear(Buffer *buf) {
+    buf->len = 0;
+    if (buf->data) buf->data[0] = '\0';
+}
+
+char* buffer_detach(Buffer *buf) {
+    if (!buf->data && !buffer_reserve(buf, 0)) return NULL;
+    buf->data[buf->len] = '\0';
+
+    char *data = buf->data;
+    buffer_init(buf);
+    return data;
+}
+
+void buffer_free(Buffer *buf) {
+    free(buf->data);
+    buffer_init(buf);
+}
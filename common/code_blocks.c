@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "includes/code_blocks.h"
+#include "includes/buffer.h"
+
+// Lenguajes cuyo contenido se puede ejecutar en la shell
+static const char *shell_languages[] = {
+    "bash", "sh", "shell", "zsh", "console", "terminal", "shell-session", NULL
+};
+
+// Bloques que muestran una sesión: solo se ejecutan sus líneas "$ "
+static const char *session_languages[] = { "console", "terminal", "shell-session", NULL };
+
+static int in_list(const char *language, const char **list) {
+    for (int i = 0; list[i]; i++) {
+        if (strcasecmp(language, list[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Ancho de la sangría (un tabulador cuenta como 4) y bytes que ocupa
+static size_t indent_of(const char *s, size_t len, size_t *width) {
+    size_t i = 0, w = 0;
+    while (i < len && (s[i] == ' ' || s[i] == '\t')) {
+        w += s[i] == '\t' ? 4 : 1;
+        i++;
+    }
+    if (width) *width = w;
+    return i;
+}
+
+// Quita hasta width columnas de sangría del principio de la línea
+static size_t strip_indent(const char *s, size_t len, size_t width) {
+    size_t i = 0, w = 0;
+    while (i < len && w < width && (s[i] == ' ' || s[i] == '\t')) {
+        w += s[i] == '\t' ? 4 : 1;
+        i++;
+    }
+    return i;
+}
+
+static int is_blank(const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!isspace((unsigned char)s[i])) return 0;
+    }
+    return 1;
+}
+
+// Valla de apertura: sangría, 3 o más ` o ~ y la info (lenguaje). Devuelve la longitud de la valla
+static size_t open_fence(const char *s, size_t len, char *fence_char, const char **info, size_t *info_len) {
+    size_t i = indent_of(s, len, NULL);
+    if (i >= len || (s[i] != '`' && s[i] != '~')) return 0;
+    char c = s[i];
+    size_t n = 0;
+    while (i + n < len && s[i + n] == c) n++;
+    if (n < 3) return 0;
+
+    const char *rest = s + i + n;
+    size_t rest_len = len - i - n;
+    // ```code``` en una sola línea no abre un bloque
+    if (c == '`' && memchr(rest, '`', rest_len)) return 0;
+
+    size_t skip = indent_of(rest, rest_len, NULL);
+    *info = rest + skip;
+    *info_len = 0;
+    while (skip + *info_len < rest_len && !isspace((unsigned char)(*info)[*info_len]) &&
+           (*info)[*info_len] != '{') {
+        (*info_len)++;
+    }
+    *fence_char = c;
+    return n;
+}
+
+static int close_fence(const char *s, size_t len, char fence_char, size_t fence_len) {
+    size_t i = indent_of(s, len, NULL);
+    size_t n = 0;
+    while (i + n < len && s[i + n] == fence_char) n++;
+    return n >= fence_len && is_blank(s + i + n, len - i - n);
+}
+
+// Línea "$ comando": devuelve el offset del comando o 0 si no lo es
+static size_t prompt_command(const char *s, size_t len) {
+    size_t i = indent_of(s, len, NULL);
+    if (i + 2 > len || s[i] != '$' || (s[i + 1] != ' ' && s[i + 1] != '\t')) return 0;
+    i += 2;
+    while (i < len && (s[i] == ' ' || s[i] == '\t')) i++;
+    return i < len ? i : 0;
+}
+
+// Quita líneas en blanco al principio y espacios al final
+static char* finish_body(Buffer *body) {
+    char *text = buffer_detach(body);
+    if (!text) return strdup("");
+    size_t start = 0;
+    for (size_t i = 0; text[i]; i++) {
+        if (text[i] == '\n') start = i + 1;
+        else if (!isspace((unsigned char)text[i])) break;
+    }
+    size_t end = strlen(text);
+    while (end > start && isspace((unsigned char)text[end - 1])) end--;
+    memmove(text, text + start, end - start);
+    text[end - start] = '\0';
+    return text;
+}
+
+static int push_block(CodeBlockList *list, const char *language, size_t language_len,
+                      Buffer *body, size_t offset, int prompt) {
+    CodeBlock *items = realloc(list->items, (list->count + 1) * sizeof(CodeBlock));
+    if (!items) {
+        buffer_free(body);
+        return 0;
+    }
+    list->items = items;
+
+    CodeBlock *b = &list->items[list->count];
+    b->language = strndup(language, language_len);
+    b->body = finish_body(body);
+    b->offset = offset;
+    b->prompt = prompt;
+    if (!b->language || !b->body) {
+        free(b->language);
+        free(b->body);
+        return 0;
+    }
+    list->count++;
+    return 1;
+}
+
+// Cierra las líneas "$ " acumuladas como un bloque
+static void flush_prompt(CodeBlockList *list, Buffer *body, int *in_prompt, size_t offset) {
+    if (!*in_prompt) return;
+    push_block(list, "", 0, body, offset, 1);
+    buffer_init(body);
+    *in_prompt = 0;
+}
+
+size_t code_blocks_scan(const char *text, CodeBlockList *list) {
+    list->items = NULL;
+    list->count = 0;
+    if (!text) return 0;
+
+    // Bloque abierto (fence_len = 0: fuera de un bloque)
+    size_t fence_len = 0;
+    char fence_char = 0;
+    size_t fence_indent = 0;
+    const char *language = "";
+    size_t language_len = 0;
+    size_t block_offset = 0;
+    int in_prompt = 0;           // Acumulando líneas "$ " consecutivas
+    Buffer body;
+    buffer_init(&body);
+
+    const char *line = text;
+    while (*line) {
+        const char *nl = strchr(line, '\n');
+        size_t len = nl ? (size_t)(nl - line) : strlen(line);
+        const char *next = nl ? nl + 1 : line + len;
+        if (len > 0 && line[len - 1] == '\r') len--;
+        size_t offset = (size_t)(line - text);
+
+        if (fence_len > 0) {
+            if (close_fence(line, len, fence_char, fence_len)) {
+                push_block(list, language, language_len, &body, block_offset, 0);
+                buffer_init(&body);
+                fence_len = 0;
+            } else {
+                size_t skip = strip_indent(line, len, fence_indent);
+                buffer_append(&body, line + skip, len - skip);
+                buffer_append(&body, "\n", 1);
+            }
+            line = next;
+            continue;
+        }
+
+        const char *info;
+        size_t info_len;
+        size_t n = open_fence(line, len, &fence_char, &info, &info_len);
+        if (n > 0) {
+            flush_prompt(list, &body, &in_prompt, block_offset);
+            fence_len = n;
+            indent_of(line, len, &fence_indent);
+            language = info;
+            language_len = info_len;
+            block_offset = offset;
+        } else {
+            size_t cmd = prompt_command(line, len);
+            if (cmd > 0) {
+                if (!in_prompt) {
+                    in_prompt = 1;
+                    block_offset = offset;
+                }
+                buffer_append(&body, line + cmd, len - cmd);
+                buffer_append(&body, "\n", 1);
+            } else {
+                flush_prompt(list, &body, &in_prompt, block_offset);
+            }
+        }
+        line = next;
+    }
+
+    // Un bloque sin cerrar llega hasta el final del texto
+    if (fence_len > 0) {
+        push_block(list, language, language_len, &body, block_offset, 0);
+    } else if (in_prompt) {
+        push_block(list, "", 0, &body, block_offset, 1);
+    } else {
+        buffer_free(&body);
+    }
+    return list->count;
+}
+
+// En un bloque de sesión ("$ orden" seguido de su salida) deja solo las órdenes
+static void keep_session_commands(CodeBlock *b) {
+    Buffer out;
+    buffer_init(&out);
+    const char *line = b->body;
+    while (*line) {
+        const char *nl = strchr(line, '\n');
+        size_t len = nl ? (size_t)(nl - line) : strlen(line);
+        size_t cmd = prompt_command(line, len);
+        if (cmd > 0) {
+            if (out.len > 0) buffer_append(&out, "\n", 1);
+            buffer_append(&out, line + cmd, len - cmd);
+        }
+        line = nl ? nl + 1 : line + len;
+    }
+    if (out.len > 0) {
+        free(b->body);
+        b->body = buffer_detach(&out);
+    }
+    buffer_free(&out);
+}
+
+size_t code_blocks_commands(const char *text, const char *extra_language, CodeBlockList *list) {
+    code_blocks_scan(text, list);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        CodeBlock *b = &list->items[i];
+        int shell = b->prompt || b->language[0] == '\0' || in_list(b->language, shell_languages) ||
+                    (extra_language && strcasecmp(b->language, extra_language) == 0);
+        if (shell && in_list(b->language, session_languages)) keep_session_commands(b);
+        if (!shell || b->body[0] == '\0') {
+            free(b->language);
+            free(b->body);
+            continue;
+        }
+        list->items[kept++] = *b;
+    }
+    list->count = kept;
+    return kept;
+}
+
+void code_blocks_free(CodeBlockList *list) {
+    if (!list) return;
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->items[i].language);
+        free(list->items[i].body);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+}
+
+size_t code_blocks_parse_selection(const char *answer, size_t count, int *selected) {
+    static const char *all_words[] = { "t", "todos", "todo", "s", "si", "sí", "a", "all", "y", NULL };
+    memset(selected, 0, count * sizeof(int));
+    if (!answer) return 0;
+
+    char word[16];
+    size_t w = 0;
+    const char *p = answer;
+    while (isspace((unsigned char)*p)) p++;
+    while (p[w] && !isspace((unsigned char)p[w]) && w < sizeof(word) - 1) {
+        word[w] = (char)tolower((unsigned char)p[w]);
+        w++;
+    }
+    word[w] = '\0';
+    if (w == 0) return 0;
+    if (in_list(word, all_words)) {
+        for (size_t i = 0; i < count; i++) selected[i] = 1;
+        return count;
+    }
+
+    // Números y rangos separados por comas o espacios
+    size_t chosen = 0;
+    while (*p) {
+        if (isspace((unsigned char)*p) || *p == ',') {
+            p++;
+            continue;
+        }
+        char *end;
+        long from = strtol(p, &end, 10);
+        if (end == p) goto invalid;
+        long to = from;
+        p = end;
+        if (*p == '-') {
+            to = strtol(p + 1, &end, 10);
+            if (end == p + 1) goto invalid;
+            p = end;
+        }
+        if (from < 1 || to < from || (size_t)to > count) goto invalid;
+        for (long i = from; i <= to; i++) {
+            if (!selected[i - 1]) chosen++;
+            selected[i - 1] = 1;
+        }
+    }
+    return chosen;
+
+invalid:
+    memset(selected, 0, count * sizeof(int));
+    return 0;
+}
@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "includes/command_index.h"
+#include "includes/sha256.h"
+
+#define INDEX_MAGIC 0x58444943u   // "CIDX"
+#define INDEX_VERSION 1
+#define DEFAULT_PATH "/usr/local/sbin:/usr/local/bin:/usr/bin:/bin:/usr/sbin:/sbin"
+
+// Nodo del trie. Los hijos de cada nodo son contiguos y están ordenados por c,
+// así que el nodo no guarda punteros y el archivo se usa tal cual tras mapearlo
+typedef struct {
+    uint32_t first_child;
+    uint16_t child_count;
+    uint8_t c;
+    uint8_t terminal;            // Aquí termina un nombre
+} TrieNode;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nodes;
+    uint32_t names;
+    unsigned char key[SHA256_DIGEST_SIZE];  // Huella del PATH y de sus directorios
+} IndexHeader;
+
+struct CommandIndex {
+    const TrieNode *nodes;
+    uint32_t node_count;
+    uint32_t names;
+    unsigned char key[SHA256_DIGEST_SIZE];
+    TrieNode *owned;             // Construido en este proceso...
+    void *map;                   // ...o mapeado de la caché
+    size_t map_len;
+};
+
+// Órdenes internas de bash que no suelen existir como ejecutable
+static const char *builtins[] = {
+    ".", ":", "alias", "bg", "bind", "break", "builtin", "caller", "cd", "command",
+    "compgen", "complete", "compopt", "continue", "declare", "dirs", "disown", "echo",
+    "enable", "eval", "exec", "export", "false", "fc", "fg", "getopts", "hash",
+    "history", "jobs", "kill", "let", "local", "mapfile", "popd", "printf", "pushd",
+    "pwd", "read", "readarray", "readonly", "return", "set", "shift", "shopt",
+    "source", "test", "times", "trap", "true", "type", "typeset", "ulimit", "umask",
+    "unalias", "unset", "wait", NULL
+};
+
+static const char* path_env(void) {
+    const char *path = getenv("PATH");
+    return path && path[0] ? path : DEFAULT_PATH;
+}
+
+// Llama a fn con cada directorio absoluto del PATH (los relativos dependen del
+// directorio actual y no se indexan)
+static void for_each_dir(void (*fn)(const char *dir, void *ctx), void *ctx) {
+    char *copy = strdup(path_env());
+    if (!copy) return;
+    char *save = NULL;
+    for (char *dir = strtok_r(copy, ":", &save); dir; dir = strtok_r(NULL, ":", &save)) {
+        if (dir[0] == '/') fn(dir, ctx);
+    }
+    free(copy);
+}
+
+static void hash_dir(const char *dir, void *ctx) {
+    struct {
+        int64_t dev, ino, sec, nsec;
+    } id = {0};
+    struct stat st;
+    if (stat(dir, &st) == 0) {
+        id.dev = (int64_t)st.st_dev;
+        id.ino = (int64_t)st.st_ino;
+        id.sec = (int64_t)st.st_mtim.tv_sec;
+        id.nsec = (int64_t)st.st_mtim.tv_nsec;
+    }
+    sha256_update(ctx, dir, strlen(dir) + 1);
+    sha256_update(ctx, &id, sizeof(id));
+}
+
+// Cambia si cambia el PATH o se añade, quita o renombra algo en uno de sus directorios
+static void compute_key(unsigned char key[SHA256_DIGEST_SIZE]) {
+    Sha256 ctx;
+    sha256_init(&ctx);
+    uint32_t version = INDEX_VERSION;
+    sha256_update(&ctx, &version, sizeof(version));
+    for_each_dir(hash_dir, &ctx);
+    sha256_final(&ctx, key);
+}
+
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} NameList;
+
+static void push_name(NameList *list, const char *name) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        char **items = realloc(list->items, capacity * sizeof(char*));
+        if (!items) return;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    char *copy = strdup(name);
+    if (copy) list->items[list->count++] = copy;
+}
+
+static void scan_dir(const char *dir, void *ctx) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    int fd = dirfd(d);
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.' || entry->d_type == DT_DIR) continue;
+        // fstatat sigue los enlaces simbólicos: cuenta el destino
+        struct stat st;
+        if (fstatat(fd, entry->d_name, &st, 0) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 0111)) {
+            push_name(ctx, entry->d_name);
+        }
+    }
+    closedir(d);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+typedef struct {
+    TrieNode *items;
+    size_t count;
+    size_t capacity;
+} NodeList;
+
+// Reserva n nodos contiguos; devuelve el índice del primero o -1
+static long alloc_nodes(NodeList *nodes, size_t n) {
+    if (nodes->count + n > UINT32_MAX) return -1;
+    if (nodes->count + n > nodes->capacity) {
+        size_t capacity = nodes->capacity ? nodes->capacity : 4096;
+        while (capacity < nodes->count + n) capacity *= 2;
+        TrieNode *items = realloc(nodes->items, capacity * sizeof(TrieNode));
+        if (!items) return -1;
+        nodes->items = items;
+        nodes->capacity = capacity;
+    }
+    long first = (long)nodes->count;
+    memset(nodes->items + first, 0, n * sizeof(TrieNode));
+    nodes->count += n;
+    return first;
+}
+
+// names[lo, hi) está ordenado y comparte los depth primeros bytes. Crea de una
+// vez todos los hijos de node (uno por byte distinto en depth) y baja por cada uno
+static int build_node(NodeList *nodes, size_t node, char **names, size_t lo, size_t hi, size_t depth) {
+    // El nombre que acaba aquí es el primero: es prefijo de los demás
+    if (lo < hi && names[lo][depth] == '\0') {
+        nodes->items[node].terminal = 1;
+        lo++;
+    }
+    if (lo == hi) return 1;
+
+    size_t groups = 0;
+    for (size_t i = lo; i < hi; i++) {
+        if (i == lo || names[i][depth] != names[i - 1][depth]) groups++;
+    }
+    long first = alloc_nodes(nodes, groups);
+    if (first < 0) return 0;
+    nodes->items[node].first_child = (uint32_t)first;
+    nodes->items[node].child_count = (uint16_t)groups;
+
+    size_t child = (size_t)first;
+    for (size_t i = lo; i < hi; child++) {
+        size_t j = i + 1;
+        while (j < hi && names[j][depth] == names[i][depth]) j++;
+        nodes->items[child].c = (uint8_t)names[i][depth];
+        if (!build_node(nodes, child, names, i, j, depth + 1)) return 0;
+        i = j;
+    }
+    return 1;
+}
+
+static CommandIndex* build_index(const unsigned char key[SHA256_DIGEST_SIZE]) {
+    NameList names = {0};
+    for_each_dir(scan_dir, &names);
+    for (int i = 0; builtins[i]; i++) push_name(&names, builtins[i]);
+
+    qsort(names.items, names.count, sizeof(char*), compare_names);
+    size_t unique = 0;
+    for (size_t i = 0; i < names.count; i++) {
+        if (unique > 0 && strcmp(names.items[i], names.items[unique - 1]) == 0) {
+            free(names.items[i]);
+        } else {
+            names.items[unique++] = names.items[i];
+        }
+    }
+
+    CommandIndex *index = calloc(1, sizeof(CommandIndex));
+    NodeList nodes = {0};
+    int ok = index && alloc_nodes(&nodes, 1) == 0 &&
+             build_node(&nodes, 0, names.items, 0, unique, 0);
+
+    for (size_t i = 0; i < unique; i++) free(names.items[i]);
+    free(names.items);
+
+    if (!ok) {
+        free(nodes.items);
+        free(index);
+        return NULL;
+    }
+    index->owned = nodes.items;
+    index->nodes = nodes.items;
+    index->node_count = (uint32_t)nodes.count;
+    index->names = (uint32_t)unique;
+    memcpy(index->key, key, SHA256_DIGEST_SIZE);
+    return index;
+}
+
+static CommandIndex* load_cache(const char *cache_path, const unsigned char key[SHA256_DIGEST_SIZE]) {
+    int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size > sizeof(IndexHeader)) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    size_t map_len = (size_t)st.st_size;
+    const IndexHeader *header = map;
+    const TrieNode *nodes = (const TrieNode *)(header + 1);
+    int valid = header->magic == INDEX_MAGIC && header->version == INDEX_VERSION &&
+                memcmp(header->key, key, SHA256_DIGEST_SIZE) == 0 && header->nodes > 0 &&
+                map_len == sizeof(IndexHeader) + (size_t)header->nodes * sizeof(TrieNode);
+    // Un archivo dañado no debe llevar la búsqueda fuera del mapa
+    for (uint32_t i = 0; valid && i < header->nodes; i++) {
+        valid = (size_t)nodes[i].first_child + nodes[i].child_count <= header->nodes;
+    }
+
+    CommandIndex *index = valid ? calloc(1, sizeof(CommandIndex)) : NULL;
+    if (!index) {
+        munmap(map, map_len);
+        return NULL;
+    }
+    index->nodes = nodes;
+    index->node_count = header->nodes;
+    index->names = header->names;
+    memcpy(index->key, key, SHA256_DIGEST_SIZE);
+    index->map = map;
+    index->map_len = map_len;
+    return index;
+}
+
+// Escribe en un temporal y lo renombra, para que otro proceso nunca lea un índice a medias
+static void save_cache(const char *cache_path, const CommandIndex *index) {
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.%d.tmp", cache_path, (int)getpid()) >= (int)sizeof(tmp)) return;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    IndexHeader header = { INDEX_MAGIC, INDEX_VERSION, index->node_count, index->names, {0} };
+    memcpy(header.key, index->key, SHA256_DIGEST_SIZE);
+    size_t nodes_len = (size_t)index->node_count * sizeof(TrieNode);
+    int ok = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+             write(fd, index->nodes, nodes_len) == (ssize_t)nodes_len;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp, cache_path) != 0) unlink(tmp);
+}
+
+CommandIndex* command_index_load(const char *cache_path) {
+    unsigned char key[SHA256_DIGEST_SIZE];
+    compute_key(key);
+
+    CommandIndex *index = cache_path ? load_cache(cache_path, key) : NULL;
+    if (index) return index;
+
+    index = build_index(key);
+    if (index && cache_path) save_cache(cache_path, index);
+    return index;
+}
+
+int command_index_contains(const CommandIndex *index, const char *name, size_t len) {
+    if (!index || !name || len == 0) return 0;
+    const TrieNode *nodes = index->nodes;
+    const TrieNode *node = &nodes[0];
+    for (size_t i = 0; i < len; i++) {
+        // Búsqueda binaria entre los hijos (como mucho 256)
+        uint8_t c = (uint8_t)name[i];
+        size_t lo = node->first_child, hi = lo + node->child_count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (nodes[mid].c < c) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == (size_t)node->first_child + node->child_count || nodes[lo].c != c) return 0;
+        node = &nodes[lo];
+    }
+    return node->terminal;
+}
+
+int command_index_stale(const CommandIndex *index) {
+    if (!index) return 1;
+    unsigned char key[SHA256_DIGEST_SIZE];
+    compute_key(key);
+    return memcmp(key, index->key, SHA256_DIGEST_SIZE) != 0;
+}
+
+size_t command_index_count(const CommandIndex *index) {
+    return index ? index->names : 0;
+}
+
+int command_index_cached(const CommandIndex *index) {
+    return index && index->map != NULL;
+}
+
+void command_index_free(CommandIndex *index) {
+    if (!index) return;
+    if (index->map) munmap(index->map, index->map_len);
+    free(index->owned);
+    free(index);
+}
+
+static CommandIndex *shared_index = NULL;
+
+CommandIndex* command_index_shared(void) {
+    if (!shared_index) shared_index = command_index_load(COMMAND_INDEX_FILE);
+    return shared_index;
+}
+
+void command_index_cleanup(void) {
+    command_index_free(shared_index);
+    shared_index = NULL;
+}
+
+// Longitud de la palabra: hasta un espacio o un operador de la shell
+static size_t word_length(const char *s) {
+    size_t len = 0;
+    while (s[len] && !isspace((unsigned char)s[len]) && !strchr(";|&<>()", s[len])) len++;
+    return len;
+}
+
+// NOMBRE=valor delante del comando
+static int is_assignment(const char *s, size_t len) {
+    if (len == 0 || !(isalpha((unsigned char)s[0]) || s[0] == '_')) return 0;
+    for (size_t i = 1; i < len; i++) {
+        if (s[i] == '=') return 1;
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_') return 0;
+    }
+    return 0;
+}
+
+// ./script.sh, /usr/bin/algo: se comprueba directamente
+static int path_executable(const char *word, size_t len) {
+    char path[PATH_MAX];
+    if (len >= sizeof(path)) return 0;
+    memcpy(path, word, len);
+    path[len] = '\0';
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+int command_index_is_command(const char *text) {
+    if (!text) return 0;
+    while (isspace((unsigned char)*text)) text++;
+
+    // Una pregunta va al modelo aunque empiece por el nombre de un programa
+    size_t end = strlen(text);
+    while (end > 0 && isspace((unsigned char)text[end - 1])) end--;
+    if (end == 0 || text[end - 1] == '?' || strncmp(text, "¿", strlen("¿")) == 0) return 0;
+
+    const char *word = text;
+    size_t len = word_length(word);
+    while (is_assignment(word, len)) {
+        word += len;
+        while (isspace((unsigned char)*word)) word++;
+        len = word_length(word);
+    }
+    if (len == 0) return 0;
+    if (memchr(word, '/', len)) return path_executable(word, len);
+
+    CommandIndex *index = command_index_shared();
+    if (command_index_contains(index, word, len)) return 1;
+
+    // Puede ser un programa recién instalado: rehacer el índice si el PATH cambió
+    if (index && command_index_stale(index)) {
+        command_index_cleanup();
+        return command_index_contains(command_index_shared(), word, len);
+    }
+    return 0;
+}
@@ -1,4 +1,7 @@
+#include <unistd.h>
+#include <sys/inotify.h>
 #include "includes/config_manager.h"
+#include "includes/exec.h"
 
 // Move the function implementations here
 void config_init(GPTConfig *config) {
@@ -9,6 +12,25 @@ void config_init(GPTConfig *config) {
     strcpy(config->role_file, "");
     strcpy(config->system_role, "system");
     strcpy(config->system_content, "Eres un asistente útil.");
+    config->connect_timeout = 10;
+    config->request_timeout = 120;
+    config->stream = 0;
+    config->live_output = 1;
+    config->output_tokens = 1500;
+    config->command_timeout = 0;
+    config->command_max_output = EXEC_DEFAULT_MAX_OUTPUT / 1024;
+    config->context_tokens = 16000;
+    strcpy(config->tokenizer_file, "");
+    config->compact_tokens = 12000;
+    config->compact_keep = 6;
+    config->cache = 0;
+    config->cache_ttl = 86400;
+    config->cache_size_mb = 16;
+    config->rate_limit_rpm = 0;
+    config->rate_limit_tpm = 0;
+    config->max_retries = 4;
+    strcpy(config->metrics_file, "");
+    config->metrics_interval = 15;
 }
 
 int config_load_from_file(GPTConfig *config, const char *filename) {
@@ -53,6 +75,45 @@ int config_load_from_file(GPTConfig *config, const char *filename) {
                 strcpy(config->system_role, v);
             } else if (strcmp(k, "SYSTEM_CONTENT") == 0) {
                 strcpy(config->system_content, v);
+            } else if (strcmp(k, "CONNECT_TIMEOUT") == 0) {
+                config->connect_timeout = atoi(v);
+            } else if (strcmp(k, "REQUEST_TIMEOUT") == 0) {
+                config->request_timeout = atoi(v);
+            } else if (strcmp(k, "STREAM") == 0) {
+                config->stream = (strcmp(v, "true") == 0 || strcmp(v, "1") == 0);
+            } else if (strcmp(k, "LIVE_OUTPUT") == 0) {
+                config->live_output = (strcmp(v, "true") == 0 || strcmp(v, "1") == 0);
+            } else if (strcmp(k, "OUTPUT_TOKENS") == 0) {
+                config->output_tokens = atoi(v);
+            } else if (strcmp(k, "COMMAND_TIMEOUT") == 0) {
+                config->command_timeout = atoi(v);
+            } else if (strcmp(k, "COMMAND_MAX_OUTPUT") == 0) {
+                config->command_max_output = atoi(v);
+            } else if (strcmp(k, "CONTEXT_TOKENS") == 0) {
+                config->context_tokens = atoi(v);
+            } else if (strcmp(k, "TOKENIZER_FILE") == 0) {
+                snprintf(config->tokenizer_file, sizeof(config->tokenizer_file), "%.255s", v);
+            } else if (strcmp(k, "COMPACT_TOKENS") == 0) {
+                config->compact_tokens = atoi(v);
+            } else if (strcmp(k, "COMPACT_KEEP") == 0) {
+                config->compact_keep = atoi(v);
+            } else if (strcmp(k, "CACHE") == 0) {
+                if (strcmp(v, "force") == 0) config->cache = 2;
+                else config->cache = (strcmp(v, "on") == 0 || strcmp(v, "true") == 0 || strcmp(v, "1") == 0);
+            } else if (strcmp(k, "CACHE_TTL") == 0) {
+                config->cache_ttl = atoi(v);
+            } else if (strcmp(k, "CACHE_SIZE_MB") == 0) {
+                config->cache_size_mb = atoi(v);
+            } else if (strcmp(k, "RATE_LIMIT_RPM") == 0) {
+                config->rate_limit_rpm = atoi(v);
+            } else if (strcmp(k, "RATE_LIMIT_TPM") == 0) {
+                config->rate_limit_tpm = atoi(v);
+            } else if (strcmp(k, "MAX_RETRIES") == 0) {
+                config->max_retries = atoi(v);
+            } else if (strcmp(k, "METRICS_FILE") == 0) {
+                snprintf(config->metrics_file, sizeof(config->metrics_file), "%.255s", v);
+            } else if (strcmp(k, "METRICS_INTERVAL") == 0) {
+                config->metrics_interval = atoi(v);
             }
         }
     }
@@ -104,4 +165,130 @@ char* config_get_api_key(const GPTConfig *config) {
     fclose(file);
 
     return api_key;
-}
\ No newline at end of file
+}
+
+// Carga config.ini, el rol y la clave API en una configuración nueva
+static void config_store_load(GPTConfigStore *store) {
+    GPTConfig config;
+    config_init(&config);
+
+    if (access(store->config_file, F_OK) == 0) {
+        if (!config_load_from_file(&config, store->config_file)) {
+            fprintf(stderr, "Advertencia: No se pudo cargar la configuración desde %s, usando valores por defecto\n", store->config_file);
+        }
+    }
+
+    if (strlen(config.role_file) > 0) {
+        if (!config_load_role(&config)) {
+            fprintf(stderr, "Advertencia: No se pudo cargar la configuración desde %s, usando valores por defecto\n", config.role_file);
+        }
+    }
+
+    char *api_key = config_get_api_key(&config);
+    snprintf(store->api_key, sizeof(store->api_key), "%s", api_key ? api_key : "");
+    free(api_key);
+
+    store->config = config;
+    store->generation++;
+}
+
+// Vigila el directorio de cada archivo: los editores suelen reemplazarlos con rename()
+static void config_store_watch(GPTConfigStore *store) {
+    if (store->inotify_fd < 0) return;
+
+    for (int i = 0; i < store->watch_count; i++) {
+        inotify_rm_watch(store->inotify_fd, store->watch_fds[i]);
+    }
+    store->watch_count = 0;
+
+    const char *files[] = {
+        store->config_file,
+        store->config.role_file,
+        store->config.api_key_file
+    };
+
+    for (int i = 0; i < 3; i++) {
+        if (strlen(files[i]) == 0) continue;
+
+        char dir[256];
+        snprintf(dir, sizeof(dir), "%s", files[i]);
+        char *slash = strrchr(dir, '/');
+        if (slash) *slash = '\0';
+        else strcpy(dir, ".");
+
+        int wd = inotify_add_watch(store->inotify_fd, dir,
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+        if (wd < 0) continue;
+
+        // Directorios repetidos devuelven el mismo descriptor
+        int known = 0;
+        for (int j = 0; j < store->watch_count; j++) {
+            if (store->watch_fds[j] == wd) known = 1;
+        }
+        if (!known) store->watch_fds[store->watch_count++] = wd;
+    }
+}
+
+// Indica si el nombre de un evento corresponde a alguno de los archivos de configuración
+static int config_store_matches(const GPTConfigStore *store, const char *name) {
+    const char *files[] = {
+        store->config_file,
+        store->config.role_file,
+        store->config.api_key_file
+    };
+
+    for (int i = 0; i < 3; i++) {
+        if (strlen(files[i]) == 0) continue;
+        const char *base = strrchr(files[i], '/');
+        base = base ? base + 1 : files[i];
+        if (strcmp(base, name) == 0) return 1;
+    }
+    return 0;
+}
+
+GPTConfigStore* config_store_open(const char *config_file) {
+    GPTConfigStore *store = calloc(1, sizeof(GPTConfigStore));
+    if (!store) return NULL;
+
+    snprintf(store->config_file, sizeof(store->config_file), "%s", config_file ? config_file : "");
+    store->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    config_store_load(store);
+    config_store_watch(store);
+    return store;
+}
+
+int config_store_refresh(GPTConfigStore *store) {
+    if (!store || store->inotify_fd < 0) return 0;
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t n;
+
+    while ((n = read(store->inotify_fd, events, sizeof(events))) > 0) {
+        for (char *p = events; p < events + n; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->len > 0 && config_store_matches(store, ev->name)) changed = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    if (!changed) return 0;
+
+    config_store_load(store);
+    config_store_watch(store);
+    fprintf(stderr, "🔄 Configuración recargada desde %s\n", store->config_file);
+    return 1;
+}
+
+const GPTConfig* config_store_get(GPTConfigStore *store) {
+    if (!store) return NULL;
+    config_store_refresh(store);
+    return &store->config;
+}
+
+void config_store_close(GPTConfigStore *store) {
+    if (!store) return;
+    if (store->inotify_fd >= 0) close(store->inotify_fd);
+    free(store);
+}
@@ -1,21 +1,510 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "includes/context.h"
+#include "includes/buffer.h"
+#include "includes/json_escape.h"
+#include "includes/utf8.h"
+#include "includes/metrics.h"
 
-void append_to_context(const char* cmd, const char* output) {
-    FILE *f = fopen("context.txt", "a");
-    fprintf(f, "user\t%s\n", cmd);
-    fprintf(f, "assistant\t%s\n", output);
+#define RECORD_MAGIC 0x31585443u  // "CTX1"
+#define RECORD_ALIGN 8
+
+// Cabecera de cada registro; le siguen content + '\0' y json + '\0', alineados a 8 bytes
+typedef struct {
+    uint32_t magic;
+    uint8_t role;
+    uint8_t reserved[3];
+    uint32_t content_len;
+    uint32_t json_len;
+} ContextRecord;
+
+// Protege el almacén frente al hilo de compactación (recursivo: las funciones
+// públicas se llaman entre sí)
+static pthread_mutex_t store_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static const char *role_names[] = { "system", "user", "assistant" };
+
+// Estado del almacén (uno por proceso)
+static struct {
+    int fd;                      // context.db (O_APPEND)
+    int idx_fd;                  // context.idx
+    char *map;                   // Mapeo de solo lectura del log
+    size_t map_len;
+    uint64_t *offsets;           // Índice en memoria
+    size_t count;
+    size_t cap;
+    uint64_t end;                // Tamaño válido del log
+    unsigned long generation;    // Se incrementa al borrar, compactar o deshacer mensajes
+} store = { -1, -1, NULL, 0, NULL, 0, 0, 0, 0 };
+
+static uint8_t role_code(const char *role) {
+    for (uint8_t i = 0; i < sizeof(role_names) / sizeof(role_names[0]); i++) {
+        if (strcmp(role, role_names[i]) == 0) return i;
+    }
+    return 0;
+}
+
+static size_t record_size(const ContextRecord *rec) {
+    size_t size = sizeof(ContextRecord) + rec->content_len + 1 + rec->json_len + 1;
+    return (size + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+}
+
+static int index_push(uint64_t offset) {
+    if (store.count == store.cap) {
+        size_t new_cap = store.cap ? store.cap * 2 : 256;
+        uint64_t *tmp = realloc(store.offsets, new_cap * sizeof(uint64_t));
+        if (!tmp) return 0;
+        store.offsets = tmp;
+        store.cap = new_cap;
+    }
+    store.offsets[store.count++] = offset;
+    return 1;
+}
+
+// Mapea el log completo; se vuelve a mapear solo cuando creció
+static int ensure_mapped() {
+    if (store.end == 0) return 0;
+    if (store.map && store.map_len >= store.end) return 1;
+
+    if (store.map) munmap(store.map, store.map_len);
+    store.map = mmap(NULL, store.end, PROT_READ, MAP_SHARED, store.fd, 0);
+    if (store.map == MAP_FAILED) {
+        store.map = NULL;
+        store.map_len = 0;
+        return 0;
+    }
+    store.map_len = store.end;
+    return 1;
+}
+
+// Valida un registro en offset; devuelve su tamaño o 0 si está incompleto o dañado
+static size_t check_record(uint64_t offset, uint64_t file_size) {
+    if (offset + sizeof(ContextRecord) > file_size) return 0;
+
+    const ContextRecord *rec = (const ContextRecord *)(store.map + offset);
+    if (rec->magic != RECORD_MAGIC) return 0;
+
+    size_t size = record_size(rec);
+    return offset + size <= file_size ? size : 0;
+}
+
+// Carga el índice y lo completa recorriendo el log desde el último offset conocido
+static void rebuild_index(uint64_t file_size) {
+    store.count = 0;
+    store.end = file_size;
+    if (file_size == 0 || !ensure_mapped()) {
+        store.end = 0;
+        return;
+    }
+
+    struct stat st = {0};
+    size_t indexed = 0;
+    if (fstat(store.idx_fd, &st) == 0 && st.st_size >= (off_t)sizeof(uint64_t)) {
+        size_t n = st.st_size / sizeof(uint64_t);
+        uint64_t *offsets = malloc(n * sizeof(uint64_t));
+        if (offsets && pread(store.idx_fd, offsets, n * sizeof(uint64_t), 0) == (ssize_t)(n * sizeof(uint64_t))) {
+            uint64_t expected = 0;
+            for (size_t i = 0; i < n && offsets[i] == expected; i++) {
+                size_t size = check_record(offsets[i], file_size);
+                if (!size || !index_push(offsets[i])) break;
+                expected = offsets[i] + size;
+            }
+            indexed = store.count;
+        }
+        free(offsets);
+    }
+
+    uint64_t offset = 0;
+    if (store.count > 0) {
+        offset = store.offsets[store.count - 1] +
+                 check_record(store.offsets[store.count - 1], file_size);
+    }
+
+    // Registros que faltan en el índice (p. ej. tras un corte durante la escritura)
+    size_t size;
+    while ((size = check_record(offset, file_size)) > 0 && index_push(offset)) {
+        offset += size;
+    }
+
+    // Descartar una cola incompleta y reescribir el índice si cambió
+    store.end = offset;
+    if (offset < file_size && ftruncate(store.fd, offset) != 0) {
+        perror("context.db");
+    }
+    if (indexed != store.count || st.st_size != (off_t)(store.count * sizeof(uint64_t))) {
+        if (ftruncate(store.idx_fd, 0) == 0 && store.count > 0) {
+            ssize_t w = pwrite(store.idx_fd, store.offsets, store.count * sizeof(uint64_t), 0);
+            (void)w;
+        }
+    }
+}
+
+// Bloqueo entre procesos: varios gpt_* pueden compartir context.db, así que toda
+// escritura (y todo recorte del log o del índice) se hace con flock tomado
+static int flock_wait(int fd, int op) {
+    while (flock(fd, op) != 0) {
+        if (errno != EINTR) return 0;
+    }
+    return 1;
+}
+
+static int store_open() {
+    if (store.fd >= 0) return 1;
+
+    store.fd = open(CONTEXT_FILE, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    store.idx_fd = open(CONTEXT_INDEX_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (store.fd < 0 || store.idx_fd < 0) {
+        perror("context");
+        context_close();
+        return 0;
+    }
+
+    // rebuild_index puede recortar una cola incompleta: no debe ser la de otro
+    // proceso que está escribiendo
+    struct stat st;
+    if (!flock_wait(store.fd, LOCK_EX) || fstat(store.fd, &st) != 0) {
+        context_close();
+        return 0;
+    }
+    rebuild_index((uint64_t)st.st_size);
+    flock(store.fd, LOCK_UN);
+    return 1;
+}
+
+// Abre el almacén y toma el bloqueo del log, poniéndose al día con lo que otros
+// procesos hayan escrito: registros nuevos, un recorte o un log sustituido al compactar
+static int store_lock_file() {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (!store_open()) return 0;
+        if (!flock_wait(store.fd, LOCK_EX)) return 0;
+
+        struct stat cur, disk;
+        if (fstat(store.fd, &cur) == 0 && stat(CONTEXT_FILE, &disk) == 0 &&
+            cur.st_dev == disk.st_dev && cur.st_ino == disk.st_ino) {
+            if ((uint64_t)cur.st_size != store.end) {
+                // El índice de otro proceso ya está en context.idx; las cachés por
+                // índice (tokens por mensaje) dejan de valer
+                rebuild_index((uint64_t)cur.st_size);
+                store.generation++;
+            }
+            return 1;
+        }
+
+        // Otro proceso compactó: el log abierto ya no es el del disco (cerrar suelta el bloqueo)
+        unsigned long next_generation = store.generation + 1;
+        context_close();
+        store.generation = next_generation;
+    }
+    return 0;
+}
+
+static void store_unlock_file() {
+    if (store.fd >= 0) flock(store.fd, LOCK_UN);
+}
+
+// Guarda un mensaje importado sin el salto de línea final
+static void import_flush(const char *role, Buffer *content) {
+    while (content->len > 0 && content->data[content->len - 1] == '\n') {
+        content->data[--content->len] = '\0';
+    }
+    context_append(role, content->data ? content->data : "");
+    buffer_clear(content);
+}
+
+// Importa el context.txt de versiones anteriores (líneas "rol\tcontenido");
+// las líneas sin tabulador continúan el mensaje anterior
+static void import_legacy_context() {
+    FILE *f = fopen("context.txt", "r");
+    if (!f) return;
+
+    Buffer content;
+    buffer_init(&content);
+    char role[16] = "";
+    char line[2048];
+
+    while (fgets(line, sizeof(line), f)) {
+        char *tab = strchr(line, '\t');
+        if (tab && (size_t)(tab - line) < sizeof(role)) {
+            if (role[0]) import_flush(role, &content);
+            *tab = '\0';
+            memcpy(role, line, (size_t)(tab - line) + 1);
+            buffer_append_str(&content, tab + 1);
+        } else if (role[0]) {
+            buffer_append_str(&content, line);
+        }
+    }
+    if (role[0]) import_flush(role, &content);
+
+    buffer_free(&content);
     fclose(f);
+    rename("context.txt", "context.txt.bak");
+}
+
+void context_lock() {
+    pthread_mutex_lock(&store_lock);
+}
+
+void context_unlock() {
+    pthread_mutex_unlock(&store_lock);
 }
 
 void load_context() {
-    // Verificar si context.txt existe, si no, crearlo
-    FILE *f = fopen("context.txt", "r");
-    if (!f) {
-        // El archivo no existe, crearlo
-        f = fopen("context.txt", "w");
-        if (f) fclose(f);
-    } else {
-        fclose(f);
+    context_lock();
+    int fresh = access(CONTEXT_FILE, F_OK) != 0;
+    if (store_open() && fresh) import_legacy_context();
+    context_unlock();
+}
+
+// Serializa un mensaje: cabecera, contenido y forma JSON ya escapada, con relleno
+static int build_record(Buffer *rec, const char *role, const char *content) {
+    size_t content_len = strlen(content);
+
+    ContextRecord header = { RECORD_MAGIC, role_code(role), {0, 0, 0}, (uint32_t)content_len, 0 };
+    buffer_append(rec, (const char *)&header, sizeof(header));
+    buffer_append(rec, content, content_len);
+    buffer_append(rec, "", 1);
+
+    size_t json_start = rec->len;
+    buffer_appendf(rec, "{\"role\": \"%s\", \"content\": \"", role_names[header.role]);
+    json_escape_append(rec, content, content_len);
+    if (!buffer_append(rec, "\"}", 2)) return 0;
+    ((ContextRecord *)rec->data)->json_len = (uint32_t)(rec->len - json_start);
+
+    // Terminador + relleno hasta la alineación del registro
+    static const char zeros[RECORD_ALIGN + 1] = {0};
+    size_t size = record_size((ContextRecord *)rec->data);
+    return buffer_append(rec, zeros, size - rec->len);
+}
+
+int context_append(const char *role, const char *content) {
+    if (!role || !content) return 0;
+
+    // Lo guardado acaba en el JSON de cada solicitud: bytes inválidos (salida
+    // binaria, registros mal codificados) harían que la API la rechazara
+    Buffer fixed;
+    buffer_init(&fixed);
+    size_t content_len = strlen(content);
+    if (!utf8_is_valid(content, content_len)) {
+        utf8_repair_append(&fixed, content, content_len);
+        if (fixed.data) content = fixed.data;
+    }
+
+    Buffer rec;
+    buffer_init(&rec);
+    uint64_t t0 = metrics_now();
+    int built = build_record(&rec, role, content);
+    buffer_free(&fixed);
+    metrics_span(METRIC_STAGE_ESCAPE, t0);
+    if (!built) {
+        buffer_free(&rec);
+        return 0;
+    }
+
+    context_lock();
+    int ok = 0;
+    if (store_lock_file()) {
+        // Con el bloqueo tomado y el índice al día, store.end es el final real del
+        // archivo: ahí escribe O_APPEND y ahí va la entrada del índice
+        uint64_t offset = store.end;
+        ssize_t written = write(store.fd, rec.data, rec.len);
+        if (written == (ssize_t)rec.len) {
+            store.end += rec.len;
+            if (pwrite(store.idx_fd, &offset, sizeof(offset), store.count * sizeof(uint64_t)) != sizeof(offset)) {
+                perror("context.idx");
+            }
+            ok = index_push(offset);
+        } else if (written > 0 && ftruncate(store.fd, offset) != 0) {
+            perror("context.db");
+        }
+        store_unlock_file();
+    }
+    context_unlock();
+
+    buffer_free(&rec);
+    return ok;
+}
+
+int context_drop_last(const char *role, const char *content) {
+    if (!role || !content) return 0;
+
+    context_lock();
+    int dropped = 0;
+    int locked = store_lock_file();
+    if (locked && store.count > 0 && ensure_mapped()) {
+        // Solo si sigue siendo el mismo mensaje: otro escritor o la compactación
+        // pueden haber cambiado la cola entretanto
+        uint64_t offset = store.offsets[store.count - 1];
+        const ContextRecord *rec = (const ContextRecord *)(store.map + offset);
+        size_t len = strlen(content);
+        if (rec->role == role_code(role) && rec->content_len == len &&
+            memcmp(rec + 1, content, len) == 0) {
+            munmap(store.map, store.map_len);
+            store.map = NULL;
+            store.map_len = 0;
+            store.count--;
+            store.end = offset;
+            // Las cachés por índice (tokens por mensaje) no deben reutilizar esta posición
+            store.generation++;
+            if (ftruncate(store.fd, (off_t)offset) != 0 ||
+                ftruncate(store.idx_fd, (off_t)(store.count * sizeof(uint64_t))) != 0) {
+                perror("context");
+            }
+            dropped = 1;
+        }
+    }
+    if (locked) store_unlock_file();
+    context_unlock();
+    return dropped;
+}
+
+void append_to_context(const char* cmd, const char* output) {
+    context_append("user", cmd);
+    context_append("assistant", output);
+}
+
+size_t context_count() {
+    context_lock();
+    size_t count = store_open() ? store.count : 0;
+    context_unlock();
+    return count;
+}
+
+int context_get(size_t index, ContextMessage *msg) {
+    if (!msg) return 0;
+
+    context_lock();
+    int ok = store_open() && index < store.count && ensure_mapped();
+    if (ok) {
+        const ContextRecord *rec = (const ContextRecord *)(store.map + store.offsets[index]);
+        const char *data = (const char *)(rec + 1);
+
+        msg->role = role_names[rec->role < 3 ? rec->role : 0];
+        msg->content = data;
+        msg->content_len = rec->content_len;
+        msg->json = data + rec->content_len + 1;
+        msg->json_len = rec->json_len;
+    }
+    context_unlock();
+    return ok;
+}
+
+void context_clear() {
+    context_lock();
+    if (store_lock_file()) {
+        if (store.map) munmap(store.map, store.map_len);
+        store.map = NULL;
+        store.map_len = 0;
+        store.count = 0;
+        store.end = 0;
+        store.generation++;
+
+        if (ftruncate(store.fd, 0) != 0 || ftruncate(store.idx_fd, 0) != 0) {
+            perror("context");
+        }
+        store_unlock_file();
+    }
+    context_unlock();
+}
+
+unsigned long context_generation() {
+    context_lock();
+    unsigned long generation = store.generation;
+    context_unlock();
+    return generation;
+}
+
+// Escribe todo buf en fd; devuelve 1 si se escribió completo
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return 0;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+int context_compact(unsigned long generation, size_t count, const char *summary) {
+    if (!summary || count == 0) return 0;
+
+    Buffer rec;
+    buffer_init(&rec);
+    if (!build_record(&rec, "system", summary)) {
+        buffer_free(&rec);
+        return 0;
+    }
+
+    context_lock();
+    int ok = 0;
+    int locked = store_lock_file();
+    if (locked && generation == store.generation && count <= store.count && ensure_mapped()) {
+        // Los registros compactados son contiguos desde el principio del log
+        uint64_t cut = count < store.count ? store.offsets[count] : store.end;
+
+        // 1. Archivar los originales (append-only, mismo formato de registro)
+        int archive = open(CONTEXT_ARCHIVE_FILE, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        ok = archive >= 0 && write_all(archive, store.map, cut) && fsync(archive) == 0;
+        if (archive >= 0) close(archive);
+
+        // 2. Escribir resumen + mensajes restantes en un log nuevo y sustituir el actual.
+        // El log nuevo también se bloquea: quien lo abra tras el rename espera a
+        // que el índice esté vacío
+        int tmp = -1;
+        if (ok) {
+            tmp = open(CONTEXT_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            ok = tmp >= 0 && flock_wait(tmp, LOCK_EX) &&
+                 write_all(tmp, rec.data, rec.len) &&
+                 write_all(tmp, store.map + cut, store.end - cut) &&
+                 fsync(tmp) == 0;
+        }
+
+        if (ok && rename(CONTEXT_FILE ".tmp", CONTEXT_FILE) == 0) {
+            // 3. Reabrir: el índice se reconstruye sobre el log nuevo
+            if (ftruncate(store.idx_fd, 0) != 0) perror("context.idx");
+            close(tmp);
+            unsigned long next_generation = store.generation + 1;
+            context_close();
+            store.generation = next_generation;
+            locked = 0;
+            ok = store_open();
+        } else {
+            if (ok) perror("context.db");
+            if (tmp >= 0) close(tmp);
+            unlink(CONTEXT_FILE ".tmp");
+            ok = 0;
+        }
     }
+    if (locked) store_unlock_file();
+    context_unlock();
+
+    buffer_free(&rec);
+    return ok;
+}
+
+void context_close() {
+    context_lock();
+    if (store.map) munmap(store.map, store.map_len);
+    if (store.fd >= 0) close(store.fd);
+    if (store.idx_fd >= 0) close(store.idx_fd);
+    free(store.offsets);
+
+    store.fd = -1;
+    store.idx_fd = -1;
+    store.map = NULL;
+    store.map_len = 0;
+    store.offsets = NULL;
+    store.count = 0;
+    store.cap = 0;
+    store.end = 0;
+    context_unlock();
 }
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "includes/context_window.h"
+#include "includes/context.h"
+#include "includes/json_escape.h"
+
+#define MESSAGE_OVERHEAD 4       // Tokens de formato por mensaje (rol y separadores)
+#define REPLY_OVERHEAD 3         // Tokens con los que la API prepara la respuesta
+#define MIN_TRUNCATED 32         // Por debajo de esto no compensa recortar un mensaje
+#define TRUNCATED_MARK "[…] "    // Prefijo del mensaje recortado
+
+// Tokens de cada mensaje del almacén (0 = sin calcular, n = n - 1 tokens)
+static struct {
+    uint32_t *counts;
+    size_t len;
+    unsigned long generation;
+    const Tokenizer *tok;
+} cache = { NULL, 0, 0, NULL };
+
+static size_t message_tokens(const Tokenizer *tok, size_t index, const ContextMessage *msg) {
+    if (cache.tok != tok || cache.generation != context_generation()) {
+        memset(cache.counts, 0, cache.len * sizeof(uint32_t));
+        cache.tok = tok;
+        cache.generation = context_generation();
+    }
+    if (index < cache.len && cache.counts[index] != 0) return cache.counts[index] - 1;
+
+    size_t tokens = tokenizer_count(tok, msg->content, msg->content_len) + MESSAGE_OVERHEAD;
+    if (index >= cache.len) {
+        size_t new_len = cache.len ? cache.len : 256;
+        while (new_len <= index) new_len *= 2;
+        uint32_t *tmp = realloc(cache.counts, new_len * sizeof(uint32_t));
+        if (!tmp) return tokens;
+        memset(tmp + cache.len, 0, (new_len - cache.len) * sizeof(uint32_t));
+        cache.counts = tmp;
+        cache.len = new_len;
+    }
+    cache.counts[index] = (uint32_t)tokens + 1;
+    return tokens;
+}
+
+static void append_separator(Buffer *req, int count) {
+    buffer_append_str(req, count > 0 ? ",\n    " : "\n    ");
+}
+
+// Escribe {"role": ..., "content": prefix + text} escapando el texto
+static void append_escaped(Buffer *req, const char *role, const char *prefix,
+                           const char *text, size_t len, int count) {
+    append_separator(req, count);
+    buffer_appendf(req, "{\"role\": \"%s\", \"content\": \"%s", role, prefix);
+    json_escape_append(req, text, len);
+    buffer_append_str(req, "\"}");
+}
+
+int context_window_append(Buffer *req, const Tokenizer *tok, size_t budget,
+                          const char *system_role, const char *system_content,
+                          ContextWindowStats *stats) {
+    ContextWindowStats st = {0};
+    st.budget = budget;
+    st.estimated = tok == NULL;
+
+    size_t system_len = strlen(system_content);
+    st.tokens = tokenizer_count(tok, system_content, system_len) + MESSAGE_OVERHEAD + REPLY_OVERHEAD;
+
+    // Recorrer del más reciente al más antiguo; el último mensaje entra siempre.
+    // El bloqueo mantiene válidos los punteros frente a la compactación
+    context_lock();
+    size_t total = context_count();
+    size_t first = total;
+    size_t cut_index = total;
+    size_t cut_offset = 0;
+
+    for (size_t i = total; i-- > 0; ) {
+        ContextMessage msg;
+        if (!context_get(i, &msg)) break;
+
+        size_t tokens = message_tokens(tok, i, &msg);
+        if (budget == 0 || st.tokens + tokens <= budget || i + 1 == total) {
+            st.tokens += tokens;
+            first = i;
+            continue;
+        }
+
+        // No cabe entero: conservar su final si queda sitio suficiente
+        size_t overhead = MESSAGE_OVERHEAD + tokenizer_count(tok, TRUNCATED_MARK, strlen(TRUNCATED_MARK));
+        if (budget > st.tokens + overhead + MIN_TRUNCATED) {
+            size_t tail_tokens = 0;
+            cut_offset = tokenizer_tail(tok, msg.content, msg.content_len,
+                                        budget - st.tokens - overhead, &tail_tokens);
+            if (cut_offset < msg.content_len) {
+                cut_index = i;
+                st.tokens += tail_tokens + overhead;
+                st.truncated = 1;
+            }
+        }
+        break;
+    }
+
+    st.messages = (total - first) + (st.truncated ? 1 : 0);
+    st.dropped = total - st.messages;
+
+    // Mensaje del sistema, mensaje recortado y el resto tal como están guardados
+    int count = 0;
+    append_escaped(req, system_role, "", system_content, system_len, count++);
+
+    ContextMessage msg;
+    if (st.truncated && context_get(cut_index, &msg)) {
+        append_escaped(req, msg.role, TRUNCATED_MARK, msg.content + cut_offset,
+                       msg.content_len - cut_offset, count++);
+    }
+    for (size_t i = first; i < total; i++) {
+        if (!context_get(i, &msg)) continue;
+        append_separator(req, count++);
+        buffer_append(req, msg.json, msg.json_len);
+    }
+    context_unlock();
+
+    if (stats) *stats = st;
+    return count;
+}
+
+size_t context_window_history_tokens(const Tokenizer *tok, size_t *messages) {
+    context_lock();
+    size_t total = context_count();
+    size_t tokens = 0;
+    for (size_t i = 0; i < total; i++) {
+        ContextMessage msg;
+        if (context_get(i, &msg)) tokens += message_tokens(tok, i, &msg);
+    }
+    context_unlock();
+
+    if (messages) *messages = total;
+    return tokens;
+}
+
+void context_window_cleanup(void) {
+    free(cache.counts);
+    cache.counts = NULL;
+    cache.len = 0;
+    cache.tok = NULL;
+}
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "includes/diagnostics.h"
+#include "includes/buffer.h"
+#include "includes/exec.h"
+#include "includes/metrics.h"
+
+// Conjunto básico si el módulo no trae diagnostics.ini
+static const char* default_commands[] = {
+    "uname -a", "lsblk -f", "df -h", "free -h", NULL
+};
+
+// Un comando en marcha
+typedef struct {
+    DiagResult* result;
+    uint64_t deadline_ns;        // Plazo global (metrics_now)
+    pthread_t thread;
+    int started;                 // Se creó el hilo (hay que esperarlo)
+} DiagJob;
+
+static int add_command(DiagReport* report, const char* command) {
+    DiagResult* results = realloc(report->results, (report->count + 1) * sizeof(DiagResult));
+    if (!results) return 0;
+    report->results = results;
+
+    DiagResult* r = &report->results[report->count];
+    memset(r, 0, sizeof(*r));
+    r->exit_code = -1;
+    r->command = strdup(command);
+    if (!r->command) return 0;
+    report->count++;
+    return 1;
+}
+
+static char* trim_value(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+int diagnostics_load(DiagReport* report, const char* path) {
+    memset(report, 0, sizeof(*report));
+    report->timeout_s = DIAG_DEFAULT_TIMEOUT;
+
+    FILE* file = path ? fopen(path, "r") : NULL;
+    if (file) {
+        char line[2048];
+        while (fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\r\n")] = 0;
+            char* p = trim_value(line);
+            if (*p == '#' || *p == '\0') continue;
+
+            char* eq = strchr(p, '=');
+            if (!eq) continue;
+            *eq = '\0';
+            char* key = trim_value(p);
+            char* value = trim_value(eq + 1);
+
+            if (strcmp(key, "TIMEOUT") == 0) {
+                int timeout = atoi(value);
+                if (timeout > 0) report->timeout_s = timeout;
+            } else if (strcmp(key, "COMMAND") == 0 && *value) {
+                if (!add_command(report, value)) {
+                    fclose(file);
+                    return 0;
+                }
+            }
+        }
+        fclose(file);
+    }
+
+    // Sin archivo o con un archivo sin comandos
+    if (report->count == 0) {
+        for (int i = 0; default_commands[i]; i++) {
+            if (!add_command(report, default_commands[i])) return 0;
+        }
+    }
+    return 1;
+}
+
+// Cada comando corre con exec_run en su propio hilo, así todos avanzan a la vez
+static void* run_job(void* arg) {
+    DiagJob* job = arg;
+    ExecOptions options;
+    exec_options_init(&options);
+    options.max_output = DIAG_MAX_OUTPUT;
+
+    // El plazo es global: lo que quede de él cuando el hilo arranca
+    uint64_t now = metrics_now();
+    options.timeout_ms = now < job->deadline_ns ? (int)((job->deadline_ns - now + 999999) / 1000000) : 1;
+
+    DiagResult* result = job->result;
+    ExecResult run;
+    if (!exec_run(result->command, &options, &run)) return NULL;
+
+    // stdout y después stderr, como se mostrarían en el informe
+    Buffer out;
+    buffer_init(&out);
+    buffer_append(&out, run.out.data, run.out.len);
+    buffer_append(&out, run.err.data, run.err.len);
+    result->output = buffer_detach(&out);
+    result->exit_code = run.timed_out ? -1 : run.exit_code;
+    result->timed_out = run.timed_out;
+    result->elapsed_ms = run.elapsed_ms;
+    exec_result_free(&run);
+    return NULL;
+}
+
+int diagnostics_run(DiagReport* report) {
+    if (!report || report->count == 0) return 0;
+
+    DiagJob* jobs = calloc(report->count, sizeof(DiagJob));
+    if (!jobs) return 0;
+
+    uint64_t start = metrics_now();
+    uint64_t deadline = start + (uint64_t)report->timeout_s * 1000000000ULL;
+
+    for (size_t i = 0; i < report->count; i++) {
+        DiagResult* result = &report->results[i];
+        free(result->output);
+        result->output = NULL;
+        jobs[i].result = result;
+        jobs[i].deadline_ns = deadline;
+        jobs[i].started = pthread_create(&jobs[i].thread, NULL, run_job, &jobs[i]) == 0;
+        // Sin hilo disponible se ejecuta aquí mismo, contra el mismo plazo
+        if (!jobs[i].started) run_job(&jobs[i]);
+    }
+    for (size_t i = 0; i < report->count; i++) {
+        if (jobs[i].started) pthread_join(jobs[i].thread, NULL);
+    }
+    report->elapsed_ms = (metrics_now() - start) / 1e6;
+
+    int ok = 0;
+    for (size_t i = 0; i < report->count; i++) {
+        if (report->results[i].exit_code == 0) ok++;
+    }
+
+    free(jobs);
+    return ok;
+}
+
+char* diagnostics_format(const DiagReport* report) {
+    Buffer out;
+    buffer_init(&out);
+    double serial_ms = 0;
+    int failed = 0, timed_out = 0;
+
+    for (size_t i = 0; i < report->count; i++) {
+        const DiagResult* r = &report->results[i];
+        serial_ms += r->elapsed_ms;
+
+        if (r->timed_out) {
+            timed_out++;
+            buffer_appendf(&out, "=== %s === [⏱️ cortado tras %.2f s]\n", r->command, r->elapsed_ms / 1000.0);
+        } else {
+            if (r->exit_code != 0) failed++;
+            buffer_appendf(&out, "=== %s === [%.3f s, código %d]\n", r->command,
+                           r->elapsed_ms / 1000.0, r->exit_code);
+        }
+
+        if (r->output && *r->output) {
+            buffer_append_str(&out, r->output);
+            if (r->output[strlen(r->output) - 1] != '\n') buffer_append_str(&out, "\n");
+        } else if (!r->output) {
+            buffer_append_str(&out, "❌ No se pudo ejecutar\n");
+        }
+        buffer_append_str(&out, "\n");
+    }
+
+    buffer_appendf(&out, "Resumen: %zu comandos en %.2f s (en serie: %.2f s); %d con error, %d cortados por el plazo de %d s\n",
+                   report->count, report->elapsed_ms / 1000.0, serial_ms / 1000.0,
+                   failed, timed_out, report->timeout_s);
+    return buffer_detach(&out);
+}
+
+void diagnostics_free(DiagReport* report) {
+    if (!report) return;
+    for (size_t i = 0; i < report->count; i++) {
+        free(report->results[i].command);
+        free(report->results[i].output);
+    }
+    free(report->results);
+    memset(report, 0, sizeof(*report));
+}
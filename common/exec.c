@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "includes/exec.h"
+#include "includes/buffer.h"
+#include "includes/metrics.h"
+#include "includes/utf8.h"
+
+extern char** environ;
+
+#define REAP_CHECK_MS 100        // Sin pidfd: cada cuánto se comprueba si el shell ya terminó
+#define DRAIN_GRACE_MS 200       // Tras terminar, margen para leer lo que quede en los pipes
+
+// Acumula un flujo: los primeros head_cap bytes tal cual y los últimos
+// tail_cap en un buffer circular
+typedef struct {
+    Buffer head;
+    Buffer tail;
+    size_t tail_pos;             // Con el anillo lleno: byte más antiguo (siguiente a sobrescribir)
+    size_t head_cap;
+    size_t tail_cap;
+    size_t total;
+} Collector;
+
+static void collector_init(Collector* c, size_t max_output) {
+    memset(c, 0, sizeof(*c));
+    buffer_init(&c->head);
+    buffer_init(&c->tail);
+    c->head_cap = max_output ? max_output - max_output / 2 : SIZE_MAX;
+    c->tail_cap = max_output / 2;
+}
+
+static void collector_add(Collector* c, const char* data, size_t len) {
+    c->total += len;
+
+    size_t room = c->head_cap - c->head.len;
+    size_t n = len < room ? len : room;
+    buffer_append(&c->head, data, n);
+    data += n;
+    len -= n;
+    if (len == 0 || c->tail_cap == 0) return;
+
+    if (len >= c->tail_cap) {
+        // Solo importan los últimos tail_cap bytes
+        buffer_clear(&c->tail);
+        buffer_append(&c->tail, data + len - c->tail_cap, c->tail_cap);
+        c->tail_pos = 0;
+        return;
+    }
+    if (c->tail.len < c->tail_cap) {
+        n = c->tail_cap - c->tail.len;
+        if (n > len) n = len;
+        buffer_append(&c->tail, data, n);
+        data += n;
+        len -= n;
+    }
+    while (len > 0) {
+        n = c->tail_cap - c->tail_pos;
+        if (n > len) n = len;
+        memcpy(c->tail.data + c->tail_pos, data, n);
+        c->tail_pos = (c->tail_pos + n) % c->tail_cap;
+        data += n;
+        len -= n;
+    }
+}
+
+// Une principio y final (con una marca de lo omitido) y libera el colector
+static void collector_finish(Collector* c, ExecCapture* capture) {
+    capture->total = c->total;
+    capture->truncated = c->total > c->head.len + c->tail.len;
+
+    Buffer* out = &c->head;
+    if (capture->truncated) {
+        int newline = out->len > 0 && out->data[out->len - 1] != '\n';
+        buffer_appendf(out, "%s[... %zu bytes omitidos ...]\n", newline ? "\n" : "",
+                       c->total - c->head.len - c->tail.len);
+    }
+    buffer_append(out, c->tail.data + c->tail_pos, c->tail.len - c->tail_pos);
+    buffer_append(out, c->tail.data, c->tail_pos);
+    buffer_free(&c->tail);
+
+    // Salida binaria o cortes a mitad de carácter: se deja en UTF-8 válido
+    if (!utf8_is_valid(out->data ? out->data : "", out->len)) {
+        Buffer fixed;
+        buffer_init(&fixed);
+        utf8_repair_append(&fixed, out->data, out->len);
+        buffer_free(out);
+        *out = fixed;
+    }
+
+    capture->len = out->len;
+    capture->data = buffer_detach(out);
+    if (!capture->data) capture->len = 0;
+}
+
+// Lee lo disponible en fd; al llegar a EOF (o error) lo cierra y lo deja en -1.
+// Cada bloque leído se reenvía a on_output antes de guardarse
+static void drain_fd(int* fd, Collector* c, int stream, const ExecOptions* options) {
+    char chunk[16384];
+    ssize_t n = read(*fd, chunk, sizeof(chunk));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return;
+    if (n <= 0) {
+        close(*fd);
+        *fd = -1;
+        return;
+    }
+    if (options->on_output) options->on_output(stream, chunk, (size_t)n, options->output_ctx);
+    collector_add(c, chunk, (size_t)n);
+}
+
+// Cambia el grupo en primer plano del terminal. Un proceso que ya no está en
+// primer plano recibe SIGTTOU al hacerlo, así que se bloquea mientras tanto
+static void set_foreground(pid_t pgid) {
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTTOU);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    tcsetpgrp(STDIN_FILENO, pgid);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void exec_options_init(ExecOptions* options) {
+    options->timeout_ms = EXEC_DEFAULT_TIMEOUT_MS;
+    options->max_output = EXEC_DEFAULT_MAX_OUTPUT;
+    options->foreground = 0;
+    options->on_output = NULL;
+    options->output_ctx = NULL;
+}
+
+static int spawn_shell(const char* command, int out_fd, int err_fd, pid_t* pid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+
+    // Grupo de procesos propio y señales como las de un proceso recién lanzado
+    // (el cliente ignora SIGPIPE y captura SIGINT)
+    sigset_t defaults, mask;
+    sigemptyset(&defaults);
+    int reset[] = { SIGPIPE, SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD, SIGTERM };
+    for (size_t i = 0; i < sizeof(reset) / sizeof(reset[0]); i++) sigaddset(&defaults, reset[i]);
+    sigemptyset(&mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    char* argv[] = { "sh", "-c", (char*)command, NULL };
+    int rc = posix_spawn(pid, "/bin/sh", &actions, &attr, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    return rc;
+}
+
+int exec_run(const char* command, const ExecOptions* options, ExecResult* result) {
+    memset(result, 0, sizeof(*result));
+    result->exit_code = -1;
+    ExecOptions defaults;
+    if (!options) {
+        exec_options_init(&defaults);
+        options = &defaults;
+    }
+
+    int out_pipe[2], err_pipe[2];
+    if (pipe2(out_pipe, O_CLOEXEC) == -1) {
+        snprintf(result->error, sizeof(result->error), "pipe: %s", strerror(errno));
+        return 0;
+    }
+    if (pipe2(err_pipe, O_CLOEXEC) == -1) {
+        snprintf(result->error, sizeof(result->error), "pipe: %s", strerror(errno));
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return 0;
+    }
+
+    // Terminal en primer plano: se guarda su modo por si el comando lo altera
+    int foreground = options->foreground && isatty(STDIN_FILENO) &&
+                     tcgetpgrp(STDIN_FILENO) == getpgrp();
+    struct termios saved_tty;
+    if (foreground && tcgetattr(STDIN_FILENO, &saved_tty) != 0) foreground = 0;
+
+    uint64_t start = metrics_now();
+    pid_t pid;
+    int rc = spawn_shell(command, out_pipe[1], err_pipe[1], &pid);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if (rc != 0) {
+        snprintf(result->error, sizeof(result->error), "posix_spawn: %s", strerror(rc));
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        return 0;
+    }
+
+    if (foreground) {
+        set_foreground(pid);
+        // Si llegó a leer del terminal antes de tenerlo, se habrá detenido con SIGTTIN
+        kill(-pid, SIGCONT);
+    }
+
+    // pidfd (Linux >= 5.3) se vuelve legible justo cuando el shell termina
+#ifdef SYS_pidfd_open
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    int pidfd = -1;
+#endif
+
+    uint64_t deadline = options->timeout_ms > 0 ? start + (uint64_t)options->timeout_ms * 1000000ULL : 0;
+    int fds[2] = { out_pipe[0], err_pipe[0] };
+    Collector collectors[2];
+    collector_init(&collectors[0], options->max_output);
+    collector_init(&collectors[1], options->max_output);
+
+    int status = 0;
+    int reaped = 0;
+    uint64_t reaped_at = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+
+    // Con los pipes cerrados se sigue esperando al shell (p. ej. "exec >/dev/null; sleep 60"),
+    // siempre contra el plazo
+    while (!reaped || fds[0] >= 0 || fds[1] >= 0) {
+        uint64_t now = metrics_now();
+        if (deadline && now >= deadline) {
+            result->timed_out = 1;
+            break;
+        }
+        // Terminado el shell, si algún proceso en segundo plano mantiene el pipe abierto no se le espera
+        if (reaped && now - reaped_at >= DRAIN_GRACE_MS * 1000000ULL) break;
+
+        int wait_ms = reaped ? DRAIN_GRACE_MS : pidfd >= 0 ? -1 : REAP_CHECK_MS;
+        if (deadline && (wait_ms < 0 || (deadline - now) / 1000000 < (uint64_t)wait_ms)) {
+            wait_ms = (int)((deadline - now) / 1000000) + 1;
+        }
+
+        struct pollfd pfds[3];
+        nfds_t nfds = 0;
+        int owners[3];
+        for (int i = 0; i < 2; i++) {
+            if (fds[i] < 0) continue;
+            pfds[nfds].fd = fds[i];
+            pfds[nfds].events = POLLIN;
+            pfds[nfds].revents = 0;
+            owners[nfds++] = i;
+        }
+        if (pidfd >= 0 && !reaped) {
+            pfds[nfds].fd = pidfd;
+            pfds[nfds].events = POLLIN;
+            pfds[nfds].revents = 0;
+            owners[nfds++] = -1;
+        }
+
+        int n = poll(pfds, nfds, wait_ms);
+        if (n < 0 && errno != EINTR) break;
+        for (nfds_t k = 0; n > 0 && k < nfds; k++) {
+            if (pfds[k].revents && owners[k] >= 0) drain_fd(&fds[owners[k]], &collectors[owners[k]], owners[k], options);
+        }
+
+        if (!reaped && wait4(pid, &status, WNOHANG, &usage) == pid) {
+            reaped = 1;
+            reaped_at = metrics_now();
+            result->elapsed_ms = (reaped_at - start) / 1e6;
+        }
+    }
+
+    if (result->timed_out) {
+        // Se mata el grupo entero: el shell y todo lo que haya lanzado
+        kill(-pid, SIGKILL);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+    if (pidfd >= 0) close(pidfd);
+    if (!reaped) {
+        while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {}
+        result->elapsed_ms = (metrics_now() - start) / 1e6;
+    }
+
+    if (foreground) {
+        set_foreground(getpgrp());
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &saved_tty);
+    }
+
+    collector_finish(&collectors[0], &result->out);
+    collector_finish(&collectors[1], &result->err);
+
+    if (WIFEXITED(status)) {
+        result->exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        result->signal = WTERMSIG(status);
+    }
+    result->user_ms = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+    result->sys_ms = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+    result->max_rss_kb = usage.ru_maxrss;
+    return 1;
+}
+
+void exec_result_free(ExecResult* result) {
+    if (!result) return;
+    free(result->out.data);
+    free(result->err.data);
+    result->out.data = NULL;
+    result->err.data = NULL;
+}
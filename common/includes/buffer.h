@@ -0,0 +1,33 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>
+
+// Buffer de bytes que crece de forma geométrica (siempre terminado en '\0')
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+// Inicializa un buffer vacío (no reserva memoria)
+void buffer_init(Buffer *buf);
+
+// Garantiza espacio para `extra` bytes más el terminador
+int buffer_reserve(Buffer *buf, size_t extra);
+
+// Añade bytes, una cadena o texto con formato al final del buffer
+int buffer_append(Buffer *buf, const char *data, size_t len);
+int buffer_append_str(Buffer *buf, const char *str);
+int buffer_appendf(Buffer *buf, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Vacía el buffer conservando la memoria reservada
+void buffer_clear(Buffer *buf);
+
+// Entrega la memoria al llamador (nunca NULL salvo sin memoria) y reinicia el buffer
+char* buffer_detach(Buffer *buf);
+
+// Libera la memoria del buffer
+void buffer_free(Buffer *buf);
+
+#endif /* BUFFER_H */
@@ -0,0 +1,40 @@
+/*
+ * code_blocks.h - Bloques de código de una respuesta en Markdown
+ * Recorre el texto una sola vez y reconoce bloques con ``` o ~~~ (también
+ * sangrados, por ejemplo dentro de una lista) y líneas "$ comando" sueltas.
+ */
+
+#ifndef CODE_BLOCKS_H
+#define CODE_BLOCKS_H
+
+#include <stddef.h>
+
+// Bloque encontrado
+typedef struct {
+    char *language;              // Primera palabra tras la valla ("" si no hay)
+    char *body;                  // Contenido sin la valla ni la sangría común
+    size_t offset;               // Posición en el texto de la valla o de la línea "$"
+    int prompt;                  // 1 si viene de líneas "$ comando" fuera de un bloque
+} CodeBlock;
+
+typedef struct {
+    CodeBlock *items;
+    size_t count;
+} CodeBlockList;
+
+// Rellena list con todos los bloques de text, en orden. Devuelve el número de bloques
+size_t code_blocks_scan(const char *text, CodeBlockList *list);
+
+// Como code_blocks_scan, pero solo con los bloques que son comandos de shell
+// (bash, sh, shell, zsh, console, terminal, extra_language, sin lenguaje o "$")
+size_t code_blocks_commands(const char *text, const char *extra_language, CodeBlockList *list);
+
+// Libera los bloques
+void code_blocks_free(CodeBlockList *list);
+
+// Interpreta la elección del usuario entre count bloques: "t"/"todos"/"s" = todos,
+// "2", "1,3", "1-3 5"... selected[i] queda a 1 para los elegidos.
+// Devuelve cuántos se eligieron (0 = ninguno o respuesta no válida)
+size_t code_blocks_parse_selection(const char *answer, size_t count, int *selected);
+
+#endif /* CODE_BLOCKS_H */
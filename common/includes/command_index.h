@@ -0,0 +1,47 @@
+/*
+ * command_index.h - Índice de comandos disponibles en el sistema
+ * Trie compacto con los ejecutables de los directorios de $PATH y las órdenes
+ * internas de la shell. Se guarda en disco junto con una huella del PATH y de
+ * la fecha de modificación de cada directorio, así que solo se vuelve a
+ * recorrer el PATH cuando se instala o se quita algo.
+ */
+
+#ifndef COMMAND_INDEX_H
+#define COMMAND_INDEX_H
+
+#include <stddef.h>
+
+#define COMMAND_INDEX_FILE "command_index.db"
+
+typedef struct CommandIndex CommandIndex;
+
+// Carga el índice de cache_path si sigue siendo válido; si no, recorre el PATH,
+// lo construye y lo guarda (cache_path NULL = sin caché en disco)
+CommandIndex* command_index_load(const char *cache_path);
+
+// 1 si name (len bytes) es un ejecutable del PATH o una orden interna.
+// Cuesta O(len): un paso por el trie por carácter
+int command_index_contains(const CommandIndex *index, const char *name, size_t len);
+
+// 1 si algún directorio del PATH (o el propio PATH) cambió desde que se construyó
+int command_index_stale(const CommandIndex *index);
+
+// Nombres distintos en el índice
+size_t command_index_count(const CommandIndex *index);
+
+// 1 si se cargó de la caché en disco, 0 si se recorrió el PATH
+int command_index_cached(const CommandIndex *index);
+
+void command_index_free(CommandIndex *index);
+
+// Índice compartido del proceso (COMMAND_INDEX_FILE), creado en la primera llamada
+CommandIndex* command_index_shared(void);
+
+// 1 si la primera palabra de text es un comando conocido (saltando asignaciones
+// VAR=valor) o una ruta ejecutable. Las preguntas ("¿...", "...?") no lo son.
+// Si la palabra no está y el PATH cambió, rehace el índice antes de responder
+int command_index_is_command(const char *text);
+
+void command_index_cleanup(void);
+
+#endif /* COMMAND_INDEX_H */
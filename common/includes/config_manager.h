@@ -20,6 +20,25 @@
      char role_file[256];         // Ruta al archivo del rol
      char system_role[50];        // Rol del sistema (system, user, assistant)
      char system_content[2048];   // Contenido del mensaje del sistema
+     int connect_timeout;         // Timeout de conexión HTTP (segundos)
+     int request_timeout;         // Timeout total de la petición HTTP (segundos)
+     int stream;                  // 1 = respuestas en streaming (SSE)
+     int live_output;             // 1 = la salida de los comandos se muestra mientras corren
+     int output_tokens;           // Tokens de salida de un comando que se guardan en el contexto (0 = sin límite)
+     int command_timeout;         // Plazo de un comando aprobado (segundos, 0 = sin límite)
+     int command_max_output;      // KiB retenidos de cada flujo de un comando (0 = sin límite)
+     int context_tokens;          // Presupuesto de tokens del historial (0 = sin límite)
+     char tokenizer_file[256];    // Tablas BPE (.tiktoken); vacío = estimación
+     int compact_tokens;          // Umbral para resumir turnos antiguos (0 = nunca)
+     int compact_keep;            // Mensajes recientes que no se resumen
+     int cache;                   // Caché de respuestas: 0 = no, 1 = sí (solo TEMPERATURE=0), 2 = forzada
+     int cache_ttl;               // Caducidad de las respuestas cacheadas (segundos, 0 = nunca)
+     int cache_size_mb;           // Tamaño máximo del archivo de caché
+     int rate_limit_rpm;          // Peticiones por minuto (0 = sin límite)
+     int rate_limit_tpm;          // Tokens por minuto (0 = sin límite)
+     int max_retries;             // Reintentos ante 429, 5xx o cortes de conexión
+     char metrics_file[256];      // Archivo Prometheus (textfile collector); vacío = no se exporta
+     int metrics_interval;        // Segundos entre reescrituras de metrics_file
  } GPTConfig;
  
  // Inicializa la configuración con valores predeterminados
@@ -34,4 +53,28 @@
  // Lee la clave API desde el archivo configurado
  char* config_get_api_key(const GPTConfig *config);
  
+ // Configuración del proceso: se carga una vez al arrancar y se recarga sola
+ // (vía inotify) cuando cambian config.ini, el archivo de rol o la clave API
+ typedef struct {
+     GPTConfig config;            // Configuración vigente
+     char api_key[256];           // Clave API en memoria ("" si no se pudo leer)
+     char config_file[256];       // Ruta del config.ini del módulo
+     int inotify_fd;              // -1 si inotify no está disponible
+     int watch_fds[3];            // Directorios vigilados
+     int watch_count;
+     unsigned long generation;    // Se incrementa en cada recarga
+ } GPTConfigStore;
+ 
+ // Carga la configuración del módulo y empieza a vigilar sus archivos
+ GPTConfigStore* config_store_open(const char *config_file);
+ 
+ // Aplica cambios pendientes en disco (sin bloquear). Devuelve 1 si recargó
+ int config_store_refresh(GPTConfigStore *store);
+ 
+ // Devuelve la configuración vigente tras aplicar cambios pendientes
+ const GPTConfig* config_store_get(GPTConfigStore *store);
+ 
+ // Libera la configuración y deja de vigilar los archivos
+ void config_store_close(GPTConfigStore *store);
+ 
  #endif /* CONFIG_MANAGER_H */
\ No newline at end of file
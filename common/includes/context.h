@@ -1,5 +1,60 @@
 #ifndef CONTEXT_H
 #define CONTEXT_H
-void append_to_context(const char* cmd, const char* output);
+
+#include <stddef.h>
+
+// Almacén de conversación: log binario append-only (context.db) con índice de
+// offsets (context.idx). Se lee mediante mmap y cada mensaje guarda además su
+// forma JSON ya escapada, lista para copiarse en la solicitud.
+#define CONTEXT_FILE "context.db"
+#define CONTEXT_INDEX_FILE "context.idx"
+#define CONTEXT_ARCHIVE_FILE "context.archive"  // Turnos originales ya compactados
+
+// Mensaje leído del almacén (los punteros son válidos hasta la siguiente escritura;
+// con la compactación en segundo plano, leer entre context_lock y context_unlock)
+typedef struct {
+    const char* role;            // "system", "user" o "assistant"
+    const char* content;         // Texto original (terminado en '\0')
+    size_t content_len;
+    const char* json;            // {"role": "...", "content": "..."} ya escapado
+    size_t json_len;
+} ContextMessage;
+
+// Abre (o crea) el almacén; importa context.txt si existe de una versión anterior
 void load_context();
-#endif
+
+// Registra un intercambio usuario/asistente
+void append_to_context(const char* cmd, const char* output);
+
+// Añade un mensaje con el rol indicado. Devuelve 1 si se guardó
+int context_append(const char* role, const char* content);
+
+// Quita el último mensaje si es role con exactamente content (deshace un
+// context_append cuyo turno falló). Devuelve 1 si lo quitó
+int context_drop_last(const char* role, const char* content);
+
+// Número de mensajes almacenados
+size_t context_count();
+
+// Lee el mensaje index (0 = más antiguo). Devuelve 1 si existe
+int context_get(size_t index, ContextMessage* msg);
+
+// Borra toda la conversación
+void context_clear();
+
+// Cambia cada vez que se borra o compacta la conversación (invalida cachés por índice)
+unsigned long context_generation();
+
+// Sustituye los count mensajes más antiguos por un mensaje "system" con summary.
+// Los originales se añaden a CONTEXT_ARCHIVE_FILE. No hace nada (devuelve 0) si
+// la conversación cambió de generación desde que se leyeron
+int context_compact(unsigned long generation, size_t count, const char* summary);
+
+// Bloquea el almacén mientras se usan punteros de context_get desde otro hilo
+void context_lock();
+void context_unlock();
+
+// Cierra el almacén y libera el mapeo
+void context_close();
+
+#endif /* CONTEXT_H */
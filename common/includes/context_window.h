@@ -0,0 +1,36 @@
+/*
+ * context_window.h - Selección del historial que cabe en el presupuesto de tokens
+ * Siempre entran el mensaje del sistema y el último mensaje; el resto se añade
+ * del más reciente al más antiguo y el primero que no cabe entero se recorta.
+ */
+
+#ifndef CONTEXT_WINDOW_H
+#define CONTEXT_WINDOW_H
+
+#include <stddef.h>
+#include "buffer.h"
+#include "tokenizer.h"
+
+// Resultado de la selección
+typedef struct {
+    size_t tokens;               // Tokens enviados (incluye el formato de cada mensaje)
+    size_t budget;               // Presupuesto aplicado (0 = sin límite)
+    size_t messages;             // Mensajes del historial incluidos
+    size_t dropped;              // Mensajes antiguos omitidos
+    int truncated;               // El mensaje más antiguo incluido se recortó
+    int estimated;               // Conteo aproximado (sin tablas BPE)
+} ContextWindowStats;
+
+// Añade al array "messages" de req el mensaje del sistema y el historial más
+// reciente que cabe en budget tokens. Devuelve el número de mensajes añadidos
+int context_window_append(Buffer *req, const Tokenizer *tok, size_t budget,
+                          const char *system_role, const char *system_content,
+                          ContextWindowStats *stats);
+
+// Tokens de todo el historial guardado; messages recibe el número de mensajes
+size_t context_window_history_tokens(const Tokenizer *tok, size_t *messages);
+
+// Libera la caché de tokens por mensaje
+void context_window_cleanup(void);
+
+#endif /* CONTEXT_WINDOW_H */
@@ -0,0 +1,53 @@
+/*
+ * diagnostics.h - Conjuntos de comandos de diagnóstico ejecutados en paralelo
+ * Cada módulo describe sus comandos en un archivo diagnostics.ini:
+ *
+ *   TIMEOUT=10            # plazo global en segundos
+ *   COMMAND=lsblk -f      # uno por línea; el informe conserva este orden
+ *
+ * Todos los comandos se lanzan a la vez, así que el diagnóstico tarda lo que el
+ * más lento (o el plazo), no la suma de todos.
+ */
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stddef.h>
+
+#define DIAG_FILE_NAME "diagnostics.ini"
+#define DIAG_DEFAULT_TIMEOUT 15      // Plazo global predeterminado (segundos)
+#define DIAG_MAX_OUTPUT (1 << 20)    // Salida máxima que se conserva por comando
+
+// Resultado de un comando
+typedef struct {
+    char* command;
+    char* output;                // stdout + stderr (NULL si no llegó a ejecutarse)
+    int exit_code;               // -1 si no terminó o murió por una señal
+    int timed_out;               // Se cortó al vencer el plazo global
+    double elapsed_ms;
+} DiagResult;
+
+// Conjunto de comandos y, tras ejecutarlo, sus resultados
+typedef struct {
+    DiagResult* results;
+    size_t count;
+    int timeout_s;               // Plazo global
+    double elapsed_ms;           // Duración total del diagnóstico
+} DiagReport;
+
+// Carga el conjunto de comandos de path; sin archivo se usa uno básico.
+// Devuelve 0 solo si falta memoria
+int diagnostics_load(DiagReport* report, const char* path);
+
+// Ejecuta todos los comandos a la vez, cada uno con exec_run en su hilo; al
+// vencer el plazo mata los que sigan corriendo (con su grupo de procesos).
+// Devuelve el número de comandos que terminaron con código 0
+int diagnostics_run(DiagReport* report);
+
+// Informe en texto, en el orden del archivo, con el tiempo de cada comando (liberar con free)
+char* diagnostics_format(const DiagReport* report);
+
+// Libera los comandos y resultados
+void diagnostics_free(DiagReport* report);
+
+#endif /* DIAGNOSTICS_H */
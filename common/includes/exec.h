@@ -0,0 +1,64 @@
+/*
+ * exec.h - Ejecución de comandos con posix_spawn y captura por poll
+ * stdout y stderr llegan por pipes separados y se guardan en buffers que
+ * crecen hasta un límite; si la salida lo supera se conservan el principio y
+ * el final. El comando corre en su propio grupo de procesos, de modo que al
+ * vencer el plazo se mata junto con todo lo que haya lanzado.
+ */
+
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <stddef.h>
+
+#define EXEC_DEFAULT_TIMEOUT_MS (10 * 60 * 1000)  // Plazo predeterminado: 10 minutos
+#define EXEC_DEFAULT_MAX_OUTPUT (1 << 20)          // Bytes retenidos por flujo
+
+#define EXEC_STDOUT 0
+#define EXEC_STDERR 1
+
+// Recibe la salida a medida que el comando la produce (stream = EXEC_STDOUT o EXEC_STDERR)
+typedef void (*ExecOutputCallback)(int stream, const char* data, size_t len, void* ctx);
+
+// Opciones de una ejecución
+typedef struct {
+    int timeout_ms;              // Plazo total (0 = sin límite)
+    size_t max_output;           // Bytes retenidos por flujo (0 = sin límite)
+    int foreground;              // Cede el terminal al comando: Ctrl-C y las preguntas le llegan a él
+    ExecOutputCallback on_output; // Opcional: recibe cada bloque sin esperar al final
+    void* output_ctx;
+} ExecOptions;
+
+// Salida capturada de un flujo (la recibida por on_output se guarda igualmente)
+typedef struct {
+    char* data;                  // Texto retenido en UTF-8 válido (terminado en '\0', nunca NULL tras exec_run)
+    size_t len;
+    size_t total;                // Bytes que escribió el comando
+    int truncated;               // total superó max_output: se omitió la parte central
+} ExecCapture;
+
+// Resultado de una ejecución
+typedef struct {
+    ExecCapture out;             // stdout
+    ExecCapture err;             // stderr
+    int exit_code;               // Código de salida (-1 si terminó por una señal)
+    int signal;                  // Señal que lo terminó (0 si salió normalmente)
+    int timed_out;               // Se mató al vencer el plazo
+    double elapsed_ms;           // Tiempo real
+    double user_ms;              // CPU en modo usuario (incluye los hijos que esperó)
+    double sys_ms;               // CPU en modo sistema
+    long max_rss_kb;             // Memoria residente máxima
+    char error[128];             // Motivo si no se pudo lanzar
+} ExecResult;
+
+// Opciones predeterminadas
+void exec_options_init(ExecOptions* options);
+
+// Ejecuta command con /bin/sh -c y espera a que termine o venza el plazo.
+// Devuelve 1 si el proceso llegó a lanzarse (result queda relleno) y 0 si no
+int exec_run(const char* command, const ExecOptions* options, ExecResult* result);
+
+// Libera las salidas capturadas
+void exec_result_free(ExecResult* result);
+
+#endif /* EXEC_H */
@@ -0,0 +1,17 @@
+#ifndef JSON_ESCAPE_H
+#define JSON_ESCAPE_H
+
+#include <stddef.h>
+#include "buffer.h"
+
+// Añade input (len bytes) escapado como contenido de una cadena JSON.
+// Busca los bytes a escapar con SSE2 o AVX2 (según la CPU) y copia el resto por bloques
+int json_escape_append(Buffer *out, const char *input, size_t len);
+
+// Implementación en uso: "avx2", "sse2" o "scalar"
+const char* json_escape_impl(void);
+
+// Devuelve una copia escapada de input (liberar con free)
+char* escape_json(const char *input);
+
+#endif /* JSON_ESCAPE_H */
@@ -0,0 +1,78 @@
+/*
+ * json_reader.h - Lector JSON incremental (pull/SAX) sin construir un DOM
+ * Los tokens apuntan directamente al buffer del llamador (zero-copy); las
+ * cadenas se desescapan solo cuando se piden, en buffers del llamador.
+ */
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stddef.h>
+
+#define JSON_MAX_DEPTH 64
+
+// Tokens que devuelve json_reader_next
+typedef enum {
+    JSON_TOK_ERROR = -1,         // JSON inválido
+    JSON_TOK_NEED_MORE = 0,      // Entrada parcial: llamar a json_reader_feed con más datos
+    JSON_TOK_END,                // Fin del documento
+    JSON_TOK_OBJECT_BEGIN,
+    JSON_TOK_OBJECT_END,
+    JSON_TOK_ARRAY_BEGIN,
+    JSON_TOK_ARRAY_END,
+    JSON_TOK_KEY,
+    JSON_TOK_STRING,
+    JSON_TOK_NUMBER,
+    JSON_TOK_TRUE,
+    JSON_TOK_FALSE,
+    JSON_TOK_NULL
+} JsonToken;
+
+// Estado del lector
+typedef struct {
+    const char *buf;             // Datos disponibles (propiedad del llamador)
+    size_t len;
+    size_t pos;                  // Siguiente byte por leer
+    int final;                   // 1 = no llegarán más datos
+    int state;                   // Qué se espera a continuación
+    int depth;
+    unsigned char stack[JSON_MAX_DEPTH];  // '{' o '[' por nivel
+    const char *value;           // Último token: cadenas sin comillas y aún escapadas
+    size_t value_len;
+    int value_escaped;           // La cadena contiene secuencias de escape
+} JsonReader;
+
+// Valor encontrado por json_find (apunta al JSON original)
+typedef struct {
+    JsonToken type;
+    const char *raw;             // Cadenas: contenido sin comillas; contenedores: desde '{'/'[' hasta el cierre
+    size_t raw_len;
+    int escaped;
+} JsonValue;
+
+// Inicializa el lector sobre buf; final = 0 si aún pueden llegar más datos
+void json_reader_init(JsonReader *reader, const char *buf, size_t len, int final);
+
+// Amplía la entrada: buf debe conservar los bytes anteriores en los mismos offsets
+void json_reader_feed(JsonReader *reader, const char *buf, size_t len, int final);
+
+// Devuelve el siguiente token
+JsonToken json_reader_next(JsonReader *reader);
+
+// Salta el valor que empieza con tok (objetos y arrays completos). 1 = ok
+int json_reader_skip(JsonReader *reader, JsonToken tok);
+
+// Desescapa una cadena JSON (incluye \uXXXX y pares suplentes) en out.
+// Devuelve la longitud completa resultante; escribe como mucho out_size - 1 bytes + '\0'.
+size_t json_unescape(const char *raw, size_t raw_len, char *out, size_t out_size);
+
+// Busca un valor por ruta ("choices.0.message.content"). 1 = encontrado
+int json_find(const char *json, size_t len, const char *path, JsonValue *out);
+
+// Devuelve una copia desescapada de la cadena en path, o NULL si no existe o no es cadena
+char* json_get_string(const char *json, size_t len, const char *path);
+
+// Devuelve el booleano en path, o default_value si no existe
+int json_get_bool(const char *json, size_t len, const char *path, int default_value);
+
+#endif /* JSON_READER_H */
@@ -0,0 +1,72 @@
+/*
+ * metrics.h - Tiempos por etapa del turno y contadores del proceso
+ * Cada etapa se mide con el reloj monotónico y se acumula en un histograma sin
+ * bloqueos. Con --trace se escribe además un evento por tramo en formato Chrome
+ * trace-event (chrome://tracing, Perfetto), y con METRICS_FILE un hilo reescribe
+ * periódicamente un archivo de texto Prometheus para el textfile collector.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+// Etapas de un turno
+typedef enum {
+    METRIC_STAGE_TURN,           // Turno completo (send_prompt)
+    METRIC_STAGE_CONFIG,         // Carga o refresco de la configuración
+    METRIC_STAGE_CONTEXT,        // Selección del historial que cabe en el presupuesto
+    METRIC_STAGE_ESCAPE,         // Escape JSON de mensajes
+    METRIC_STAGE_CONNECT,        // DNS + TCP + TLS (0 si se reutiliza la conexión)
+    METRIC_STAGE_TTFB,           // Desde conectado hasta el primer byte de la respuesta
+    METRIC_STAGE_TRANSFER,       // Desde el primer byte hasta el final de la respuesta
+    METRIC_STAGE_PARSE,          // Extracción del texto de la respuesta (JSON o SSE)
+    METRIC_STAGE_EXTRACT,        // Búsqueda de comandos en la respuesta
+    METRIC_STAGE_MCP,            // Ida y vuelta al bridge MCP
+    METRIC_STAGE_EXEC,           // Ejecución de un comando (incluye MCP si se usa)
+    METRIC_STAGE_COUNT
+} MetricStage;
+
+// Contadores acumulados desde el arranque
+typedef enum {
+    METRIC_TURNS,                // Turnos enviados al modelo
+    METRIC_HTTP_REQUESTS,        // Peticiones HTTP (incluye reintentos y resúmenes)
+    METRIC_HTTP_ERRORS,          // Errores de transporte o respuestas no 2xx
+    METRIC_BYTES_SENT,           // Bytes de cuerpo enviados
+    METRIC_BYTES_RECEIVED,       // Bytes de cuerpo recibidos
+    METRIC_PROMPT_TOKENS,        // Tokens enviados (historial + prompt)
+    METRIC_COMPLETION_TOKENS,    // Tokens de las respuestas
+    METRIC_CACHE_HITS,           // Respuestas servidas desde la caché
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// Instante actual del reloj monotónico en nanosegundos
+uint64_t metrics_now(void);
+
+// Cierra el tramo de stage que empezó en start_ns (metrics_now())
+void metrics_span(MetricStage stage, uint64_t start_ns);
+
+// Registra un tramo ya medido que empezó en start_ns y duró dur_ns
+void metrics_span_at(MetricStage stage, uint64_t start_ns, uint64_t dur_ns);
+
+// Acumula dur_ns en las estadísticas de stage sin emitir evento de traza
+// (para tiempos repartidos en muchos fragmentos, como el parseo SSE)
+void metrics_observe(MetricStage stage, uint64_t dur_ns);
+
+// Suma n al contador
+void metrics_add(MetricCounter counter, uint64_t n);
+
+// Empieza a escribir la traza en path. Devuelve 0 si no se pudo abrir
+int metrics_trace_open(const char *path);
+
+// Reescribe path cada interval_s segundos en formato Prometheus con la etiqueta
+// module="..."; path vacío o NULL no hace nada. Devuelve 0 si falló
+int metrics_export_start(const char *path, int interval_s, const char *module);
+
+// Escribe las métricas en path de forma atómica (archivo temporal + rename)
+int metrics_write_prometheus(const char *path);
+
+// Detiene la exportación (con una última escritura) y cierra la traza
+void metrics_shutdown(void);
+
+#endif /* METRICS_H */
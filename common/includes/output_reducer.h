@@ -0,0 +1,35 @@
+/*
+ * output_reducer.h - Reducción de la salida de un comando antes de guardarla
+ * en la conversación. Quita secuencias ANSI y barras de progreso. Si no cabe en
+ * el presupuesto de tokens, agrupa las líneas repetidas (idénticas o iguales
+ * salvo por la marca de tiempo inicial) y, si aun así no cabe, conserva el
+ * principio, el final y las líneas con errores o avisos.
+ */
+
+#ifndef OUTPUT_REDUCER_H
+#define OUTPUT_REDUCER_H
+
+#include <stddef.h>
+#include "tokenizer.h"
+
+#define OUTPUT_LINE_MAX 2048     // Bytes que se conservan de una línea muy larga
+
+// Tamaños antes y después de reducir
+typedef struct {
+    size_t original_bytes;
+    size_t original_lines;
+    size_t original_tokens;
+    size_t reduced_bytes;
+    size_t reduced_lines;
+    size_t reduced_tokens;
+    size_t collapsed_lines;      // Líneas repetidas agrupadas en un "[×N]" (solo si no cabía)
+    size_t omitted_lines;        // Líneas que no cupieron en el presupuesto
+    size_t kept_matches;         // Líneas con error/warn/fail conservadas del tramo central
+} OutputReduceStats;
+
+// Devuelve la salida reducida a como mucho max_tokens (0 = sin límite; solo
+// limpieza, sin agrupar ni omitir). tok NULL = estimación. Liberar con free
+char* output_reduce(const char *text, size_t len, const Tokenizer *tok,
+                    size_t max_tokens, OutputReduceStats *stats);
+
+#endif /* OUTPUT_REDUCER_H */
@@ -0,0 +1,52 @@
+/*
+ * response_cache.h - Caché de respuestas en disco (archivo mapeado en memoria)
+ * Tabla asociativa por conjuntos de ranuras de tamaño fijo, indexada por un
+ * hash SHA-256 de la solicitud, con caducidad (TTL) y reemplazo LRU.
+ */
+
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include "sha256.h"
+
+#define RESPONSE_CACHE_FILE "response_cache.db"
+
+typedef struct ResponseCache ResponseCache;
+
+// Contadores de la caché (acumulados en el archivo y de este proceso)
+typedef struct {
+    unsigned long hits;          // Aciertos totales
+    unsigned long misses;        // Fallos totales
+    unsigned long stores;        // Respuestas guardadas
+    unsigned long evictions;     // Entradas válidas reemplazadas
+    unsigned long session_hits;  // Aciertos de este proceso
+    unsigned long session_misses;
+    size_t entries;              // Entradas ocupadas
+    size_t slots;                // Capacidad en entradas
+    size_t max_response;         // Tamaño máximo de una respuesta cacheable
+    size_t size_bytes;           // Tamaño del archivo
+} ResponseCacheStats;
+
+// Abre (o crea) la caché de size_mb megabytes en path
+ResponseCache* response_cache_open(const char *path, size_t size_mb);
+
+// Tamaño con el que se abrió (para detectar cambios de configuración)
+size_t response_cache_size_mb(const ResponseCache *cache);
+
+// Busca key; devuelve una copia de la respuesta (liberar con free) o NULL.
+// Las entradas con más de ttl_seconds se consideran caducadas (0 = sin caducidad)
+char* response_cache_get(ResponseCache *cache, const unsigned char key[SHA256_DIGEST_SIZE],
+                         long ttl_seconds);
+
+// Guarda la respuesta de key. Devuelve 0 si no cabe en una ranura
+int response_cache_put(ResponseCache *cache, const unsigned char key[SHA256_DIGEST_SIZE],
+                       long ttl_seconds, const char *data, size_t len);
+
+// Rellena los contadores
+void response_cache_stats(ResponseCache *cache, ResponseCacheStats *stats);
+
+// Desmapea y cierra la caché
+void response_cache_close(ResponseCache *cache);
+
+#endif /* RESPONSE_CACHE_H */
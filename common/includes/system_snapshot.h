@@ -0,0 +1,66 @@
+/*
+ * system_snapshot.h - Estado del sistema leído directamente de /proc, /sys,
+ * statvfs y uname(2), sin lanzar uname, df, free ni lsblk.
+ * Una captura completa cuesta del orden de un milisegundo.
+ */
+
+#ifndef SYSTEM_SNAPSHOT_H
+#define SYSTEM_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SNAPSHOT_MAX_MOUNTS 32
+#define SNAPSHOT_MAX_BLOCKS 32
+
+// Sistema de archivos montado (solo los que tienen almacenamiento real)
+typedef struct {
+    char device[128];
+    char mountpoint[256];
+    char fstype[32];
+    uint64_t total_bytes;
+    uint64_t avail_bytes;        // Disponible para usuarios sin privilegios
+    uint64_t used_bytes;
+} SnapshotMount;
+
+// Dispositivo de bloques de /sys/block (sin loop ni ram)
+typedef struct {
+    char name[32];
+    char model[64];
+    uint64_t size_bytes;
+    int removable;
+    int rotational;
+} SnapshotBlock;
+
+typedef struct {
+    char sysname[65];            // uname(2)
+    char nodename[65];
+    char release[65];
+    char version[65];
+    char machine[65];
+    char cpu_model[128];         // /proc/cpuinfo
+    int cpu_count;
+    double load[3];              // /proc/loadavg
+    int procs_running;
+    int procs_total;
+    double uptime_s;             // /proc/uptime
+    uint64_t mem_total;          // /proc/meminfo, en bytes
+    uint64_t mem_available;
+    uint64_t swap_total;
+    uint64_t swap_free;
+    SnapshotMount mounts[SNAPSHOT_MAX_MOUNTS];
+    size_t mount_count;
+    SnapshotBlock blocks[SNAPSHOT_MAX_BLOCKS];
+    size_t block_count;
+} SystemSnapshot;
+
+// Rellena snap; los datos que no se puedan leer quedan a cero. Devuelve 0 si falló uname
+int system_snapshot_collect(SystemSnapshot* snap);
+
+// Resumen compacto en texto, pensado para mostrarse o incluirse en el prompt (liberar con free)
+char* system_snapshot_text(const SystemSnapshot* snap);
+
+// La misma información como objeto JSON de una línea (liberar con free)
+char* system_snapshot_json(const SystemSnapshot* snap);
+
+#endif /* SYSTEM_SNAPSHOT_H */
@@ -0,0 +1,42 @@
+/*
+ * tokenizer.h - Tokenizador BPE local compatible con cl100k/o200k
+ * Carga las tablas en formato .tiktoken ("<token en base64> <rango>" por línea)
+ * y cuenta tokens sin llamar a la API. Sin tablas, estima ~4 bytes por token.
+ */
+
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+
+typedef struct Tokenizer Tokenizer;
+
+// Carga un archivo .tiktoken. Devuelve NULL si no se pudo leer
+Tokenizer* tokenizer_load(const char *path);
+
+// Libera las tablas
+void tokenizer_free(Tokenizer *tok);
+
+// Tokenizador compartido del proceso para path, con una referencia para el
+// llamador; se vuelve a cargar si cambia la ruta. Las tablas anteriores siguen
+// válidas hasta que las suelte el último que las usa, así que se puede llamar
+// desde varios hilos. Devuelve NULL (modo estimación) si path está vacío o no
+// se pudo cargar
+const Tokenizer* tokenizer_acquire(const char *path);
+
+// Suelta la referencia de tokenizer_acquire (NULL no hace nada)
+void tokenizer_release(const Tokenizer *tok);
+
+// Suelta la referencia del proceso al tokenizador compartido
+void tokenizer_cleanup(void);
+
+// Cuenta los tokens de text (tok NULL = estimación)
+size_t tokenizer_count(const Tokenizer *tok, const char *text, size_t len);
+
+// Devuelve el offset desde el que el final de text ocupa como mucho max_tokens;
+// el recorte cae siempre en un límite de carácter UTF-8. Si tokens no es NULL,
+// recibe los tokens del sufijo
+size_t tokenizer_tail(const Tokenizer *tok, const char *text, size_t len,
+                      size_t max_tokens, size_t *tokens);
+
+#endif /* TOKENIZER_H */
@@ -0,0 +1,30 @@
+/*
+ * utf8.h - Validación y reparación de UTF-8 dentro del proceso
+ * Los tramos ASCII se recorren de 16 en 16 (SSE2) o de 32 en 32 bytes (AVX2);
+ * las secuencias multibyte se comprueban según la tabla 3-7 de Unicode
+ * (sin sobrelargas, sustitutos ni puntos de código > U+10FFFF).
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include "buffer.h"
+
+#define UTF8_REPLACEMENT "\xEF\xBF\xBD"  // U+FFFD
+
+// Bytes iniciales de s que forman UTF-8 válido (len si todo lo es)
+size_t utf8_valid_prefix(const char *s, size_t len);
+
+// 1 si s es UTF-8 válido
+int utf8_is_valid(const char *s, size_t len);
+
+// Añade s a out sustituyendo cada secuencia inválida (su subparte maximal,
+// como recomienda Unicode) por U+FFFD. Devuelve las sustituciones hechas
+size_t utf8_repair_append(Buffer *out, const char *s, size_t len);
+
+// Si *text (terminado en '\0') no es UTF-8 válido, lo cambia por una copia
+// reparada y libera el original. Devuelve las sustituciones hechas
+size_t utf8_sanitize(char **text);
+
+#endif /* UTF8_H */
@@ -1,15 +1,32 @@
 #ifndef COMMON_UTILS_H
 #define COMMON_UTILS_H
 
+#include <stddef.h>
+#include "code_blocks.h"
+
 // Función para eliminar espacios en blanco al inicio y final de una cadena
 char* trim(char* str);
 
-// Función mejorada para extraer comandos bash que maneja múltiples formatos
+// Función mejorada para extraer comandos bash que maneja múltiples formatos:
+// devuelve el primer bloque ejecutable (ver code_blocks_commands) o NULL
 char* extract_command_improved(const char *text, const char *language);
 
+// Muestra los comandos detectados y pregunta cuáles ejecutar (todos, algunos o
+// uno). selected[i] queda a 1 para los elegidos; devuelve cuántos son
+size_t ask_command_selection(const CodeBlockList *blocks, int *selected);
+
 // Función mejorada para ejecutar comandos
 char* run_command_improved(const char *cmd);
 
+// Con enabled = 1, run_command_improved muestra la salida en el terminal a medida
+// que se produce (y el estado final al terminar); el texto devuelto es el mismo,
+// así que quien lo llame ya no debe imprimirlo
+void run_command_set_live(int enabled);
+
+// Plazo (0 = sin límite, lo predeterminado) y bytes retenidos por flujo
+// (0 = sin límite) de run_command_improved
+void run_command_set_limits(int timeout_ms, size_t max_output);
+
 // Función para leer la clave API desde config.txt
 char* read_api_key();
 
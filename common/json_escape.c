@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "includes/json_escape.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_ESCAPE_X86 1
+#endif
+
+// Secuencia de escape de cada byte que la necesita (0 = se copia tal cual):
+// 'u' = \u00XX; cualquier otro valor es la letra tras la barra
+static const char escape_kind[256] = {
+    ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', ['\f'] = 'f', ['\r'] = 'r',
+    [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u',
+    [0x06] = 'u', [0x07] = 'u', [0x0b] = 'u', [0x0e] = 'u', [0x0f] = 'u', [0x10] = 'u',
+    [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u', [0x15] = 'u', [0x16] = 'u',
+    [0x17] = 'u', [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u',
+    [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+    ['"'] = '"', ['\\'] = '\\',
+};
+
+// Longitud del tramo inicial de s que no necesita escape
+typedef size_t (*ScanFn)(const unsigned char *s, size_t len);
+
+static size_t scan_scalar(const unsigned char *s, size_t len) {
+    size_t i = 0;
+    while (i < len && !escape_kind[s[i]]) i++;
+    return i;
+}
+
+#ifdef JSON_ESCAPE_X86
+// 16 bytes por iteración: '"', '\\' o byte <= 0x1f (comparación sin signo vía max)
+__attribute__((target("sse2")))
+static size_t scan_sse2(const unsigned char *s, size_t len) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + scan_scalar(s + i, len - i);
+}
+
+// La misma búsqueda con 32 bytes por iteración
+__attribute__((target("avx2")))
+static size_t scan_avx2(const unsigned char *s, size_t len) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + scan_sse2(s + i, len - i);
+}
+#endif
+
+// Implementación elegida en la primera llamada según la CPU; pthread_once
+// publica la función y su nombre juntos aunque lleguen varias hebras a la vez
+static pthread_once_t scan_once = PTHREAD_ONCE_INIT;
+static ScanFn scan_impl = scan_scalar;
+static const char *scan_name = "scalar";
+
+static void select_scan(void) {
+    ScanFn fn = scan_scalar;
+    const char *name = "scalar";
+#ifdef JSON_ESCAPE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fn = scan_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        fn = scan_sse2;
+        name = "sse2";
+    }
+#endif
+    scan_impl = fn;
+    scan_name = name;
+}
+
+const char* json_escape_impl(void) {
+    pthread_once(&scan_once, select_scan);
+    return scan_name;
+}
+
+// Función para escapar caracteres especiales en JSON al final de un buffer.
+// Los tramos limpios se copian de una vez; el buffer crece según hace falta
+// en lugar de reservar el peor caso (6 bytes por byte de entrada)
+int json_escape_append(Buffer *out, const char *input, size_t input_len) {
+    static const char hex[] = "0123456789abcdef";
+    pthread_once(&scan_once, select_scan);
+    ScanFn scan = scan_impl;
+
+    // Caso típico: pocos escapes, así que se reserva la entrada más un margen
+    if (!buffer_reserve(out, input_len + input_len / 16 + 8)) return 0;
+
+    const unsigned char *s = (const unsigned char *)input;
+    size_t i = 0;
+    while (i < input_len) {
+        size_t run = scan(s + i, input_len - i);
+        if (run > 0) {
+            if (!buffer_reserve(out, run + 6)) return 0;
+            memcpy(out->data + out->len, s + i, run);
+            out->len += run;
+            i += run;
+            if (i == input_len) break;
+        } else if (!buffer_reserve(out, 6)) {
+            return 0;
+        }
+
+        // Byte que necesita escape
+        unsigned char c = s[i++];
+        char *p = out->data + out->len;
+        char kind = escape_kind[c];
+        p[0] = '\\';
+        if (kind == 'u') {
+            memcpy(p + 1, "u00", 3);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 0xf];
+            out->len += 6;
+        } else {
+            p[1] = kind;
+            out->len += 2;
+        }
+    }
+
+    out->data[out->len] = '\0';
+    return 1;
+}
+
+char* escape_json(const char* input) {
+    if (!input) return NULL;
+
+    Buffer out;
+    buffer_init(&out);
+    if (!json_escape_append(&out, input, strlen(input))) {
+        buffer_free(&out);
+        return NULL;
+    }
+    return buffer_detach(&out);
+}
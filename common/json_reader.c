@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "includes/json_reader.h"
+
+// Qué espera el lector a continuación
+enum {
+    ST_VALUE,                    // Un valor (raíz, tras ':' o tras ',' en un array)
+    ST_VALUE_OR_END,             // Tras '[': un valor o ']'
+    ST_KEY,                      // Tras ',' en un objeto
+    ST_KEY_OR_END,               // Tras '{': una clave o '}'
+    ST_COLON,                    // Tras una clave
+    ST_COMMA_OR_END,             // Tras un valor dentro de un contenedor
+    ST_DONE                      // Documento completo
+};
+
+void json_reader_init(JsonReader *reader, const char *buf, size_t len, int final) {
+    memset(reader, 0, sizeof(JsonReader));
+    reader->buf = buf;
+    reader->len = len;
+    reader->final = final;
+    reader->state = ST_VALUE;
+}
+
+void json_reader_feed(JsonReader *reader, const char *buf, size_t len, int final) {
+    reader->buf = buf;
+    reader->len = len;
+    reader->final = final;
+}
+
+static void skip_whitespace(JsonReader *r) {
+    while (r->pos < r->len) {
+        char c = r->buf[r->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+        r->pos++;
+    }
+}
+
+// Tras completar un valor, decide qué viene después
+static void value_done(JsonReader *r) {
+    r->state = r->depth == 0 ? ST_DONE : ST_COMMA_OR_END;
+}
+
+// Lee una cadena desde la comilla inicial; deja value apuntando al contenido
+static JsonToken read_string(JsonReader *r, JsonToken tok) {
+    size_t start = r->pos + 1;
+    size_t i = start;
+    int escaped = 0;
+    const char *q = NULL;
+
+    while (i < r->len) {
+        // Avanzar rápido sobre bytes sin comillas ni escapes
+        if (!q || (size_t)(q - r->buf) < i) q = memchr(r->buf + i, '"', r->len - i);
+        const char *b = memchr(r->buf + i, '\\', (q ? (size_t)(q - r->buf) : r->len) - i);
+        if (b) {
+            escaped = 1;
+            i = (size_t)(b - r->buf) + 2;
+            continue;
+        }
+        if (!q) break;
+
+        r->value = r->buf + start;
+        r->value_len = (size_t)(q - r->buf) - start;
+        r->value_escaped = escaped;
+        r->pos = (size_t)(q - r->buf) + 1;
+        return tok;
+    }
+
+    return r->final ? JSON_TOK_ERROR : JSON_TOK_NEED_MORE;
+}
+
+static JsonToken read_number(JsonReader *r) {
+    size_t i = r->pos;
+    while (i < r->len) {
+        char c = r->buf[i];
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+            i++;
+        } else {
+            break;
+        }
+    }
+    // Un número al final de una entrada parcial puede continuar en el siguiente bloque
+    if (i == r->len && !r->final) return JSON_TOK_NEED_MORE;
+
+    r->value = r->buf + r->pos;
+    r->value_len = i - r->pos;
+    r->value_escaped = 0;
+    r->pos = i;
+    return JSON_TOK_NUMBER;
+}
+
+static JsonToken read_literal(JsonReader *r, const char *word, JsonToken tok) {
+    size_t n = strlen(word);
+    size_t avail = r->len - r->pos;
+    if (avail < n) {
+        if (!r->final && memcmp(r->buf + r->pos, word, avail) == 0) return JSON_TOK_NEED_MORE;
+        return JSON_TOK_ERROR;
+    }
+    if (memcmp(r->buf + r->pos, word, n) != 0) return JSON_TOK_ERROR;
+
+    r->value = r->buf + r->pos;
+    r->value_len = n;
+    r->value_escaped = 0;
+    r->pos += n;
+    return tok;
+}
+
+static JsonToken read_value(JsonReader *r) {
+    char c = r->buf[r->pos];
+    JsonToken tok;
+
+    switch (c) {
+        case '{':
+        case '[':
+            if (r->depth >= JSON_MAX_DEPTH) return JSON_TOK_ERROR;
+            r->stack[r->depth++] = (unsigned char)c;
+            r->value = r->buf + r->pos;
+            r->value_len = 1;
+            r->pos++;
+            r->state = c == '{' ? ST_KEY_OR_END : ST_VALUE_OR_END;
+            return c == '{' ? JSON_TOK_OBJECT_BEGIN : JSON_TOK_ARRAY_BEGIN;
+        case '"':
+            tok = read_string(r, JSON_TOK_STRING);
+            break;
+        case 't':
+            tok = read_literal(r, "true", JSON_TOK_TRUE);
+            break;
+        case 'f':
+            tok = read_literal(r, "false", JSON_TOK_FALSE);
+            break;
+        case 'n':
+            tok = read_literal(r, "null", JSON_TOK_NULL);
+            break;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                tok = read_number(r);
+            } else {
+                tok = JSON_TOK_ERROR;
+            }
+            break;
+    }
+
+    if (tok > JSON_TOK_NEED_MORE) value_done(r);
+    return tok;
+}
+
+static JsonToken close_container(JsonReader *r, char c) {
+    if (r->depth == 0) return JSON_TOK_ERROR;
+    unsigned char open = r->stack[r->depth - 1];
+    if ((c == '}' && open != '{') || (c == ']' && open != '[')) return JSON_TOK_ERROR;
+
+    r->depth--;
+    r->value = r->buf + r->pos;
+    r->value_len = 1;
+    r->pos++;
+    value_done(r);
+    return c == '}' ? JSON_TOK_OBJECT_END : JSON_TOK_ARRAY_END;
+}
+
+JsonToken json_reader_next(JsonReader *r) {
+    for (;;) {
+        skip_whitespace(r);
+        if (r->state == ST_DONE) return JSON_TOK_END;
+        if (r->pos >= r->len) return r->final ? JSON_TOK_ERROR : JSON_TOK_NEED_MORE;
+
+        char c = r->buf[r->pos];
+        switch (r->state) {
+            case ST_VALUE:
+                return read_value(r);
+
+            case ST_VALUE_OR_END:
+                if (c == ']') return close_container(r, c);
+                return read_value(r);
+
+            case ST_KEY_OR_END:
+                if (c == '}') return close_container(r, c);
+                /* fall through */
+            case ST_KEY: {
+                if (c != '"') return JSON_TOK_ERROR;
+                JsonToken tok = read_string(r, JSON_TOK_KEY);
+                if (tok == JSON_TOK_KEY) r->state = ST_COLON;
+                return tok;
+            }
+
+            case ST_COLON:
+                if (c != ':') return JSON_TOK_ERROR;
+                r->pos++;
+                r->state = ST_VALUE;
+                continue;
+
+            case ST_COMMA_OR_END:
+                if (c == '}' || c == ']') return close_container(r, c);
+                if (c != ',') return JSON_TOK_ERROR;
+                r->pos++;
+                r->state = r->stack[r->depth - 1] == '{' ? ST_KEY : ST_VALUE;
+                continue;
+
+            default:
+                return JSON_TOK_ERROR;
+        }
+    }
+}
+
+int json_reader_skip(JsonReader *reader, JsonToken tok) {
+    if (tok != JSON_TOK_OBJECT_BEGIN && tok != JSON_TOK_ARRAY_BEGIN) {
+        return tok > JSON_TOK_END;
+    }
+
+    int target = reader->depth - 1;
+    while (reader->depth > target) {
+        JsonToken t = json_reader_next(reader);
+        if (t <= JSON_TOK_END) return 0;
+    }
+    return 1;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static long read_hex4(const char *p, const char *end) {
+    if (end - p < 4) return -1;
+    long v = 0;
+    for (int i = 0; i < 4; i++) {
+        int h = hex_value(p[i]);
+        if (h < 0) return -1;
+        v = (v << 4) | h;
+    }
+    return v;
+}
+
+// Codifica un punto de código como UTF-8; devuelve los bytes usados
+static size_t utf8_encode(unsigned long cp, char out[4]) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+size_t json_unescape(const char *raw, size_t raw_len, char *out, size_t out_size) {
+    const char *p = raw;
+    const char *end = raw + raw_len;
+    size_t n = 0;
+
+#define EMIT(bytes, count) do { \
+        for (size_t k_ = 0; k_ < (count); k_++) { \
+            if (out && n + 1 < out_size) out[n] = (bytes)[k_]; \
+            n++; \
+        } \
+    } while (0)
+
+    while (p < end) {
+        // Copiar de una vez el tramo sin escapes
+        const char *b = memchr(p, '\\', end - p);
+        size_t run = (b ? b : end) - p;
+        if (out && n + 1 < out_size) {
+            size_t room = out_size - 1 - n;
+            memcpy(out + n, p, run < room ? run : room);
+        }
+        n += run;
+        p += run;
+        if (!b) break;
+
+        p++;
+        if (p >= end) break;
+        char c = *p++;
+        char tmp[4];
+        switch (c) {
+            case 'n': EMIT("\n", 1); break;
+            case 't': EMIT("\t", 1); break;
+            case 'r': EMIT("\r", 1); break;
+            case 'b': EMIT("\b", 1); break;
+            case 'f': EMIT("\f", 1); break;
+            case 'u': {
+                long cp = read_hex4(p, end);
+                if (cp < 0) {
+                    EMIT("\xEF\xBF\xBD", 3);
+                    break;
+                }
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // Par suplente: debe seguir \uDC00-\uDFFF
+                    long low = (end - p >= 6 && p[0] == '\\' && p[1] == 'u') ? read_hex4(p + 2, end) : -1;
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        p += 6;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                size_t len = utf8_encode((unsigned long)cp, tmp);
+                EMIT(tmp, len);
+                break;
+            }
+            default:
+                // \" \\ \/ y cualquier otro carácter escapado literalmente
+                tmp[0] = c;
+                EMIT(tmp, 1);
+                break;
+        }
+    }
+#undef EMIT
+
+    if (out && out_size > 0) out[n < out_size ? n : out_size - 1] = '\0';
+    return n;
+}
+
+// Compara una clave (posiblemente escapada) con un segmento de ruta
+static int key_equals(const JsonReader *r, const char *seg, size_t seg_len) {
+    if (!r->value_escaped) {
+        return r->value_len == seg_len && memcmp(r->value, seg, seg_len) == 0;
+    }
+    char tmp[256];
+    size_t n = json_unescape(r->value, r->value_len, tmp, sizeof(tmp));
+    return n == seg_len && n < sizeof(tmp) && memcmp(tmp, seg, seg_len) == 0;
+}
+
+static int find_in(JsonReader *r, JsonToken tok, const char *path, JsonValue *out) {
+    if (*path == '\0') {
+        out->type = tok;
+        out->raw = r->value;
+        out->raw_len = r->value_len;
+        out->escaped = r->value_escaped;
+        if (tok == JSON_TOK_OBJECT_BEGIN || tok == JSON_TOK_ARRAY_BEGIN) {
+            const char *start = r->value;
+            if (!json_reader_skip(r, tok)) return 0;
+            out->raw_len = (size_t)(r->buf + r->pos - start);
+        }
+        return 1;
+    }
+
+    const char *dot = strchr(path, '.');
+    size_t seg_len = dot ? (size_t)(dot - path) : strlen(path);
+    const char *rest = dot ? dot + 1 : path + seg_len;
+
+    if (tok == JSON_TOK_OBJECT_BEGIN) {
+        for (;;) {
+            JsonToken t = json_reader_next(r);
+            if (t != JSON_TOK_KEY) return 0;
+            int match = key_equals(r, path, seg_len);
+            JsonToken v = json_reader_next(r);
+            if (v <= JSON_TOK_END) return 0;
+            if (match) return find_in(r, v, rest, out);
+            if (!json_reader_skip(r, v)) return 0;
+        }
+    }
+
+    if (tok == JSON_TOK_ARRAY_BEGIN) {
+        char *endp;
+        long index = strtol(path, &endp, 10);
+        if (endp != path + seg_len || index < 0) return 0;
+
+        for (long i = 0;; i++) {
+            JsonToken v = json_reader_next(r);
+            if (v <= JSON_TOK_END || v == JSON_TOK_ARRAY_END) return 0;
+            if (i == index) return find_in(r, v, rest, out);
+            if (!json_reader_skip(r, v)) return 0;
+        }
+    }
+
+    return 0;
+}
+
+int json_find(const char *json, size_t len, const char *path, JsonValue *out) {
+    if (!json || !path || !out) return 0;
+
+    JsonReader reader;
+    json_reader_init(&reader, json, len, 1);
+    JsonToken tok = json_reader_next(&reader);
+    if (tok <= JSON_TOK_END) return 0;
+    return find_in(&reader, tok, path, out);
+}
+
+char* json_get_string(const char *json, size_t len, const char *path) {
+    JsonValue v;
+    if (!json_find(json, len, path, &v) || v.type != JSON_TOK_STRING) return NULL;
+
+    size_t n = v.escaped ? json_unescape(v.raw, v.raw_len, NULL, 0) : v.raw_len;
+    char *out = malloc(n + 1);
+    if (!out) return NULL;
+
+    if (v.escaped) {
+        json_unescape(v.raw, v.raw_len, out, n + 1);
+    } else {
+        memcpy(out, v.raw, n);
+        out[n] = '\0';
+    }
+    return out;
+}
+
+int json_get_bool(const char *json, size_t len, const char *path, int default_value) {
+    JsonValue v;
+    if (!json_find(json, len, path, &v)) return default_value;
+    if (v.type == JSON_TOK_TRUE) return 1;
+    if (v.type == JSON_TOK_FALSE) return 0;
+    return default_value;
+}
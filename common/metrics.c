@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "includes/metrics.h"
+
+#define METRICS_PREFIX "gpt_assistant"
+
+static const char *stage_names[METRIC_STAGE_COUNT] = {
+    "turn", "config", "context", "json_escape", "connect", "ttfb", "transfer",
+    "parse", "extract", "mcp", "exec"
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    { "turns_total", "Turnos enviados al modelo" },
+    { "http_requests_total", "Peticiones HTTP a la API (incluye reintentos y resúmenes)" },
+    { "http_errors_total", "Errores de transporte o respuestas HTTP no 2xx" },
+    { "bytes_sent_total", "Bytes de cuerpo enviados a la API" },
+    { "bytes_received_total", "Bytes de cuerpo recibidos de la API" },
+    { "prompt_tokens_total", "Tokens enviados (historial + prompt)" },
+    { "completion_tokens_total", "Tokens de las respuestas" },
+    { "cache_hits_total", "Respuestas servidas desde la caché" },
+};
+
+// Límites superiores de los buckets del histograma (segundos)
+static const double bucket_bounds[] = {
+    0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30
+};
+#define BUCKETS (sizeof(bucket_bounds) / sizeof(bucket_bounds[0]))
+
+// Estadísticas de una etapa; se actualizan con atómicos, sin bloqueo
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[BUCKETS];   // No acumulativos; se suman al exportar
+} StageStats;
+
+static StageStats stages[METRIC_STAGE_COUNT];
+static uint64_t counters[METRIC_COUNTER_COUNT];
+
+// Traza (solo con --trace)
+static FILE *trace_fp = NULL;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Exportación periódica
+static struct {
+    pthread_t thread;
+    int running;
+    int stopping;
+    int interval_s;
+    char path[512];
+    char module[64];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} exporter = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+uint64_t metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void metrics_observe(MetricStage stage, uint64_t dur_ns) {
+    if ((unsigned)stage >= METRIC_STAGE_COUNT) return;
+    StageStats *st = &stages[stage];
+
+    __atomic_fetch_add(&st->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&st->sum_ns, dur_ns, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&st->max_ns, __ATOMIC_RELAXED);
+    while (dur_ns > max &&
+           !__atomic_compare_exchange_n(&st->max_ns, &max, dur_ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+
+    double seconds = dur_ns / 1e9;
+    for (size_t b = 0; b < BUCKETS; b++) {
+        if (seconds <= bucket_bounds[b]) {
+            __atomic_fetch_add(&st->buckets[b], 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+}
+
+void metrics_span_at(MetricStage stage, uint64_t start_ns, uint64_t dur_ns) {
+    metrics_observe(stage, dur_ns);
+    if (!__atomic_load_n(&trace_fp, __ATOMIC_ACQUIRE)) return;
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fp) {
+        fprintf(trace_fp,
+                "{\"name\": \"%s\", \"cat\": \"turn\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                "\"pid\": %d, \"tid\": %ld},\n",
+                stage_names[stage], start_ns / 1e3, dur_ns / 1e3, (int)getpid(),
+                (long)syscall(SYS_gettid));
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void metrics_span(MetricStage stage, uint64_t start_ns) {
+    uint64_t now = metrics_now();
+    metrics_span_at(stage, start_ns, now > start_ns ? now - start_ns : 0);
+}
+
+void metrics_add(MetricCounter counter, uint64_t n) {
+    if ((unsigned)counter >= METRIC_COUNTER_COUNT || n == 0) return;
+    uint64_t total = __atomic_add_fetch(&counters[counter], n, __ATOMIC_RELAXED);
+    if (!__atomic_load_n(&trace_fp, __ATOMIC_ACQUIRE)) return;
+
+    // En la traza, cada contador es una serie (evento "C")
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fp) {
+        fprintf(trace_fp,
+                "{\"name\": \"%s\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": %d, "
+                "\"args\": {\"value\": %llu}},\n",
+                counter_info[counter].name, metrics_now() / 1e3, (int)getpid(),
+                (unsigned long long)total);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+int metrics_trace_open(const char *path) {
+    if (!path || !*path) return 0;
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return 0;
+    }
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fp) fclose(trace_fp);
+    fprintf(fp, "[\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+                "\"args\": {\"name\": \"gpt-assistant\"}},\n", (int)getpid());
+    __atomic_store_n(&trace_fp, fp, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&trace_lock);
+    return 1;
+}
+
+static void write_histograms(FILE *fp, const char *module) {
+    fprintf(fp, "# HELP %s_stage_seconds Duración de cada etapa del turno\n", METRICS_PREFIX);
+    fprintf(fp, "# TYPE %s_stage_seconds histogram\n", METRICS_PREFIX);
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+        StageStats *st = &stages[s];
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < BUCKETS; b++) {
+            cumulative += __atomic_load_n(&st->buckets[b], __ATOMIC_RELAXED);
+            fprintf(fp, "%s_stage_seconds_bucket{module=\"%s\",stage=\"%s\",le=\"%g\"} %llu\n",
+                    METRICS_PREFIX, module, stage_names[s], bucket_bounds[b],
+                    (unsigned long long)cumulative);
+        }
+        uint64_t count = __atomic_load_n(&st->count, __ATOMIC_RELAXED);
+        fprintf(fp, "%s_stage_seconds_bucket{module=\"%s\",stage=\"%s\",le=\"+Inf\"} %llu\n",
+                METRICS_PREFIX, module, stage_names[s], (unsigned long long)count);
+        fprintf(fp, "%s_stage_seconds_sum{module=\"%s\",stage=\"%s\"} %.9f\n",
+                METRICS_PREFIX, module, stage_names[s],
+                __atomic_load_n(&st->sum_ns, __ATOMIC_RELAXED) / 1e9);
+        fprintf(fp, "%s_stage_seconds_count{module=\"%s\",stage=\"%s\"} %llu\n",
+                METRICS_PREFIX, module, stage_names[s], (unsigned long long)count);
+    }
+
+    fprintf(fp, "# HELP %s_stage_max_seconds Duración máxima de cada etapa desde el arranque\n",
+            METRICS_PREFIX);
+    fprintf(fp, "# TYPE %s_stage_max_seconds gauge\n", METRICS_PREFIX);
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+        fprintf(fp, "%s_stage_max_seconds{module=\"%s\",stage=\"%s\"} %.9f\n",
+                METRICS_PREFIX, module, stage_names[s],
+                __atomic_load_n(&stages[s].max_ns, __ATOMIC_RELAXED) / 1e9);
+    }
+}
+
+static int write_prometheus(const char *path, const char *module) {
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return 0;
+
+    write_histograms(fp, module);
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        fprintf(fp, "# HELP %s_%s %s\n", METRICS_PREFIX, counter_info[c].name, counter_info[c].help);
+        fprintf(fp, "# TYPE %s_%s counter\n", METRICS_PREFIX, counter_info[c].name);
+        fprintf(fp, "%s_%s{module=\"%s\"} %llu\n", METRICS_PREFIX, counter_info[c].name, module,
+                (unsigned long long)__atomic_load_n(&counters[c], __ATOMIC_RELAXED));
+    }
+    fprintf(fp, "# HELP %s_last_update_timestamp_seconds Última reescritura de este archivo\n",
+            METRICS_PREFIX);
+    fprintf(fp, "# TYPE %s_last_update_timestamp_seconds gauge\n", METRICS_PREFIX);
+    fprintf(fp, "%s_last_update_timestamp_seconds{module=\"%s\"} %ld\n",
+            METRICS_PREFIX, module, (long)time(NULL));
+
+    // El collector nunca debe ver un archivo a medio escribir
+    int ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+int metrics_write_prometheus(const char *path) {
+    if (!path || !*path) return 0;
+    return write_prometheus(path, exporter.module[0] ? exporter.module : "default");
+}
+
+static void* export_worker(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&exporter.lock);
+    while (!exporter.stopping) {
+        write_prometheus(exporter.path, exporter.module);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += exporter.interval_s;
+        while (!exporter.stopping &&
+               pthread_cond_timedwait(&exporter.cond, &exporter.lock, &deadline) != ETIMEDOUT) {}
+    }
+    pthread_mutex_unlock(&exporter.lock);
+    return NULL;
+}
+
+int metrics_export_start(const char *path, int interval_s, const char *module) {
+    if (!path || !*path || exporter.running) return 0;
+
+    snprintf(exporter.path, sizeof(exporter.path), "%s", path);
+    snprintf(exporter.module, sizeof(exporter.module), "%s", module && *module ? module : "default");
+    exporter.interval_s = interval_s > 0 ? interval_s : 15;
+    exporter.stopping = 0;
+    if (pthread_create(&exporter.thread, NULL, export_worker, NULL) != 0) return 0;
+    exporter.running = 1;
+    return 1;
+}
+
+void metrics_shutdown(void) {
+    if (exporter.running) {
+        pthread_mutex_lock(&exporter.lock);
+        exporter.stopping = 1;
+        pthread_cond_signal(&exporter.cond);
+        pthread_mutex_unlock(&exporter.lock);
+        pthread_join(exporter.thread, NULL);
+        exporter.running = 0;
+        write_prometheus(exporter.path, exporter.module);
+    }
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_fp) {
+        // Cerrar el array con un último evento sin coma final
+        fprintf(trace_fp, "{\"name\": \"trace_end\", \"ph\": \"i\", \"s\": \"p\", \"ts\": %.3f, "
+                          "\"pid\": %d}\n]\n", metrics_now() / 1e3, (int)getpid());
+        fclose(trace_fp);
+        __atomic_store_n(&trace_fp, NULL, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "includes/output_reducer.h"
+#include "includes/buffer.h"
+
+#define REPEAT_OVERHEAD 4        // Tokens del sufijo "  [×N]"
+#define MARKER_RESERVE 10        // % del presupuesto reservado para las marcas de omisión
+
+// Línea de la salida ya limpia; las repeticiones consecutivas se agrupan en una
+typedef struct {
+    size_t off;
+    size_t len;
+    size_t count;                // Veces que aparece seguida (idéntica o con otra hora)
+    size_t tokens;
+    int keep;
+} Line;
+
+// Palabras que delatan una línea que el modelo debe ver aunque esté en medio
+static const char *important_patterns[] = {
+    "error", "warn", "fail", "fatal", "critical", "denied", "panic", "cannot",
+    "unable", "not found", "no such", "segfault", "timed out", "traceback",
+    "conflict", "corrupt", "advertencia", "fallo", "no se pudo", NULL
+};
+
+// Salta una secuencia de escape ANSI que empieza en text[i] (ESC)
+static size_t skip_escape(const char *text, size_t len, size_t i) {
+    i++;
+    if (i >= len) return i;
+    if (text[i] == '[') {
+        // CSI: parámetros hasta un byte final entre '@' y '~'
+        for (i++; i < len; i++) {
+            if (text[i] >= 0x40 && text[i] <= 0x7e) return i + 1;
+        }
+        return i;
+    }
+    if (text[i] == ']') {
+        // OSC: hasta BEL o ESC '\'
+        for (i++; i < len; i++) {
+            if (text[i] == '\a') return i + 1;
+            if (text[i] == 0x1b && i + 1 < len && text[i + 1] == '\\') return i + 2;
+        }
+        return i;
+    }
+    if (text[i] == '(' || text[i] == ')') return i + 2 <= len ? i + 2 : len;
+    return i + 1;
+}
+
+static int is_plain(unsigned char c) {
+    return (c >= 0x20 && c != 0x7f) || c == '\t' || c >= 0x80;
+}
+
+// Añade un tramo a la línea en curso respetando OUTPUT_LINE_MAX (sin partir caracteres UTF-8)
+static void append_clipped(Buffer *out, size_t line_start, const char *s, size_t n, size_t *clipped) {
+    size_t used = out->len - line_start;
+    if (*clipped == 0 && used + n <= OUTPUT_LINE_MAX) {
+        buffer_append(out, s, n);
+        return;
+    }
+    size_t cut = 0;
+    if (*clipped == 0 && used < OUTPUT_LINE_MAX) {
+        cut = OUTPUT_LINE_MAX - used;
+        while (cut > 0 && ((unsigned char)s[cut] & 0xc0) == 0x80) cut--;
+        buffer_append(out, s, cut);
+    }
+    *clipped += n - cut;
+}
+
+static void end_line(Buffer *out, size_t *clipped) {
+    if (*clipped) buffer_appendf(out, " […%zu bytes]", *clipped);
+    *clipped = 0;
+}
+
+// Quita secuencias ANSI y controles; un '\r' suelto reescribe la línea (barras de progreso)
+static void clean_text(const char *text, size_t len, Buffer *out) {
+    size_t line_start = 0;
+    size_t clipped = 0;
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = (unsigned char)text[i];
+        if (is_plain(c)) {
+            size_t j = i;
+            while (j < len && is_plain((unsigned char)text[j])) j++;
+            append_clipped(out, line_start, text + i, j - i, &clipped);
+            i = j;
+        } else if (c == 0x1b) {
+            i = skip_escape(text, len, i);
+        } else if (c == '\n') {
+            end_line(out, &clipped);
+            buffer_append(out, "\n", 1);
+            line_start = out->len;
+            i++;
+        } else if (c == '\r' && !(i + 1 < len && text[i + 1] == '\n')) {
+            out->len = line_start;
+            if (out->data) out->data[out->len] = '\0';
+            clipped = 0;
+            i++;
+        } else {
+            i++;
+        }
+    }
+    end_line(out, &clipped);
+}
+
+// Longitud de la marca de tiempo al principio de la línea ("Oct 18 10:42:07",
+// "2024-10-18T10:42:07.123Z", "[   12.345678]"), o 0 si no hay
+static size_t timestamp_prefix(const char *s, size_t len) {
+    static const char *months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec", NULL
+    };
+    size_t i = 0;
+    for (int m = 0; months[m]; m++) {
+        if (len > 4 && strncmp(s, months[m], 3) == 0 && s[3] == ' ') {
+            i = 4;
+            while (i < len && s[i] == ' ') i++;
+            break;
+        }
+    }
+
+    // dmesg: "[    12.345678]"
+    if (i == 0 && len > 0 && s[0] == '[') {
+        size_t j = 1;
+        while (j < len && s[j] == ' ') j++;
+        size_t digits = j;
+        while (j < len && isdigit((unsigned char)s[j])) j++;
+        if (j == digits || j >= len || s[j] != '.') return 0;
+        j++;
+        while (j < len && isdigit((unsigned char)s[j])) j++;
+        return j < len && s[j] == ']' ? j + 1 : 0;
+    }
+
+    // Dígitos con separadores de fecha y hora; hace falta al menos HH:MM:SS
+    size_t start = i, colons = 0;
+    while (i < len) {
+        unsigned char c = (unsigned char)s[i];
+        int prev_digit = i > start && isdigit((unsigned char)s[i - 1]);
+        int next_digit = i + 1 < len && isdigit((unsigned char)s[i + 1]);
+        if (isdigit(c)) {
+            i++;
+        } else if ((c == ':' || c == '-' || c == '.' || c == ',' || c == '/' || c == '+' ||
+                    c == 'T' || c == ' ') && prev_digit && next_digit) {
+            if (c == ':') colons++;
+            i++;
+        } else if (c == 'Z' && prev_digit) {
+            i++;
+            break;
+        } else {
+            break;
+        }
+    }
+    return colons >= 2 ? i : 0;
+}
+
+// Línea repetida: idéntica, o igual salvo por la marca de tiempo inicial.
+// Cualquier otro número (direcciones, PIDs, filas de una tabla) es un dato
+static int same_line(const char *a, size_t alen, const char *b, size_t blen) {
+    if (alen == blen && memcmp(a, b, alen) == 0) return 1;
+    size_t ta = timestamp_prefix(a, alen);
+    size_t tb = timestamp_prefix(b, blen);
+    return ta > 0 && tb > 0 && alen - ta == blen - tb && memcmp(a + ta, b + tb, alen - ta) == 0;
+}
+
+static int is_important(const char *s, size_t len) {
+    for (int p = 0; important_patterns[p]; p++) {
+        const char *pat = important_patterns[p];
+        size_t plen = strlen(pat);
+        for (size_t i = 0; i + plen <= len; i++) {
+            if (tolower((unsigned char)s[i]) == pat[0] && strncasecmp(s + i, pat, plen) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+static void render(Buffer *out, const char *text, const Line *lines, size_t count) {
+    size_t gap = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!lines[i].keep) {
+            gap += lines[i].count;
+            continue;
+        }
+        if (gap) buffer_appendf(out, "[… %zu líneas omitidas …]\n", gap);
+        gap = 0;
+        buffer_append(out, text + lines[i].off, lines[i].len);
+        if (lines[i].count > 1 && lines[i].len > 0) buffer_appendf(out, "  [×%zu]", lines[i].count);
+        buffer_append(out, "\n", 1);
+    }
+    if (gap) buffer_appendf(out, "[… %zu líneas omitidas …]\n", gap);
+    if (out->len > 0) out->data[--out->len] = '\0';
+}
+
+// Reparte el presupuesto: final, principio, líneas importantes del centro y,
+// si sobra, más principio y más final
+static void select_lines(const char *text, Line *lines, size_t count, size_t budget,
+                         OutputReduceStats *stats) {
+    size_t used = 0;
+    size_t t = count;
+    while (t > 0 && used + lines[t - 1].tokens <= budget / 3) {
+        used += lines[--t].tokens;
+        lines[t].keep = 1;
+    }
+    size_t head = 0;
+    size_t h = 0;
+    while (h < t && head + lines[h].tokens <= budget / 4) {
+        head += lines[h].tokens;
+        lines[h++].keep = 1;
+    }
+    used += head;
+
+    for (size_t i = h; i < t && used < budget; i++) {
+        if (used + lines[i].tokens > budget) continue;
+        if (!is_important(text + lines[i].off, lines[i].len)) continue;
+        lines[i].keep = 1;
+        used += lines[i].tokens;
+        stats->kept_matches++;
+    }
+
+    for (; h < t; h++) {
+        if (lines[h].keep) continue;
+        if (used + lines[h].tokens > budget) break;
+        lines[h].keep = 1;
+        used += lines[h].tokens;
+    }
+    for (; t > h; t--) {
+        if (lines[t - 1].keep) continue;
+        if (used + lines[t - 1].tokens > budget) break;
+        lines[t - 1].keep = 1;
+        used += lines[t - 1].tokens;
+    }
+}
+
+char* output_reduce(const char *text, size_t len, const Tokenizer *tok,
+                    size_t max_tokens, OutputReduceStats *stats) {
+    OutputReduceStats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    if (!text) text = "";
+    stats->original_bytes = len;
+    stats->original_tokens = tokenizer_count(tok, text, len);
+
+    Buffer clean;
+    buffer_init(&clean);
+    clean_text(text, len, &clean);
+
+    // Separar en líneas
+    Line *lines = NULL;
+    size_t count = 0, cap = 0;
+    size_t pos = 0;
+    while (pos < clean.len) {
+        const char *start = clean.data + pos;
+        const char *nl = memchr(start, '\n', clean.len - pos);
+        size_t n = nl ? (size_t)(nl - start) : clean.len - pos;
+        pos += n + (nl ? 1 : 0);
+        stats->original_lines++;
+
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 256;
+            Line *tmp = realloc(lines, new_cap * sizeof(Line));
+            if (!tmp) break;
+            lines = tmp;
+            cap = new_cap;
+        }
+        lines[count].off = (size_t)(start - clean.data);
+        lines[count].len = n;
+        lines[count].count = 1;
+        lines[count].tokens = tokenizer_count(tok, start, n) + 1;
+        lines[count].keep = 1;
+        count++;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) total += lines[i].tokens;
+
+    if (max_tokens > 0 && total > max_tokens) {
+        // No cabe: agrupar las repeticiones consecutivas antes de descartar nada
+        size_t kept = 0;
+        total = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (kept > 0) {
+                Line *prev = &lines[kept - 1];
+                if (same_line(clean.data + prev->off, prev->len, clean.data + lines[i].off, lines[i].len)) {
+                    if (prev->count++ == 1) {
+                        prev->tokens += REPEAT_OVERHEAD;
+                        total += REPEAT_OVERHEAD;
+                    }
+                    stats->collapsed_lines++;
+                    continue;
+                }
+            }
+            lines[kept++] = lines[i];
+            total += lines[i].tokens;
+        }
+        count = kept;
+    }
+    if (max_tokens > 0 && total > max_tokens) {
+        for (size_t i = 0; i < count; i++) lines[i].keep = 0;
+        select_lines(clean.data, lines, count, max_tokens - max_tokens * MARKER_RESERVE / 100, stats);
+        for (size_t i = 0; i < count; i++) {
+            if (!lines[i].keep) stats->omitted_lines += lines[i].count;
+        }
+    }
+
+    Buffer out;
+    buffer_init(&out);
+    render(&out, clean.data, lines, count);
+    free(lines);
+    buffer_free(&clean);
+
+    stats->reduced_tokens = tokenizer_count(tok, out.data ? out.data : "", out.len);
+    if (max_tokens > 0 && stats->reduced_tokens > max_tokens) {
+        // Las marcas no cupieron en la reserva: se conserva el final
+        size_t tokens;
+        size_t from = tokenizer_tail(tok, out.data, out.len, max_tokens > 2 ? max_tokens - 2 : max_tokens, &tokens);
+        Buffer cut;
+        buffer_init(&cut);
+        buffer_append_str(&cut, "[…] ");
+        buffer_append(&cut, out.data + from, out.len - from);
+        buffer_free(&out);
+        out = cut;
+        stats->reduced_tokens = tokenizer_count(tok, out.data, out.len);
+    }
+
+    stats->reduced_bytes = out.len;
+    stats->reduced_lines = out.len > 0 ? 1 : 0;
+    for (size_t i = 0; i < out.len; i++) {
+        if (out.data[i] == '\n') stats->reduced_lines++;
+    }
+    char *result = buffer_detach(&out);
+    return result ? result : strdup("");
+}
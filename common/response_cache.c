@@ -0,0 +1,247 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "includes/response_cache.h"
+
+#define CACHE_MAGIC 0x31484352u  // "RCH1"
+#define CACHE_HEADER_SIZE 4096
+#define CACHE_SLOT_SIZE 16384    // Respuestas de hasta ~16 KB
+#define CACHE_WAYS 8             // Entradas por conjunto
+
+// Cabecera del archivo (primera página)
+typedef struct {
+    uint32_t magic;
+    uint32_t slot_size;
+    uint64_t slots;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+} CacheHeader;
+
+// Cabecera de cada ranura; le siguen los datos de la respuesta
+typedef struct {
+    unsigned char key[SHA256_DIGEST_SIZE];
+    int64_t created;             // Segundos desde la época (TTL)
+    int64_t last_used;           // Nanosegundos desde la época (LRU)
+    uint32_t len;
+    uint32_t valid;
+} CacheSlot;
+
+#define CACHE_MAX_DATA (CACHE_SLOT_SIZE - sizeof(CacheSlot))
+
+struct ResponseCache {
+    int fd;
+    unsigned char *map;
+    size_t map_len;
+    size_t size_mb;
+    size_t sets;
+    unsigned long session_hits;
+    unsigned long session_misses;
+    pthread_mutex_t lock;        // Entre hilos; flock protege entre procesos
+};
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static CacheHeader* cache_header(ResponseCache *cache) {
+    return (CacheHeader *)cache->map;
+}
+
+static CacheSlot* cache_slot(ResponseCache *cache, size_t index) {
+    return (CacheSlot *)(cache->map + CACHE_HEADER_SIZE + index * CACHE_SLOT_SIZE);
+}
+
+static int slot_expired(const CacheSlot *slot, long ttl_seconds, int64_t now) {
+    return ttl_seconds > 0 && now / 1000000000LL - slot->created >= ttl_seconds;
+}
+
+// Primer índice del conjunto que corresponde a key
+static size_t set_base(const ResponseCache *cache, const unsigned char *key) {
+    uint64_t h;
+    memcpy(&h, key, sizeof(h));
+    return (size_t)(h % cache->sets) * CACHE_WAYS;
+}
+
+static void cache_lock(ResponseCache *cache) {
+    pthread_mutex_lock(&cache->lock);
+    while (flock(cache->fd, LOCK_EX) != 0) {}
+}
+
+static void cache_unlock(ResponseCache *cache) {
+    flock(cache->fd, LOCK_UN);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+ResponseCache* response_cache_open(const char *path, size_t size_mb) {
+    if (size_mb == 0) size_mb = 1;
+
+    size_t slots = (size_mb * 1024 * 1024 - CACHE_HEADER_SIZE) / CACHE_SLOT_SIZE;
+    slots -= slots % CACHE_WAYS;
+    if (slots < CACHE_WAYS) slots = CACHE_WAYS;
+    size_t map_len = CACHE_HEADER_SIZE + slots * CACHE_SLOT_SIZE;
+
+    ResponseCache *cache = calloc(1, sizeof(ResponseCache));
+    if (!cache) return NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->size_mb = size_mb;
+    cache->sets = slots / CACHE_WAYS;
+    cache->map_len = map_len;
+
+    cache->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (cache->fd < 0) {
+        perror(path);
+        free(cache);
+        return NULL;
+    }
+
+    // Crear o reformatear el archivo si no coincide con la geometría pedida
+    flock(cache->fd, LOCK_EX);
+    struct stat st;
+    CacheHeader header = {0};
+    int valid = fstat(cache->fd, &st) == 0 && (size_t)st.st_size == map_len &&
+                pread(cache->fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                header.magic == CACHE_MAGIC && header.slot_size == CACHE_SLOT_SIZE &&
+                header.slots == slots;
+    if (!valid) {
+        header = (CacheHeader){ CACHE_MAGIC, CACHE_SLOT_SIZE, slots, 0, 0, 0, 0 };
+        valid = ftruncate(cache->fd, 0) == 0 && ftruncate(cache->fd, (off_t)map_len) == 0 &&
+                pwrite(cache->fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+    }
+    flock(cache->fd, LOCK_UN);
+
+    if (valid) {
+        cache->map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+        if (cache->map == MAP_FAILED) cache->map = NULL;
+    }
+    if (!cache->map) {
+        perror(path);
+        close(cache->fd);
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+size_t response_cache_size_mb(const ResponseCache *cache) {
+    return cache ? cache->size_mb : 0;
+}
+
+char* response_cache_get(ResponseCache *cache, const unsigned char key[SHA256_DIGEST_SIZE],
+                         long ttl_seconds) {
+    if (!cache) return NULL;
+
+    char *data = NULL;
+    int64_t now = now_ns();
+
+    cache_lock(cache);
+    size_t base = set_base(cache, key);
+    for (size_t i = base; i < base + CACHE_WAYS; i++) {
+        CacheSlot *slot = cache_slot(cache, i);
+        if (!slot->valid || memcmp(slot->key, key, SHA256_DIGEST_SIZE) != 0) continue;
+
+        if (slot_expired(slot, ttl_seconds, now)) {
+            slot->valid = 0;
+        } else if ((data = malloc(slot->len + 1)) != NULL) {
+            memcpy(data, slot + 1, slot->len);
+            data[slot->len] = '\0';
+            slot->last_used = now;
+        }
+        break;
+    }
+
+    if (data) {
+        cache_header(cache)->hits++;
+        cache->session_hits++;
+    } else {
+        cache_header(cache)->misses++;
+        cache->session_misses++;
+    }
+    cache_unlock(cache);
+    return data;
+}
+
+int response_cache_put(ResponseCache *cache, const unsigned char key[SHA256_DIGEST_SIZE],
+                       long ttl_seconds, const char *data, size_t len) {
+    if (!cache || !data || len > CACHE_MAX_DATA) return 0;
+
+    int64_t now = now_ns();
+
+    cache_lock(cache);
+    // Preferir la misma clave, luego una ranura libre o caducada, y si no la menos usada
+    size_t base = set_base(cache, key);
+    CacheSlot *target = NULL;
+    int64_t best = INT64_MAX;
+    for (size_t i = base; i < base + CACHE_WAYS; i++) {
+        CacheSlot *slot = cache_slot(cache, i);
+        if (slot->valid && memcmp(slot->key, key, SHA256_DIGEST_SIZE) == 0) {
+            target = slot;
+            break;
+        }
+        int64_t score = (!slot->valid || slot_expired(slot, ttl_seconds, now)) ? INT64_MIN : slot->last_used;
+        if (!target || score < best) {
+            target = slot;
+            best = score;
+        }
+    }
+
+    CacheHeader *header = cache_header(cache);
+    if (target->valid && memcmp(target->key, key, SHA256_DIGEST_SIZE) != 0 &&
+        !slot_expired(target, ttl_seconds, now)) {
+        header->evictions++;
+    }
+
+    // Invalidar mientras se escriben los datos
+    target->valid = 0;
+    memcpy(target + 1, data, len);
+    memcpy(target->key, key, SHA256_DIGEST_SIZE);
+    target->created = now / 1000000000LL;
+    target->last_used = now;
+    target->len = (uint32_t)len;
+    target->valid = 1;
+    header->stores++;
+    cache_unlock(cache);
+    return 1;
+}
+
+void response_cache_stats(ResponseCache *cache, ResponseCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!cache) return;
+
+    cache_lock(cache);
+    CacheHeader *header = cache_header(cache);
+    stats->hits = header->hits;
+    stats->misses = header->misses;
+    stats->stores = header->stores;
+    stats->evictions = header->evictions;
+    stats->slots = header->slots;
+    for (size_t i = 0; i < header->slots; i++) {
+        if (cache_slot(cache, i)->valid) stats->entries++;
+    }
+    cache_unlock(cache);
+
+    stats->session_hits = cache->session_hits;
+    stats->session_misses = cache->session_misses;
+    stats->max_response = CACHE_MAX_DATA;
+    stats->size_bytes = cache->map_len;
+}
+
+void response_cache_close(ResponseCache *cache) {
+    if (!cache) return;
+    munmap(cache->map, cache->map_len);
+    close(cache->fd);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
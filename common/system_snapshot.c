@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+#include <sys/utsname.h>
+#include "includes/system_snapshot.h"
+#include "includes/buffer.h"
+#include "includes/json_escape.h"
+
+// Sistemas de archivos virtuales que df -h no aporta al diagnóstico
+static const char* pseudo_fs[] = {
+    "proc", "sysfs", "devtmpfs", "devpts", "tmpfs", "cgroup", "cgroup2", "securityfs",
+    "pstore", "bpf", "debugfs", "tracefs", "mqueue", "hugetlbfs", "configfs", "fusectl",
+    "autofs", "binfmt_misc", "efivarfs", "ramfs", "nsfs", "rpc_pipefs", "selinuxfs",
+    "squashfs", "fuse.portal", "fuse.gvfsd-fuse", NULL
+};
+
+// Lee un archivo pequeño completo (terminado en '\0'); devuelve los bytes leídos o -1
+static ssize_t read_small_file(const char* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    size_t len = 0;
+    while (len + 1 < size) {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return (ssize_t)len;
+}
+
+static void copy_trimmed(char* dst, size_t size, const char* src) {
+    while (*src == ' ' || *src == '\t') src++;
+    size_t len = strcspn(src, "\n");
+    while (len > 0 && (src[len - 1] == ' ' || src[len - 1] == '\t')) len--;
+    if (len >= size) len = size - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+static void read_meminfo(SystemSnapshot* snap) {
+    char buf[8192];
+    if (read_small_file("/proc/meminfo", buf, sizeof(buf)) <= 0) return;
+
+    // Valores en kB
+    char* line = buf;
+    while (line && *line) {
+        unsigned long long kb;
+        if (sscanf(line, "MemTotal: %llu", &kb) == 1) snap->mem_total = kb * 1024;
+        else if (sscanf(line, "MemAvailable: %llu", &kb) == 1) snap->mem_available = kb * 1024;
+        else if (sscanf(line, "SwapTotal: %llu", &kb) == 1) snap->swap_total = kb * 1024;
+        else if (sscanf(line, "SwapFree: %llu", &kb) == 1) snap->swap_free = kb * 1024;
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+}
+
+static void read_cpuinfo(SystemSnapshot* snap) {
+    FILE* file = fopen("/proc/cpuinfo", "re");
+    if (file) {
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "processor", 9) == 0) {
+                snap->cpu_count++;
+            } else if (!snap->cpu_model[0] &&
+                       (strncmp(line, "model name", 10) == 0 || strncmp(line, "Model", 5) == 0)) {
+                char* colon = strchr(line, ':');
+                if (colon) copy_trimmed(snap->cpu_model, sizeof(snap->cpu_model), colon + 1);
+            }
+        }
+        fclose(file);
+    }
+    if (snap->cpu_count == 0) snap->cpu_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+static int is_pseudo_fs(const char* fstype) {
+    for (int i = 0; pseudo_fs[i]; i++) {
+        if (strcmp(fstype, pseudo_fs[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// /proc/mounts escapa espacios y tabuladores como \040 y \011
+static void unescape_mount_field(char* s) {
+    char* out = s;
+    for (char* p = s; *p; p++) {
+        if (p[0] == '\\' && p[1] >= '0' && p[1] <= '3' && p[2] >= '0' && p[2] <= '7' &&
+            p[3] >= '0' && p[3] <= '7') {
+            *out++ = (char)((p[1] - '0') * 64 + (p[2] - '0') * 8 + (p[3] - '0'));
+            p += 3;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+}
+
+static void read_mounts(SystemSnapshot* snap) {
+    FILE* file = fopen("/proc/mounts", "re");
+    if (!file) return;
+
+    char line[1024];
+    while (snap->mount_count < SNAPSHOT_MAX_MOUNTS && fgets(line, sizeof(line), file)) {
+        char device[128], mountpoint[256], fstype[32];
+        if (sscanf(line, "%127s %255s %31s", device, mountpoint, fstype) != 3) continue;
+        if (is_pseudo_fs(fstype)) continue;
+        unescape_mount_field(device);
+        unescape_mount_field(mountpoint);
+
+        struct statvfs vfs;
+        if (statvfs(mountpoint, &vfs) != 0 || vfs.f_blocks == 0) continue;
+
+        // El mismo dispositivo montado varias veces (bind mounts) se muestra una vez
+        int duplicate = 0;
+        for (size_t i = 0; i < snap->mount_count; i++) {
+            if (strcmp(snap->mounts[i].device, device) == 0 && device[0] == '/') duplicate = 1;
+        }
+        if (duplicate) continue;
+
+        SnapshotMount* m = &snap->mounts[snap->mount_count++];
+        snprintf(m->device, sizeof(m->device), "%s", device);
+        snprintf(m->mountpoint, sizeof(m->mountpoint), "%s", mountpoint);
+        snprintf(m->fstype, sizeof(m->fstype), "%s", fstype);
+        m->total_bytes = (uint64_t)vfs.f_blocks * vfs.f_frsize;
+        m->avail_bytes = (uint64_t)vfs.f_bavail * vfs.f_frsize;
+        m->used_bytes = (uint64_t)(vfs.f_blocks - vfs.f_bfree) * vfs.f_frsize;
+    }
+    fclose(file);
+}
+
+static long long read_sys_number(const char* dir, const char* name) {
+    char path[512], buf[64];
+    snprintf(path, sizeof(path), "/sys/block/%s/%s", dir, name);
+    if (read_small_file(path, buf, sizeof(buf)) <= 0) return -1;
+    return atoll(buf);
+}
+
+static void read_blocks(SystemSnapshot* snap) {
+    DIR* dir = opendir("/sys/block");
+    if (!dir) return;
+
+    struct dirent* entry;
+    while (snap->block_count < SNAPSHOT_MAX_BLOCKS && (entry = readdir(dir))) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' || strncmp(name, "loop", 4) == 0 || strncmp(name, "ram", 3) == 0) continue;
+
+        long long sectors = read_sys_number(name, "size");
+        if (sectors <= 0) continue;
+
+        SnapshotBlock* b = &snap->blocks[snap->block_count++];
+        memset(b, 0, sizeof(*b));
+        snprintf(b->name, sizeof(b->name), "%.31s", name);
+        b->size_bytes = (uint64_t)sectors * 512;  // /sys/block/*/size siempre cuenta sectores de 512
+        b->removable = read_sys_number(name, "removable") == 1;
+        b->rotational = read_sys_number(name, "queue/rotational") == 1;
+
+        char path[512], model[128];
+        snprintf(path, sizeof(path), "/sys/block/%s/device/model", name);
+        if (read_small_file(path, model, sizeof(model)) > 0) copy_trimmed(b->model, sizeof(b->model), model);
+    }
+    closedir(dir);
+}
+
+int system_snapshot_collect(SystemSnapshot* snap) {
+    memset(snap, 0, sizeof(*snap));
+
+    struct utsname uts;
+    int ok = uname(&uts) == 0;
+    if (ok) {
+        snprintf(snap->sysname, sizeof(snap->sysname), "%s", uts.sysname);
+        snprintf(snap->nodename, sizeof(snap->nodename), "%s", uts.nodename);
+        snprintf(snap->release, sizeof(snap->release), "%s", uts.release);
+        snprintf(snap->version, sizeof(snap->version), "%s", uts.version);
+        snprintf(snap->machine, sizeof(snap->machine), "%s", uts.machine);
+    }
+
+    char buf[256];
+    if (read_small_file("/proc/loadavg", buf, sizeof(buf)) > 0) {
+        sscanf(buf, "%lf %lf %lf %d/%d", &snap->load[0], &snap->load[1], &snap->load[2],
+               &snap->procs_running, &snap->procs_total);
+    }
+    if (read_small_file("/proc/uptime", buf, sizeof(buf)) > 0) {
+        snap->uptime_s = atof(buf);
+    }
+
+    read_meminfo(snap);
+    read_cpuinfo(snap);
+    read_mounts(snap);
+    read_blocks(snap);
+    return ok;
+}
+
+// Tamaño legible con unidades binarias, como df -h
+static void format_size(char* out, size_t size, uint64_t bytes) {
+    static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB", "PiB" };
+    double value = (double)bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 5) {
+        value /= 1024;
+        unit++;
+    }
+    snprintf(out, size, unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+}
+
+char* system_snapshot_text(const SystemSnapshot* snap) {
+    Buffer out;
+    buffer_init(&out);
+    char a[32], b[32], c[32];
+
+    buffer_appendf(&out, "Sistema: %s %s %s %s\n", snap->sysname, snap->nodename, snap->release,
+                   snap->machine);
+
+    long uptime = (long)snap->uptime_s;
+    buffer_appendf(&out, "CPU: %s × %d | carga %.2f %.2f %.2f (%d/%d procesos) | encendido %ld d %ld h %ld min\n",
+                   snap->cpu_model[0] ? snap->cpu_model : "desconocida", snap->cpu_count,
+                   snap->load[0], snap->load[1], snap->load[2], snap->procs_running, snap->procs_total,
+                   uptime / 86400, uptime % 86400 / 3600, uptime % 3600 / 60);
+
+    format_size(a, sizeof(a), snap->mem_total - snap->mem_available);
+    format_size(b, sizeof(b), snap->mem_total);
+    format_size(c, sizeof(c), snap->mem_available);
+    buffer_appendf(&out, "Memoria: %s usados de %s (%s disponibles)", a, b, c);
+    format_size(a, sizeof(a), snap->swap_total - snap->swap_free);
+    format_size(b, sizeof(b), snap->swap_total);
+    buffer_appendf(&out, " | swap %s de %s\n", a, b);
+
+    if (snap->block_count > 0) {
+        buffer_append_str(&out, "Discos:");
+        for (size_t i = 0; i < snap->block_count; i++) {
+            const SnapshotBlock* d = &snap->blocks[i];
+            format_size(a, sizeof(a), d->size_bytes);
+            buffer_appendf(&out, "%s %s %s (%s%s%s%s)", i ? "," : "", d->name, a,
+                           d->rotational ? "HDD" : "SSD", d->removable ? ", extraíble" : "",
+                           d->model[0] ? ", " : "", d->model);
+        }
+        buffer_append_str(&out, "\n");
+    }
+
+    if (snap->mount_count > 0) {
+        buffer_append_str(&out, "Montajes:\n");
+        for (size_t i = 0; i < snap->mount_count; i++) {
+            const SnapshotMount* m = &snap->mounts[i];
+            uint64_t usable = m->used_bytes + m->avail_bytes;
+            format_size(a, sizeof(a), m->used_bytes);
+            format_size(b, sizeof(b), m->total_bytes);
+            format_size(c, sizeof(c), m->avail_bytes);
+            buffer_appendf(&out, "  %s (%s, %s): %s usados de %s, %s libres (%d%%)\n",
+                           m->mountpoint, m->fstype, m->device, a, b, c,
+                           usable ? (int)((m->used_bytes * 100 + usable - 1) / usable) : 0);
+        }
+    }
+    return buffer_detach(&out);
+}
+
+static void append_json_string(Buffer* out, const char* key, const char* value) {
+    buffer_appendf(out, "\"%s\":\"", key);
+    json_escape_append(out, value, strlen(value));
+    buffer_append_str(out, "\"");
+}
+
+char* system_snapshot_json(const SystemSnapshot* snap) {
+    Buffer out;
+    buffer_init(&out);
+
+    buffer_append_str(&out, "{\"kernel\":{");
+    append_json_string(&out, "sysname", snap->sysname);
+    buffer_append_str(&out, ",");
+    append_json_string(&out, "nodename", snap->nodename);
+    buffer_append_str(&out, ",");
+    append_json_string(&out, "release", snap->release);
+    buffer_append_str(&out, ",");
+    append_json_string(&out, "version", snap->version);
+    buffer_append_str(&out, ",");
+    append_json_string(&out, "machine", snap->machine);
+
+    buffer_append_str(&out, "},\"cpu\":{");
+    append_json_string(&out, "model", snap->cpu_model);
+    buffer_appendf(&out, ",\"count\":%d},\"load\":[%.2f,%.2f,%.2f],\"procs_running\":%d,\"procs_total\":%d,"
+                         "\"uptime_s\":%.0f,",
+                   snap->cpu_count, snap->load[0], snap->load[1], snap->load[2],
+                   snap->procs_running, snap->procs_total, snap->uptime_s);
+    buffer_appendf(&out, "\"memory\":{\"total\":%llu,\"available\":%llu,\"swap_total\":%llu,\"swap_free\":%llu},",
+                   (unsigned long long)snap->mem_total, (unsigned long long)snap->mem_available,
+                   (unsigned long long)snap->swap_total, (unsigned long long)snap->swap_free);
+
+    buffer_append_str(&out, "\"block\":[");
+    for (size_t i = 0; i < snap->block_count; i++) {
+        const SnapshotBlock* d = &snap->blocks[i];
+        buffer_append_str(&out, i ? ",{" : "{");
+        append_json_string(&out, "name", d->name);
+        buffer_append_str(&out, ",");
+        append_json_string(&out, "model", d->model);
+        buffer_appendf(&out, ",\"size\":%llu,\"removable\":%s,\"rotational\":%s}",
+                       (unsigned long long)d->size_bytes, d->removable ? "true" : "false",
+                       d->rotational ? "true" : "false");
+    }
+
+    buffer_append_str(&out, "],\"mounts\":[");
+    for (size_t i = 0; i < snap->mount_count; i++) {
+        const SnapshotMount* m = &snap->mounts[i];
+        buffer_append_str(&out, i ? ",{" : "{");
+        append_json_string(&out, "mountpoint", m->mountpoint);
+        buffer_append_str(&out, ",");
+        append_json_string(&out, "device", m->device);
+        buffer_append_str(&out, ",");
+        append_json_string(&out, "fstype", m->fstype);
+        buffer_appendf(&out, ",\"total\":%llu,\"used\":%llu,\"available\":%llu}",
+                       (unsigned long long)m->total_bytes, (unsigned long long)m->used_bytes,
+                       (unsigned long long)m->avail_bytes);
+    }
+    buffer_append_str(&out, "]}");
+    return buffer_detach(&out);
+}
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "includes/tokenizer.h"
+
+#define NO_RANK UINT32_MAX
+#define MAX_PIECE 256            // Fragmentos más largos se cuentan por partes
+
+// Entrada de la tabla hash de tokens (len 0 = libre)
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    uint32_t rank;
+} TokenSlot;
+
+struct Tokenizer {
+    unsigned char *blob;         // Bytes de todos los tokens, uno tras otro
+    size_t blob_len;
+    TokenSlot *slots;
+    size_t mask;                 // Tamaño de la tabla - 1 (potencia de 2)
+    size_t count;
+    int refs;                    // Solo el compartido: referencias (protegidas por shared_lock)
+};
+
+static uint64_t hash_bytes(const unsigned char *p, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint32_t lookup(const Tokenizer *tok, const unsigned char *p, size_t n) {
+    size_t i = hash_bytes(p, n) & tok->mask;
+    while (tok->slots[i].len != 0) {
+        const TokenSlot *s = &tok->slots[i];
+        if (s->len == n && memcmp(tok->blob + s->offset, p, n) == 0) return s->rank;
+        i = (i + 1) & tok->mask;
+    }
+    return NO_RANK;
+}
+
+static int base64_value(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decodifica base64 en out; devuelve los bytes escritos
+static size_t base64_decode(const char *in, size_t len, unsigned char *out) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        int v = base64_value((unsigned char)in[i]);
+        if (v < 0) continue;  // '=' de relleno
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[n++] = (unsigned char)(acc >> bits);
+        }
+    }
+    return n;
+}
+
+Tokenizer* tokenizer_load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    char *text = malloc((size_t)size + 1);
+    if (!text || fread(text, 1, (size_t)size, file) != (size_t)size) {
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    text[size] = '\0';
+
+    size_t lines = 0;
+    for (long i = 0; i < size; i++) {
+        if (text[i] == '\n') lines++;
+    }
+
+    size_t table = 1024;
+    while (table < (lines + 1) * 2) table *= 2;
+
+    Tokenizer *tok = calloc(1, sizeof(Tokenizer));
+    if (tok) {
+        tok->blob = malloc((size_t)size);
+        tok->slots = calloc(table, sizeof(TokenSlot));
+        tok->mask = table - 1;
+    }
+    if (!tok || !tok->blob || !tok->slots) {
+        tokenizer_free(tok);
+        free(text);
+        return NULL;
+    }
+
+    // Cada línea: "<bytes en base64> <rango>"
+    char *line = text;
+    while (line < text + size) {
+        char *eol = strchr(line, '\n');
+        if (!eol) eol = text + size;
+        char *space = memchr(line, ' ', (size_t)(eol - line));
+
+        if (space && space > line) {
+            unsigned char *bytes = tok->blob + tok->blob_len;
+            size_t n = base64_decode(line, (size_t)(space - line), bytes);
+            uint32_t rank = (uint32_t)strtoul(space + 1, NULL, 10);
+
+            if (n > 0 && lookup(tok, bytes, n) == NO_RANK) {
+                size_t i = hash_bytes(bytes, n) & tok->mask;
+                while (tok->slots[i].len != 0) i = (i + 1) & tok->mask;
+                tok->slots[i].offset = (uint32_t)tok->blob_len;
+                tok->slots[i].len = (uint32_t)n;
+                tok->slots[i].rank = rank;
+                tok->blob_len += n;
+                tok->count++;
+            }
+        }
+        line = eol + 1;
+    }
+    free(text);
+
+    if (tok->count < 256) {
+        // Una tabla válida contiene al menos los 256 bytes sueltos
+        tokenizer_free(tok);
+        return NULL;
+    }
+    return tok;
+}
+
+void tokenizer_free(Tokenizer *tok) {
+    if (!tok) return;
+    free(tok->blob);
+    free(tok->slots);
+    free(tok);
+}
+
+// El hilo trabajador y el REPL lo usan a la vez; el propio proceso tiene una
+// referencia mientras shared_path no cambie
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static Tokenizer *shared_tok = NULL;
+static char shared_path[256] = "";
+
+// Con shared_lock tomado
+static void unref_locked(Tokenizer *tok) {
+    if (tok && --tok->refs == 0) tokenizer_free(tok);
+}
+
+const Tokenizer* tokenizer_acquire(const char *path) {
+    if (!path) path = "";
+    pthread_mutex_lock(&shared_lock);
+    if (strcmp(path, shared_path) != 0) {
+        unref_locked(shared_tok);
+        shared_tok = NULL;
+        snprintf(shared_path, sizeof(shared_path), "%s", path);
+
+        if (path[0] != '\0') {
+            shared_tok = tokenizer_load(path);
+            if (shared_tok) {
+                shared_tok->refs = 1;
+            } else {
+                fprintf(stderr, "⚠️  No se pudo cargar el tokenizador %s; se estimarán los tokens.\n", path);
+            }
+        }
+    }
+    Tokenizer *tok = shared_tok;
+    if (tok) tok->refs++;
+    pthread_mutex_unlock(&shared_lock);
+    return tok;
+}
+
+void tokenizer_release(const Tokenizer *tok) {
+    if (!tok) return;
+    pthread_mutex_lock(&shared_lock);
+    unref_locked((Tokenizer *)tok);
+    pthread_mutex_unlock(&shared_lock);
+}
+
+void tokenizer_cleanup(void) {
+    pthread_mutex_lock(&shared_lock);
+    unref_locked(shared_tok);
+    shared_tok = NULL;
+    shared_path[0] = '\0';
+    pthread_mutex_unlock(&shared_lock);
+}
+
+// Clases de caracteres del pre-tokenizador; los bytes UTF-8 no ASCII cuentan como letras
+static int is_letter(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+static int is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static int is_newline(unsigned char c) {
+    return c == '\n' || c == '\r';
+}
+
+static int is_punct(unsigned char c) {
+    return !is_space(c) && !is_letter(c) && !is_digit(c);
+}
+
+static int lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+}
+
+// Devuelve el final del fragmento que empieza en i, siguiendo el patrón de cl100k:
+// contracciones | [^\r\n\pL\pN]?\pL+ | \pN{1,3} | ' '?[^\s\pL\pN]+[\r\n]* |
+// \s*[\r\n]+ | \s+(?!\S) | \s+
+static size_t next_chunk(const unsigned char *s, size_t len, size_t i) {
+    unsigned char c = s[i];
+
+    if (c == '\'' && i + 1 < len) {
+        int a = lower(s[i + 1]);
+        int b = i + 2 < len ? lower(s[i + 2]) : 0;
+        if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) return i + 3;
+        if (a == 's' || a == 't' || a == 'm' || a == 'd') return i + 2;
+    }
+
+    if (is_letter(c) || (!is_newline(c) && !is_digit(c) && i + 1 < len && is_letter(s[i + 1]))) {
+        size_t j = i + 1;
+        while (j < len && is_letter(s[j])) j++;
+        return j;
+    }
+
+    if (is_digit(c)) {
+        size_t j = i + 1;
+        while (j < len && j < i + 3 && is_digit(s[j])) j++;
+        return j;
+    }
+
+    if (is_punct(c) || (c == ' ' && i + 1 < len && is_punct(s[i + 1]))) {
+        size_t j = c == ' ' ? i + 1 : i;
+        while (j < len && is_punct(s[j])) j++;
+        while (j < len && is_newline(s[j])) j++;
+        return j;
+    }
+
+    // Espacios: hasta el último salto de línea del tramo, o dejando el último
+    // espacio para el fragmento siguiente
+    size_t j = i;
+    size_t last_newline = 0;
+    while (j < len && is_space(s[j])) {
+        if (is_newline(s[j])) last_newline = j + 1;
+        j++;
+    }
+    if (last_newline) return last_newline;
+    if (j == len || j - i == 1) return j;
+    return j - 1;
+}
+
+// Aplica las fusiones BPE a un fragmento y devuelve el número de tokens
+static size_t bpe_count(const Tokenizer *tok, const unsigned char *p, size_t n) {
+    if (n <= 1) return n;
+    if (lookup(tok, p, n) != NO_RANK) return 1;
+
+    // pos[i] = inicio de cada parte; rank[i] = rango de unir las partes i e i+1
+    size_t pos[MAX_PIECE + 1];
+    uint32_t rank[MAX_PIECE + 1];
+    size_t m = n + 1;
+    for (size_t i = 0; i < m; i++) pos[i] = i;
+    for (size_t i = 0; i + 2 < m; i++) rank[i] = lookup(tok, p + pos[i], 2);
+    rank[m - 2] = NO_RANK;
+
+    while (m > 2) {
+        size_t best = 0;
+        uint32_t best_rank = NO_RANK;
+        for (size_t i = 0; i + 2 < m; i++) {
+            if (rank[i] < best_rank) {
+                best_rank = rank[i];
+                best = i;
+            }
+        }
+        if (best_rank == NO_RANK) break;
+
+        // Quitar la frontera best + 1 y recalcular los rangos vecinos
+        memmove(&pos[best + 1], &pos[best + 2], (m - best - 2) * sizeof(size_t));
+        memmove(&rank[best + 1], &rank[best + 2], (m - best - 2) * sizeof(uint32_t));
+        m--;
+        rank[best] = best + 2 < m ? lookup(tok, p + pos[best], pos[best + 2] - pos[best]) : NO_RANK;
+        if (best > 0) {
+            rank[best - 1] = lookup(tok, p + pos[best - 1], pos[best + 1] - pos[best - 1]);
+        }
+    }
+    return m - 1;
+}
+
+// Cuenta un fragmento del pre-tokenizador, partiendo los muy largos
+static size_t chunk_count(const Tokenizer *tok, const unsigned char *p, size_t n) {
+    size_t total = 0;
+    while (n > MAX_PIECE) {
+        size_t cut = MAX_PIECE;
+        while (cut > 1 && (p[cut] & 0xC0) == 0x80) cut--;
+        total += bpe_count(tok, p, cut);
+        p += cut;
+        n -= cut;
+    }
+    return total + bpe_count(tok, p, n);
+}
+
+static size_t estimate(size_t len) {
+    return (len + 3) / 4;
+}
+
+size_t tokenizer_count(const Tokenizer *tok, const char *text, size_t len) {
+    if (!text || len == 0) return 0;
+    if (!tok) return estimate(len);
+
+    const unsigned char *s = (const unsigned char *)text;
+    size_t total = 0;
+    for (size_t i = 0; i < len; ) {
+        size_t end = next_chunk(s, len, i);
+        total += chunk_count(tok, s + i, end - i);
+        i = end;
+    }
+    return total;
+}
+
+// Offset del sufijo de text que cabe en max_tokens según la estimación
+static size_t estimate_tail(const unsigned char *s, size_t len, size_t max_tokens) {
+    size_t bytes = max_tokens * 4;
+    size_t offset = len > bytes ? len - bytes : 0;
+    while (offset < len && (s[offset] & 0xC0) == 0x80) offset++;
+    return offset;
+}
+
+size_t tokenizer_tail(const Tokenizer *tok, const char *text, size_t len,
+                      size_t max_tokens, size_t *tokens) {
+    const unsigned char *s = (const unsigned char *)text;
+    size_t offset = len;
+    size_t used = 0;
+
+    // Inicio y tokens de cada fragmento, para acumularlos desde el final
+    size_t cap = 64, n = 0;
+    size_t *starts = tok ? malloc(cap * sizeof(size_t)) : NULL;
+    size_t *counts = tok ? malloc(cap * sizeof(size_t)) : NULL;
+    int ok = starts && counts;
+
+    for (size_t i = 0; ok && i < len; n++) {
+        if (n == cap) {
+            cap *= 2;
+            size_t *ns = realloc(starts, cap * sizeof(size_t));
+            if (ns) starts = ns;
+            size_t *nc = realloc(counts, cap * sizeof(size_t));
+            if (nc) counts = nc;
+            ok = ns && nc;
+            if (!ok) break;
+        }
+        size_t end = next_chunk(s, len, i);
+        starts[n] = i;
+        counts[n] = chunk_count(tok, s + i, end - i);
+        i = end;
+    }
+
+    if (ok) {
+        while (n > 0 && used + counts[n - 1] <= max_tokens) {
+            n--;
+            used += counts[n];
+            offset = starts[n];
+        }
+    } else {
+        offset = estimate_tail(s, len, max_tokens);
+        used = estimate(len - offset);
+    }
+    free(starts);
+    free(counts);
+
+    if (tokens) *tokens = used;
+    return offset;
+}
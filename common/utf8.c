@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "includes/utf8.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+// Longitud del tramo ASCII inicial de s
+typedef size_t (*AsciiFn)(const unsigned char *s, size_t len);
+
+static size_t ascii_scalar(const unsigned char *s, size_t len) {
+    size_t i = 0;
+    while (i < len && s[i] < 0x80) i++;
+    return i;
+}
+
+#ifdef UTF8_X86
+// movemask recoge directamente el bit alto de cada byte
+__attribute__((target("sse2")))
+static size_t ascii_sse2(const unsigned char *s, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + ascii_scalar(s + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t ascii_avx2(const unsigned char *s, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + ascii_sse2(s + i, len - i);
+}
+#endif
+
+// Elegida una sola vez según la CPU, aunque lleguen varias hebras a la vez
+static pthread_once_t ascii_once = PTHREAD_ONCE_INIT;
+static AsciiFn ascii_impl = ascii_scalar;
+
+static void select_ascii(void) {
+    AsciiFn fn = ascii_scalar;
+#ifdef UTF8_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fn = ascii_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        fn = ascii_sse2;
+    }
+#endif
+    ascii_impl = fn;
+}
+
+// Comprueba la secuencia multibyte que empieza en s[0] (>= 0x80). Devuelve su
+// longitud si es válida o 0 si no; en ese caso *bad recibe los bytes de la
+// subparte maximal que se sustituye por un único U+FFFD
+static size_t check_sequence(const unsigned char *s, size_t len, size_t *bad) {
+    unsigned char c = s[0];
+    size_t need;
+    unsigned char lo = 0x80, hi = 0xbf;  // Rango permitido del segundo byte
+
+    if (c >= 0xc2 && c <= 0xdf) {
+        need = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        need = 3;
+        if (c == 0xe0) lo = 0xa0;        // Sin formas sobrelargas
+        if (c == 0xed) hi = 0x9f;        // Sin sustitutos (U+D800..U+DFFF)
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        need = 4;
+        if (c == 0xf0) lo = 0x90;
+        if (c == 0xf4) hi = 0x8f;        // Nada por encima de U+10FFFF
+    } else {
+        *bad = 1;                        // Continuación suelta o byte inicial imposible
+        return 0;
+    }
+
+    for (size_t k = 1; k < need; k++) {
+        unsigned char min = k == 1 ? lo : 0x80;
+        unsigned char max = k == 1 ? hi : 0xbf;
+        if (k >= len || s[k] < min || s[k] > max) {
+            *bad = k;
+            return 0;
+        }
+    }
+    return need;
+}
+
+size_t utf8_valid_prefix(const char *text, size_t len) {
+    pthread_once(&ascii_once, select_ascii);
+    AsciiFn ascii = ascii_impl;
+
+    const unsigned char *s = (const unsigned char *)text;
+    size_t i = 0;
+    while (i < len) {
+        if (s[i] < 0x80) {
+            i += ascii(s + i, len - i);
+            continue;
+        }
+        size_t bad;
+        size_t n = check_sequence(s + i, len - i, &bad);
+        if (n == 0) return i;
+        i += n;
+    }
+    return len;
+}
+
+int utf8_is_valid(const char *s, size_t len) {
+    return utf8_valid_prefix(s, len) == len;
+}
+
+size_t utf8_repair_append(Buffer *out, const char *s, size_t len) {
+    size_t replaced = 0;
+    size_t i = 0;
+    while (i < len) {
+        size_t valid = utf8_valid_prefix(s + i, len - i);
+        buffer_append(out, s + i, valid);
+        i += valid;
+        if (i == len) break;
+
+        size_t bad;
+        check_sequence((const unsigned char *)s + i, len - i, &bad);
+        buffer_append(out, UTF8_REPLACEMENT, sizeof(UTF8_REPLACEMENT) - 1);
+        i += bad;
+        replaced++;
+    }
+    return replaced;
+}
+
+size_t utf8_sanitize(char **text) {
+    if (!text || !*text) return 0;
+    size_t len = strlen(*text);
+    size_t valid = utf8_valid_prefix(*text, len);
+    if (valid == len) return 0;
+
+    Buffer out;
+    buffer_init(&out);
+    if (!buffer_reserve(&out, len + len / 8 + 8)) return 0;
+    buffer_append(&out, *text, valid);
+    size_t replaced = utf8_repair_append(&out, *text + valid, len - valid);
+    char *fixed = buffer_detach(&out);
+    if (!fixed) return 0;
+    free(*text);
+    *text = fixed;
+    return replaced;
+}
@@ -1,9 +1,12 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <sys/wait.h>
 #include "includes/utils.h"
+#include "includes/exec.h"
+#include "includes/buffer.h"
+#include "includes/code_blocks.h"
 
 // Función para eliminar espacios en blanco al inicio y final de una cadena
 char* trim(char* str) {
@@ -32,129 +35,129 @@ char* trim(char* str) {
 
 // Función mejorada para extraer comandos bash que maneja múltiples formatos
 char* extract_command_improved(const char *text, const char *language) {
-    if (!text || !language) return NULL;
-    
-    // Preparar los marcadores a buscar
-    char start_marker[20];
-    snprintf(start_marker, sizeof(start_marker), "```%s", language);
-    
-    // Buscar cualquier formato de bloque de código
-    const char *patterns[] = {
-        start_marker,      // ```bash
-        "```shell",        // ```shell
-        "```sh",           // ```sh
-        "```console",      // ```console
-        "```terminal",     // ```terminal
-        "```",             // Bloque de código sin especificar
-        "$",               // Línea que comienza con $
-        NULL
-    };
+    if (!text) return NULL;
     
+    // Primer bloque ejecutable (```bash, ~~~sh, líneas "$ "...) en orden de aparición
+    CodeBlockList blocks;
     char *result = NULL;
-    const char *start = NULL;
-    const char *end = NULL;
-    int pattern_index = 0;
-    
-    // Intentar cada patrón
-    while (patterns[pattern_index] != NULL && !start) {
-        start = strstr(text, patterns[pattern_index]);
-        
-        // Si encontramos un patrón de inicio de bloque de código
-        if (start && (strncmp(patterns[pattern_index], "```", 3) == 0)) {
-            // Saltar al final del marcador
-            start = strchr(start, '\n');
-            if (start) start++;
-            
-            // Buscar el cierre del bloque
-            end = strstr(start, "```");
-            
-            // Si no encontramos cierre, buscar hasta el final del texto
-            if (!end) end = text + strlen(text);
-        }
-        // Si encontramos un patrón de línea con $
-        else if (start && (strcmp(patterns[pattern_index], "$") == 0)) {
-            // Saltar el $ y espacios
-            start++;
-            while (*start && isspace((unsigned char)*start)) start++;
-            
-            // Buscar el final de la línea
-            end = strchr(start, '\n');
-            if (!end) end = text + strlen(text);
-        }
-        
-        pattern_index++;
+    if (code_blocks_commands(text, language, &blocks) > 0) {
+        result = blocks.items[0].body;
+        blocks.items[0].body = NULL;
     }
-    
-    // Si encontramos un comando
-    if (start && start < end) {
-        size_t len = end - start;
-        result = malloc(len + 1);
-        if (result) {
-            strncpy(result, start, len);
-            result[len] = '\0';
-            
-            // Limpiar espacios en blanco
-            trim(result);
-            
-            // Si es vacío, liberar y devolver NULL
-            if (strlen(result) == 0) {
-                free(result);
-                result = NULL;
+    code_blocks_free(&blocks);
+    return result;
+}
+
+size_t ask_command_selection(const CodeBlockList *blocks, int *selected) {
+    if (!blocks || blocks->count == 0) return 0;
+    
+    if (blocks->count == 1) {
+        printf("💡 Comando detectado:\n    %s\n", blocks->items[0].body);
+        printf("¿Deseas ejecutarlo? [s/N]: ");
+    } else {
+        printf("💡 Se detectaron %zu comandos:\n", blocks->count);
+        for (size_t i = 0; i < blocks->count; i++) {
+            // Los bloques de varias líneas se muestran enteros, con sangría
+            const char *line = blocks->items[i].body;
+            printf("  [%zu] ", i + 1);
+            while (*line) {
+                const char *nl = strchr(line, '\n');
+                int len = nl ? (int)(nl - line) : (int)strlen(line);
+                printf("%.*s\n", len, line);
+                line = nl ? nl + 1 : line + len;
+                if (*line) printf("      ");
             }
         }
+        printf("¿Cuáles ejecutar? [t = todos, 2 o 1,3 o 1-2 = algunos, N = ninguno]: ");
     }
+    fflush(stdout);
     
-    return result;
+    char answer[128] = {0};
+    if (!fgets(answer, sizeof(answer), stdin)) return 0;
+    answer[strcspn(answer, "\n")] = 0;
+    return code_blocks_parse_selection(answer, blocks->count, selected);
+}
+
+// Modo en vivo: la salida se muestra mientras el comando corre
+static int live_output = 0;
+
+void run_command_set_live(int enabled) {
+    live_output = enabled;
+}
+
+// Sin plazo por defecto: una actualización larga no debe cortarse a medias
+static int command_timeout_ms = 0;
+static size_t command_max_output = EXEC_DEFAULT_MAX_OUTPUT;
+
+void run_command_set_limits(int timeout_ms, size_t max_output) {
+    command_timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+    command_max_output = max_output;
+}
+
+// Reenvía cada bloque al terminal en cuanto llega (stderr a stderr)
+static void forward_output(int stream, const char* data, size_t len, void* ctx) {
+    (void)ctx;
+    FILE* dest = stream == EXEC_STDERR ? stderr : stdout;
+    fwrite(data, 1, len, dest);
+    fflush(dest);
+}
+
+// Añade el motivo de la terminación si no fue una salida normal con código 0
+static void append_status(Buffer* output, const ExecResult* res) {
+    if (res->timed_out) {
+        buffer_appendf(output, "\n[Tiempo agotado: se detuvo tras %.1f s]", res->elapsed_ms / 1000.0);
+    } else if (res->signal) {
+        buffer_appendf(output, "\n[Terminado por la señal %d (%s)]", res->signal, strsignal(res->signal));
+    } else if (res->exit_code != 0) {
+        buffer_appendf(output, "\n[Código de salida: %d]", res->exit_code);
+    }
 }
 
 // Versión mejorada de run_command que registra salida estándar y errores
 char* run_command_improved(const char *cmd) {
     if (!cmd) return strdup("Error: Comando vacío");
     
-    // Crear un comando que capture tanto stdout como stderr
-    char actual_cmd[4096];
-    snprintf(actual_cmd, sizeof(actual_cmd), "{ %s; } 2>&1", cmd);
-    
-    FILE *fp = popen(actual_cmd, "r");
-    if (!fp) return strdup("Error: No se pudo ejecutar el comando");
-    
-    // Leer la salida
-    char *output = malloc(8192);
-    if (!output) {
-        pclose(fp);
-        return strdup("Error: No se pudo asignar memoria para la salida");
+    // El comando recibe el terminal: Ctrl-C lo interrumpe y puede pedir confirmaciones
+    ExecOptions options;
+    exec_options_init(&options);
+    options.foreground = 1;
+    options.timeout_ms = command_timeout_ms;
+    options.max_output = command_max_output;
+    if (live_output) options.on_output = forward_output;
+    
+    ExecResult res;
+    if (!exec_run(cmd, &options, &res)) {
+        char error[256];
+        snprintf(error, sizeof(error), "Error: No se pudo ejecutar el comando (%s)", res.error);
+        if (live_output) printf("%s\n", error);
+        return strdup(error);
     }
     
-    output[0] = '\0';
-    char buffer[1024];
-    size_t total_read = 0;
-    const size_t max_size = 8192 - 1; // Reservar espacio para el terminador nulo
+    Buffer output;
+    buffer_init(&output);
+    buffer_append(&output, res.out.data, res.out.len);
     
-    while (fgets(buffer, sizeof(buffer), fp) && total_read < max_size) {
-        size_t len = strlen(buffer);
-        if (total_read + len > max_size) {
-            len = max_size - total_read;
-            buffer[len] = '\0';
-        }
-        
-        strcat(output, buffer);
-        total_read += len;
+    // stderr llega aparte; se añade después de la salida normal
+    if (res.err.len > 0) {
+        if (output.len > 0 && output.data[output.len - 1] != '\n') buffer_append_str(&output, "\n");
+        buffer_append_str(&output, "[stderr]:\n");
+        buffer_append(&output, res.err.data, res.err.len);
     }
     
-    int status = pclose(fp);
-    
     // Añadir información sobre el estado de salida si hubo error
-    if (status != 0) {
-        char status_info[100];
-        snprintf(status_info, sizeof(status_info), 
-                 "\n[Código de salida: %d]", WEXITSTATUS(status));
-        
-        if (total_read + strlen(status_info) < max_size) {
-            strcat(output, status_info);
-        }
+    size_t status_at = output.len;
+    append_status(&output, &res);
+    
+    // En vivo ya se vio la salida: solo falta el estado final
+    if (live_output) {
+        if (status_at > 0 && output.data[status_at - 1] != '\n') putchar('\n');
+        if (output.len > status_at) printf("%s\n", output.data + status_at + 1);
+        fflush(stdout);
     }
     
-    return output;
+    exec_result_free(&res);
+    char *text = buffer_detach(&output);
+    return text ? text : strdup("");
 }
 
 char* read_api_key() {
@@ -1,130 +1,260 @@
-/* =====================
-   Modificación de openai.h
-   ===================== */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "api/openai.h"
+#include "api/request_engine.h"
+#include "api/batch.h"
+#include "common/includes/utils.h"
+#include "common/includes/code_blocks.h"
+#include "common/includes/context.h"
+#include "common/includes/config_manager.h"
+#include "common/includes/metrics.h"
+#include "common/includes/diagnostics.h"
+#include "common/includes/system_snapshot.h"
 
-   #ifndef OPENAI_H
-   #define OPENAI_H
-   
-   // Función para enviar un prompt a la API de OpenAI
-   // Ahora recibe un archivo de configuración en lugar de un archivo de rol
-   char* send_prompt(const char* prompt, const char* config_file);
-   
-   #endif /* OPENAI_H */
-   
-   
-   /* =====================
-      Modificación de main.c (fragmento)
-      ===================== */
-   
-   #include <stdio.h>
-   #include <stdlib.h>
-   #include <string.h>
-   #include "api/openai.h"
-   #include "common/includes/utils.h"
-   #include "common/includes/context.h"
-   #include "common/includes/config_manager.h"
-   
-   // Definiciones específicas para cada módulo
-   #ifdef MODO_ARCH
-   #include "modulos/arch/executor.h"
-   #define MODULE_NAME "Asistente Arch Linux"
-   #define CONFIG_FILE "modulos/arch/config.ini"
-   #define extract_command extract_command_arch
-   #define run_command run_command_arch
-   #endif
-   
-   #ifdef MODO_CHAT
-   #include "modulos/chat/executor.h"
-   #define MODULE_NAME "Asistente Conversacional"
-   #define CONFIG_FILE "modulos/chat/config.ini"
-   #define extract_command extract_command_chat
-   #define run_command run_command_chat
-   #endif
-   
-   #ifdef MODO_CREATOR
-   #include "modulos/creator/executor.h"
-   #define MODULE_NAME "Generador de Estructuras"
-   #define CONFIG_FILE "modulos/creator/config.ini"
-   #define extract_command extract_command_creator
-   #define run_command run_command_creator
-   #endif
-   
-   // Definición predeterminada de CONFIG_FILE si no se definió un módulo
-   #ifndef CONFIG_FILE
-   #define CONFIG_FILE "default/config.ini"
-   #endif
-   
-   #ifndef MODULE_NAME
-   #define MODULE_NAME "Asistente GPT"
-   #endif
-   
-   #ifndef extract_command
-   #define extract_command extract_command_improved
-   #endif
-   
-   #ifndef run_command
-   #define run_command run_command_improved
-   #endif
-   
-   // Función principal
-   int main(int __attribute__((unused)) argc, char __attribute__((unused)) *argv[]) {
-      // Inicializar el contexto
-       load_context();
-       
-       printf("=== %s ===\n", MODULE_NAME);
-       printf("Escribe 'salir' para terminar.\n\n");
-       
-       char input[2048];
-       
-       while (1) {
-           printf("> ");
-           if (!fgets(input, sizeof(input), stdin)) {
-               break;
-           }
-           
-           // Eliminar el salto de línea final
-           input[strcspn(input, "\n")] = 0;
-           
-           // Verificar si se debe salir
-           if (strcmp(input, "salir") == 0 || 
-               strcmp(input, "exit") == 0 || 
-               strcmp(input, "quit") == 0) {
-               break;
-           }
-           
-           // Si está vacío, continuar
-           if (strlen(input) == 0) {
-               continue;
-           }
-           
-           // Enviar prompt a la API
-           printf("Consultando a OpenAI...\n");
-           char* respuesta = send_prompt(input, CONFIG_FILE);
-           
-           // Mostrar la respuesta
-           printf("\n--- Respuesta ---\n%s\n\n", respuesta);
-           
-           // Verificar si hay comandos en la respuesta
-           char* comando = extract_command(respuesta);
-           if (comando) {
-               printf("¿Deseas ejecutar el comando detectado? [s/N]: ");
-               char confirmar[10] = {0};
-               fgets(confirmar, sizeof(confirmar), stdin);
-               confirmar[strcspn(confirmar, "\n")] = 0;
-               
-               if (confirmar[0] == 's' || confirmar[0] == 'S') {
-                   printf("\n=== Ejecutando comando ===\n");
-                   char* resultado = run_command(comando);
-                   printf("%s\n", resultado);
-                   free(resultado);
-               }
-               
-               free(comando);
-           }
-           
-           free(respuesta);
-       }
-       
-       printf("¡Hasta pronto!\n");
-       return 0;
-   }
\ No newline at end of file
+// Definiciones específicas para cada módulo
+#ifdef MODO_ARCH
+#include "modulos/arch/executor.h"
+#define MODULE_NAME "Asistente Arch Linux"
+#define CONFIG_FILE "modulos/arch/config.ini"
+#define MODULE_ID "arch"
+#define DIAG_FILE "modulos/arch/" DIAG_FILE_NAME
+#define run_command run_command_arch
+#endif
+
+#ifdef MODO_CHAT
+#include "modulos/chat/executor.h"
+#define MODULE_NAME "Asistente Conversacional"
+#define CONFIG_FILE "modulos/chat/config.ini"
+#define MODULE_ID "chat"
+#define run_command run_command_chat
+#endif
+
+#ifdef MODO_CREATOR
+#include "modulos/creator/executor.h"
+#define MODULE_NAME "Generador de Estructuras"
+#define CONFIG_FILE "modulos/creator/config.ini"
+#define MODULE_ID "creator"
+#define run_command run_command_creator
+#endif
+
+// Definición predeterminada de CONFIG_FILE si no se definió un módulo
+#ifndef CONFIG_FILE
+#define CONFIG_FILE "default/config.ini"
+#endif
+
+#ifndef MODULE_NAME
+#define MODULE_NAME "Asistente GPT"
+#endif
+
+#ifndef MODULE_ID
+#define MODULE_ID "default"
+#endif
+
+// Lenguaje de bloque que, además de los de shell, se ofrece ejecutar
+#ifndef COMMAND_LANGUAGE
+#define COMMAND_LANGUAGE "bash"
+#endif
+
+#ifndef run_command
+#define run_command run_command_improved
+#endif
+
+// Muestra cada fragmento de la respuesta en cuanto llega
+static void print_token(const char* token, size_t len, void* userdata) {
+    int* streamed = userdata;
+    if (!*streamed) {
+        printf("\n--- Respuesta ---\n");
+        *streamed = 1;
+    }
+    fwrite(token, 1, len, stdout);
+    fflush(stdout);
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [--trace trace.json] [--batch prompts.jsonl [--concurrency N] "
+                    "[--out results.jsonl]]\n", prog);
+}
+
+// Modo por lotes: prompts independientes, sin historial ni REPL
+static int main_batch(const char* input, const char* output, int concurrency) {
+    GPTConfigStore* config = config_store_open(CONFIG_FILE);
+    if (!config) {
+        fprintf(stderr, "Error: No se pudo cargar la configuración %s\n", CONFIG_FILE);
+        return 1;
+    }
+    const GPTConfig* current = config_store_get(config);
+    if (current) metrics_export_start(current->metrics_file, current->metrics_interval, MODULE_ID);
+    
+    int rc = run_batch(input, output, concurrency, config);
+    
+    openai_cleanup();
+    metrics_shutdown();
+    config_store_close(config);
+    return rc == 0 ? 0 : 1;
+}
+
+// Función principal
+int main(int argc, char *argv[]) {
+    const char* batch_input = NULL;
+    const char* batch_output = NULL;
+    int concurrency = BATCH_DEFAULT_CONCURRENCY;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_input = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            batch_output = argv[++i];
+        } else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc) {
+            concurrency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!metrics_trace_open(argv[++i])) return 1;
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    
+    if (batch_input) {
+        return main_batch(batch_input, batch_output, concurrency);
+    }
+    
+   // Inicializar el contexto
+    load_context();
+    
+    // Cargar la configuración del módulo una sola vez (se recarga sola si cambia)
+    GPTConfigStore* config = config_store_open(CONFIG_FILE);
+    if (!config) {
+        fprintf(stderr, "Error: No se pudo cargar la configuración %s\n", CONFIG_FILE);
+        return 1;
+    }
+    const GPTConfig* current = config_store_get(config);
+    if (current) metrics_export_start(current->metrics_file, current->metrics_interval, MODULE_ID);
+    
+    // Ctrl-C cancela la solicitud en curso en vez de cerrar la sesión
+    request_engine_install_sigint();
+    
+    printf("=== %s ===\n", MODULE_NAME);
+    printf("Escribe 'salir' para terminar.\n\n");
+    
+    char input[2048];
+    
+    while (1) {
+        printf("> ");
+        if (!fgets(input, sizeof(input), stdin)) {
+            // Ctrl-C en el prompt: línea nueva en vez de salir
+            if (request_engine_interrupted()) {
+                clearerr(stdin);
+                printf("\n");
+                continue;
+            }
+            break;
+        }
+        
+        // Eliminar el salto de línea final
+        input[strcspn(input, "\n")] = 0;
+        
+        // Verificar si se debe salir
+        if (strcmp(input, "salir") == 0 || 
+            strcmp(input, "exit") == 0 || 
+            strcmp(input, "quit") == 0) {
+            break;
+        }
+        
+        // Si está vacío, continuar
+        if (strlen(input) == 0) {
+            continue;
+        }
+        
+        // Estadísticas de la caché de respuestas
+        if (strcmp(input, "/cache") == 0) {
+            openai_print_cache_stats(config);
+            continue;
+        }
+        
+#ifdef DIAG_FILE
+        // Estado del sistema leído de /proc y /sys; se añade al contexto para GPT
+        if (strcmp(input, "/status") == 0) {
+            SystemSnapshot snap;
+            system_snapshot_collect(&snap);
+            char* estado = system_snapshot_text(&snap);
+            if (estado) {
+                printf("=== Estado del sistema ===\n%s\n", estado);
+                char nota[8192];
+                snprintf(nota, sizeof(nota), "Estado del sistema:\n%s", estado);
+                context_append("system", nota);
+                free(estado);
+            }
+            continue;
+        }
+        
+        // Diagnóstico del sistema: los comandos de diagnostics.ini, en paralelo
+        if (strcmp(input, "/diag") == 0) {
+            DiagReport report;
+            if (diagnostics_load(&report, DIAG_FILE)) {
+                diagnostics_run(&report);
+                char* informe = diagnostics_format(&report);
+                printf("=== Diagnóstico del sistema ===\n%s\n", informe ? informe : "");
+                free(informe);
+                diagnostics_free(&report);
+            }
+            continue;
+        }
+#endif
+        
+        // Enviar prompt a la API
+        printf("Consultando a OpenAI...\n");
+        int streamed = 0;
+        char* respuesta = prompt_run_interactive(input, config, print_token, &streamed);
+        
+        // Mostrar la respuesta (si no se mostró ya en streaming)
+        if (streamed) {
+            printf("\n\n");
+        } else {
+            printf("\n--- Respuesta ---\n%s\n\n", respuesta);
+        }
+        
+        // Verificar si hay comandos en la respuesta (todos los bloques, en una pasada)
+        uint64_t t0 = metrics_now();
+        CodeBlockList comandos;
+        code_blocks_commands(respuesta, COMMAND_LANGUAGE, &comandos);
+        metrics_span(METRIC_STAGE_EXTRACT, t0);
+        if (comandos.count > 0) {
+            int* elegidos = calloc(comandos.count, sizeof(int));
+            size_t total = elegidos ? ask_command_selection(&comandos, elegidos) : 0;
+            
+            const GPTConfig* cfg = config_store_get(config);
+            int live = cfg && cfg->live_output;
+            run_command_set_live(live);
+            if (cfg) run_command_set_limits(cfg->command_timeout * 1000, (size_t)cfg->command_max_output * 1024);
+            size_t n = 0;
+            for (size_t i = 0; i < comandos.count && total > 0; i++) {
+                if (!elegidos[i]) continue;
+                if (total > 1) {
+                    printf("\n=== Ejecutando comando %zu/%zu ===\n", ++n, total);
+                } else {
+                    printf("\n=== Ejecutando comando ===\n");
+                }
+                fflush(stdout);
+                t0 = metrics_now();
+                char* resultado = run_command(comandos.items[i].body);
+                metrics_span(METRIC_STAGE_EXEC, t0);
+                if (!live) printf("%s\n", resultado);
+                free(resultado);
+            }
+            
+            free(elegidos);
+        }
+        code_blocks_free(&comandos);
+        
+        free(respuesta);
+    }
+    
+    request_engine_shutdown();
+    openai_cleanup();
+    metrics_shutdown();
+    config_store_close(config);
+    context_close();
+    printf("¡Hasta pronto!\n");
+    return 0;
+}
\ No newline at end of file
@@ -2,9 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include "api/openai.h"
+#include "api/request_engine.h"
 #include "common/includes/utils.h"
+#include "common/includes/code_blocks.h"
 #include "common/includes/context.h"
 #include "common/includes/config_manager.h"
+#include "common/includes/metrics.h"
+#include "common/includes/diagnostics.h"
+#include "common/includes/system_snapshot.h"
+#include "common/includes/output_reducer.h"
+#include "common/includes/buffer.h"
+#include "common/includes/command_index.h"
 #include "mcp_client.h"
 
 // Definiciones específicas para cada módulo
@@ -12,7 +20,8 @@
 #include "modulos/arch_mcp/executor.h"
 #define MODULE_NAME "🚀 Asistente Arch Linux MCP"
 #define CONFIG_FILE "modulos/arch_mcp/config.ini"
-#define extract_command extract_command_arch_mcp
+#define MODULE_ID "arch_mcp"
+#define DIAG_FILE "modulos/arch_mcp/" DIAG_FILE_NAME
 #define run_command run_command_arch_mcp
 #endif
 
@@ -25,8 +34,17 @@
 #define MODULE_NAME "🚀 Asistente GPT con MCP"
 #endif
 
-#ifndef extract_command
-#define extract_command extract_command_improved
+#ifndef MODULE_ID
+#define MODULE_ID "mcp"
+#endif
+
+#ifndef DIAG_FILE
+#define DIAG_FILE "modulos/arch_mcp/" DIAG_FILE_NAME
+#endif
+
+// Lenguaje de bloque que, además de los de shell, se ofrece ejecutar
+#ifndef COMMAND_LANGUAGE
+#define COMMAND_LANGUAGE "bash"
 #endif
 
 #ifndef run_command
@@ -40,40 +58,123 @@ void show_help() {
     printf("• Comandos Arch: pacman, systemctl, journalctl\n");
     printf("• /help - Mostrar esta ayuda\n");
     printf("• /clear - Limpiar contexto\n");
-    printf("• /status - Estado del sistema\n");
+    printf("• /status - Estado del sistema (se añade al contexto)\n");
     printf("• /diag - Diagnóstico completo Arch Linux\n");
     printf("• /mcp - Información del bridge MCP\n");
+    printf("• /cache - Estadísticas de la caché de respuestas\n");
     printf("• salir/exit/quit - Terminar\n");
     printf("• O simplemente pregunta algo...\n\n");
 }
 
+// Ejecuta el conjunto de diagnóstico a través del bridge: se envían todos los
+// comandos a la vez y se recogen según terminan, hasta el plazo global
+static void run_diagnostics_mcp(MCPClient* mcp_client, DiagReport* report) {
+    int* ids = calloc(report->count, sizeof(int));
+    if (!ids) return;
+    
+    uint64_t start = metrics_now();
+    uint64_t deadline = start + (uint64_t)report->timeout_s * 1000000000ULL;
+    size_t pending = 0;
+    for (size_t i = 0; i < report->count; i++) {
+        ids[i] = mcp_submit(mcp_client, "execute_command", report->results[i].command);
+        if (ids[i]) pending++;
+    }
+    
+    while (pending > 0) {
+        uint64_t now = metrics_now();
+        if (now >= deadline) break;
+        // En tramos cortos, para que Ctrl-C corte el diagnóstico sin esperar al plazo
+        int wait_ms = (int)((deadline - now) / 1000000) + 1;
+        if (wait_ms > MCP_INTERRUPT_CHECK_MS) wait_ms = MCP_INTERRUPT_CHECK_MS;
+        MCPResponse* response = mcp_wait_any(mcp_client, wait_ms);
+        if (!response) {
+            if (mcp_client->broken || request_engine_interrupted()) break;
+            continue;
+        }
+        
+        for (size_t i = 0; i < report->count; i++) {
+            if (ids[i] != response->id) continue;
+            DiagResult* r = &report->results[i];
+            r->elapsed_ms = response->elapsed_ms > 0 ? response->elapsed_ms
+                                                     : (metrics_now() - start) / 1e6;
+            r->exit_code = response->success ? 0 : 1;
+            r->output = strdup(response->result ? response->result :
+                               response->error ? response->error : "");
+            
+            // El bridge añade "[exit_code]: N" al final; pasa al encabezado del informe
+            char* tag = NULL;
+            for (char* p = r->output; p && (p = strstr(p, "[exit_code]: ")); p++) tag = p;
+            if (tag) {
+                r->exit_code = atoi(tag + strlen("[exit_code]: "));
+                *tag = '\0';
+            }
+            ids[i] = 0;
+            pending--;
+            break;
+        }
+        mcp_free_response(response);
+    }
+    
+    // Lo que no respondió a tiempo queda marcado como cortado: el bridge mata esos
+    // comandos y sus respuestas tardías se descartan en vez de acumularse
+    for (size_t i = 0; i < report->count; i++) {
+        if (!ids[i]) continue;
+        mcp_cancel(mcp_client, ids[i]);
+        report->results[i].timed_out = 1;
+        report->results[i].elapsed_ms = (metrics_now() - start) / 1e6;
+    }
+    report->elapsed_ms = (metrics_now() - start) / 1e6;
+    free(ids);
+}
+
+// Función para ejecutar el diagnóstico del módulo (en paralelo) y mostrar el informe
+static void run_diagnostics(MCPClient* mcp_client) {
+    DiagReport report;
+    if (!diagnostics_load(&report, DIAG_FILE)) {
+        printf("❌ Error en el diagnóstico.\n");
+        return;
+    }
+    
+    if (mcp_client) {
+        run_diagnostics_mcp(mcp_client, &report);
+    } else {
+        diagnostics_run(&report);
+    }
+    
+    char* text = diagnostics_format(&report);
+    printf("=== 🩺 Diagnóstico Arch Linux ===\n%s\n", text ? text : "");
+    free(text);
+    diagnostics_free(&report);
+}
+
 // Función para procesar comandos especiales
-int process_special_command(const char* input, MCPClient* mcp_client) {
+int process_special_command(const char* input, MCPClient* mcp_client, GPTConfigStore* config) {
     if (strcmp(input, "/help") == 0) {
         show_help();
         return 1;
     }
     
     if (strcmp(input, "/clear") == 0) {
-        system("rm -f context.txt");
-        load_context();
+        context_clear();
         printf("✅ Contexto limpiado.\n\n");
         return 1;
     }
     
     if (strcmp(input, "/status") == 0) {
-        if (mcp_client) {
-            printf("🔍 Obteniendo información del sistema...\n");
-            MCPResponse* response = mcp_get_system_info(mcp_client);
-            if (response && response->success && response->result) {
-                printf("=== 📊 Estado del Sistema ===\n%s\n\n", response->result);
-            } else {
-                printf("❌ Error al obtener información del sistema.\n\n");
-            }
-            mcp_free_response(response);
-        } else {
-            printf("⚠️  MCP no disponible. Información básica:\n");
-            system("uname -a && df -h . && free -h");
+        // Leído directamente de /proc y /sys: no hace falta el bridge ni lanzar procesos
+        uint64_t t0 = metrics_now();
+        SystemSnapshot snap;
+        system_snapshot_collect(&snap);
+        char* estado = system_snapshot_text(&snap);
+        double ms = (metrics_now() - t0) / 1e6;
+        if (estado) {
+            printf("=== 📊 Estado del Sistema ===\n%s(%.2f ms)\n\n", estado, ms);
+            
+            // Para que GPT conozca el sistema en las siguientes preguntas
+            char nota[8192];
+            snprintf(nota, sizeof(nota), "📊 Estado del sistema:\n%s", estado);
+            context_append("system", nota);
+            free(estado);
         }
         return 1;
     }
@@ -81,16 +182,10 @@ int process_special_command(const char* input, MCPClient* mcp_client) {
     if (strcmp(input, "/diag") == 0) {
         if (mcp_client) {
             printf("🔍 Ejecutando diagnóstico completo de Arch Linux...\n");
-            MCPResponse* response = mcp_arch_diagnostics(mcp_client);
-            if (response && response->success && response->result) {
-                printf("=== 🩺 Diagnóstico Arch Linux ===\n%s\n", response->result);
-            } else {
-                printf("❌ Error en el diagnóstico.\n");
-            }
-            mcp_free_response(response);
+            run_diagnostics(mcp_client);
         } else {
-            printf("⚠️  MCP no disponible. Diagnóstico básico:\n");
-            system("lsblk && df -h && free -h");
+            printf("⚠️  MCP no disponible. Diagnóstico local:\n");
+            run_diagnostics(NULL);
         }
         return 1;
     }
@@ -110,25 +205,92 @@ int process_special_command(const char* input, MCPClient* mcp_client) {
         return 1;
     }
     
+    if (strcmp(input, "/cache") == 0) {
+        openai_print_cache_stats(config);
+        return 1;
+    }
+    
     return 0; // No es un comando especial
 }
 
-// Función mejorada para manejar comandos del usuario
-void handle_user_command(const char* command, MCPClient* mcp_client) {
+// Muestra la salida del comando a medida que el bridge la envía
+static void print_chunk(int id, int fd, const char* data, size_t len, void* ctx) {
+    (void)id;
+    int* last = ctx;
+    FILE* dest = fd == 2 ? stderr : stdout;
+    fwrite(data, 1, len, dest);
+    fflush(dest);
+    if (len > 0) *last = data[len - 1];
+}
+
+// Guarda la salida de un comando en la conversación, reducida al presupuesto
+// OUTPUT_TOKENS del módulo para que un volcado enorme no infle cada solicitud
+static void store_command_output(const char* note, const char* command, const char* output,
+                                 const GPTConfig* current) {
+    const Tokenizer* tok = tokenizer_acquire(current ? current->tokenizer_file : "");
+    size_t budget = current && current->output_tokens > 0 ? (size_t)current->output_tokens : 0;
+    OutputReduceStats stats;
+    char* reduced = output_reduce(output, strlen(output), tok, budget, &stats);
+    tokenizer_release(tok);
+    
+    Buffer msg;
+    buffer_init(&msg);
+    buffer_appendf(&msg, "%s: %s\n", note, command);
+    if (stats.reduced_tokens < stats.original_tokens) {
+        buffer_appendf(&msg, "Salida (reducida de %zu a %zu tokens; %zu líneas repetidas agrupadas, %zu omitidas):\n",
+                       stats.original_tokens, stats.reduced_tokens, stats.collapsed_lines, stats.omitted_lines);
+        printf("📉 Salida guardada en el contexto: %zu → %zu tokens, %zu → %zu líneas (%zu → %zu bytes)\n\n",
+               stats.original_tokens, stats.reduced_tokens, stats.original_lines, stats.reduced_lines,
+               stats.original_bytes, stats.reduced_bytes);
+    } else {
+        buffer_append_str(&msg, "Salida:\n");
+    }
+    buffer_append_str(&msg, reduced);
+    context_append("system", msg.data ? msg.data : "");
+    
+    buffer_free(&msg);
+    free(reduced);
+}
+
+// Función mejorada para manejar comandos del usuario; la salida queda en el
+// contexto precedida de note
+void handle_user_command(const char* command, MCPClient* mcp_client, GPTConfigStore* config,
+                         const char* note) {
+    const GPTConfig* current = config_store_get(config);
+    char* captured = NULL;
+    int live = current && current->live_output;
     printf("\n🔧 Ejecutando: %s\n", command);
     printf("--- Resultado ---\n");
+    fflush(stdout);
+    uint64_t t0 = metrics_now();
     
     if (mcp_client) {
-        // Usar MCP para ejecutar el comando
-        MCPResponse* response = mcp_execute_command(mcp_client, command);
+        // Usar MCP para ejecutar el comando, con el mismo plazo que el modo nativo
+        int last = '\n';
+        mcp_set_command_timeout(mcp_client, current ? current->command_timeout * 1000 : 0);
+        MCPResponse* response = live
+            ? mcp_execute_command_live(mcp_client, command, print_chunk, &last)
+            : mcp_execute_command(mcp_client, command);
         if (response) {
-            if (response->success && response->result) {
+            if (live && response->result) {
+                // La salida ya se vio; solo falta la línea final con el código de salida
+                const char* status = strstr(response->result, "[exit_code]: ");
+                if (last != '\n') printf("\n");
+                if (status) printf("%s\n", status);
+            } else if (response->success && response->result) {
                 printf("%s\n", response->result);
             } else if (response->error) {
                 printf("❌ Error: %s\n", response->error);
             } else {
                 printf("❌ Error desconocido en la ejecución\n");
             }
+            if (response->result) {
+                captured = response->result;
+                response->result = NULL;
+            } else if (response->error) {
+                captured = response->error;
+                response->error = NULL;
+            }
             mcp_free_response(response);
         } else {
             printf("❌ Error: No se pudo comunicar con el bridge MCP\n");
@@ -136,19 +298,58 @@ void handle_user_command(const char* command, MCPClient* mcp_client) {
     } else {
         // Fallback al método original
         printf("⚠️  Usando modo básico (sin MCP):\n");
+        fflush(stdout);
+        run_command_set_live(live);
+        if (current) run_command_set_limits(current->command_timeout * 1000, (size_t)current->command_max_output * 1024);
         char* result = run_command(command);
-        printf("%s\n", result);
-        free(result);
+        if (!live) printf("%s\n", result);
+        captured = result;
     }
+    metrics_span(METRIC_STAGE_EXEC, t0);
     
     printf("--- Fin ---\n\n");
+    
+    store_command_output(note, command, captured ? captured : "(sin salida: no se pudo ejecutar)", current);
+    free(captured);
+}
+
+// Muestra cada fragmento de la respuesta en cuanto llega
+static void print_token(const char* token, size_t len, void* userdata) {
+    int* streamed = userdata;
+    if (!*streamed) {
+        printf("\n--- 💬 Respuesta GPT ---\n");
+        *streamed = 1;
+    }
+    fwrite(token, 1, len, stdout);
+    fflush(stdout);
 }
 
 // Función principal
-int main(int __attribute__((unused)) argc, char __attribute__((unused)) *argv[]) {
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!metrics_trace_open(argv[++i])) return 1;
+        } else {
+            fprintf(stderr, "Uso: %s [--trace trace.json]\n", argv[0]);
+            return 2;
+        }
+    }
+    
     // Inicializar el contexto
     load_context();
     
+    // Cargar la configuración del módulo una sola vez (se recarga sola si cambia)
+    GPTConfigStore* config = config_store_open(CONFIG_FILE);
+    if (!config) {
+        fprintf(stderr, "Error: No se pudo cargar la configuración %s\n", CONFIG_FILE);
+        return 1;
+    }
+    const GPTConfig* current = config_store_get(config);
+    if (current) metrics_export_start(current->metrics_file, current->metrics_interval, MODULE_ID);
+    
+    // Ctrl-C cancela la solicitud en curso en vez de cerrar la sesión
+    request_engine_install_sigint();
+    
     // Crear cliente MCP
     printf("🔌 Inicializando cliente MCP...\n");
     MCPClient* mcp_client = mcp_create_client();
@@ -159,6 +360,15 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) *argv[])
         printf("✅ Cliente MCP inicializado correctamente.\n");
     }
     
+    // Índice de comandos del PATH: se recorre solo si cambió algún directorio
+    uint64_t index_start = metrics_now();
+    CommandIndex* commands = command_index_shared();
+    if (commands) {
+        printf("📇 %zu comandos indexados (%s, %.1f ms).\n", command_index_count(commands),
+               command_index_cached(commands) ? "caché" : "PATH recorrido",
+               (metrics_now() - index_start) / 1e6);
+    }
+    
     printf("\n=== %s ===\n", MODULE_NAME);
     printf("💡 Escribe comandos directos (ls, pwd, etc.) o pregunta algo.\n");
     printf("   Usa /help para ver todos los comandos disponibles.\n\n");
@@ -168,6 +378,12 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) *argv[])
     while (1) {
         printf("🤖 > ");
         if (!fgets(input, sizeof(input), stdin)) {
+            // Ctrl-C en el prompt: línea nueva en vez de salir
+            if (request_engine_interrupted()) {
+                clearerr(stdin);
+                printf("\n");
+                continue;
+            }
             break;
         }
         
@@ -187,54 +403,48 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) *argv[])
         }
         
         // Procesar comandos especiales
-        if (process_special_command(input, mcp_client)) {
+        if (process_special_command(input, mcp_client, config)) {
             continue;
         }
         
         // Detectar si es un comando del usuario
         if (is_user_command(input)) {
-            handle_user_command(input, mcp_client);
-            
-            // Agregar al contexto para que GPT sepa qué se ejecutó
-            FILE *ctx = fopen("context.txt", "a");
-            if (ctx) {
-                fprintf(ctx, "system\t✅ Comando ejecutado: %s\n", input);
-                fclose(ctx);
-            }
-            
+            // La salida queda en el contexto para que GPT sepa qué se ejecutó
+            handle_user_command(input, mcp_client, config, "✅ Comando ejecutado");
             continue;
         }
         
         // Si no es un comando directo, enviar a GPT
         printf("🤖 Procesando con GPT...\n");
-        char* respuesta = send_prompt(input, CONFIG_FILE);
+        int streamed = 0;
+        char* respuesta = prompt_run_interactive(input, config, print_token, &streamed);
         
-        // Mostrar la respuesta
-        printf("\n--- 💬 Respuesta GPT ---\n%s\n\n", respuesta);
+        // Mostrar la respuesta (si no se mostró ya en streaming)
+        if (streamed) {
+            printf("\n\n");
+        } else {
+            printf("\n--- 💬 Respuesta GPT ---\n%s\n\n", respuesta);
+        }
         
-        // Verificar si GPT sugiere ejecutar comandos
-        char* comando_sugerido = extract_command(respuesta);
-        if (comando_sugerido) {
-            printf("💡 GPT sugiere ejecutar: %s\n", comando_sugerido);
-            printf("¿Deseas ejecutarlo? [s/N]: ");
-            
-            char confirmar[10] = {0};
-            fgets(confirmar, sizeof(confirmar), stdin);
-            confirmar[strcspn(confirmar, "\n")] = 0;
+        // Verificar si GPT sugiere ejecutar comandos (todos los bloques, en una pasada)
+        uint64_t t0 = metrics_now();
+        CodeBlockList sugeridos;
+        code_blocks_commands(respuesta, COMMAND_LANGUAGE, &sugeridos);
+        metrics_span(METRIC_STAGE_EXTRACT, t0);
+        if (sugeridos.count > 0) {
+            int* elegidos = calloc(sugeridos.count, sizeof(int));
+            size_t total = elegidos ? ask_command_selection(&sugeridos, elegidos) : 0;
             
-            if (confirmar[0] == 's' || confirmar[0] == 'S') {
-                handle_user_command(comando_sugerido, mcp_client);
-                
-                // Agregar resultado al contexto
-                FILE *ctx = fopen("context.txt", "a");
-                if (ctx) {
-                    fprintf(ctx, "system\t💡 GPT sugirió y se ejecutó: %s\n", comando_sugerido);
-                    fclose(ctx);
-                }
+            size_t n = 0;
+            for (size_t i = 0; i < sugeridos.count && total > 0; i++) {
+                if (!elegidos[i]) continue;
+                if (total > 1) printf("\n=== Comando %zu/%zu ===\n", ++n, total);
+                handle_user_command(sugeridos.items[i].body, mcp_client, config, "💡 GPT sugirió y se ejecutó");
             }
             
-            free(comando_sugerido);
+            free(elegidos);
         }
+        code_blocks_free(&sugeridos);
         
         free(respuesta);
     }
@@ -245,6 +455,12 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) *argv[])
         printf("🔌 Cliente MCP desconectado.\n");
     }
     
+    command_index_cleanup();
+    request_engine_shutdown();
+    openai_cleanup();
+    metrics_shutdown();
+    config_store_close(config);
+    context_close();
     printf("¡Hasta pronto! 👋\n");
     return 0;
 }
\ No newline at end of file
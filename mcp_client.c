@@ -1,17 +1,113 @@
+#define _GNU_SOURCE
 #include "mcp_client.h"
-#include "common/includes/json_parser.h"
+#include "common/includes/json_reader.h"
+#include "common/includes/json_escape.h"
+#include "common/includes/buffer.h"
+#include "common/includes/metrics.h"
+#include "common/includes/command_index.h"
+#include "api/request_engine.h"
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <signal.h>
-#include <ctype.h>
+
+// Escribe len bytes completos (write puede escribir menos en un pipe)
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Lee exactamente len bytes; 0 si el bridge cerró la conexión o hubo error
+static int read_all(int fd, void* data, size_t len) {
+    char* p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        if (n == 0) return 0;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static void put_u32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static int write_frame(int fd, const char* payload, uint32_t len, uint32_t flags) {
+    unsigned char header[MCP_FRAME_HEADER];
+    put_u32(header, len);
+    put_u32(header + 4, flags);
+    return write_all(fd, header, sizeof(header)) && (len == 0 || write_all(fd, payload, len));
+}
+
+// Envía un mensaje, troceado en frames de como mucho MCP_FRAME_CHUNK bytes
+static int write_message(int fd, const char* data, size_t len) {
+    do {
+        uint32_t chunk = len > MCP_FRAME_CHUNK ? MCP_FRAME_CHUNK : (uint32_t)len;
+        uint32_t flags = len > chunk ? MCP_FRAME_MORE : 0;
+        if (!write_frame(fd, data, chunk, flags)) return 0;
+        data += chunk;
+        len -= chunk;
+    } while (len > 0);
+    return 1;
+}
+
+// Lee frames hasta completar un mensaje y lo deja en out (terminado en '\0')
+static int read_message(int fd, Buffer* out) {
+    buffer_clear(out);
+    while (1) {
+        unsigned char header[MCP_FRAME_HEADER];
+        if (!read_all(fd, header, sizeof(header))) return 0;
+        uint32_t len = get_u32(header);
+        uint32_t flags = get_u32(header + 4);
+
+        if (flags & MCP_FRAME_CLOSE) return 0;
+        if (len > MCP_FRAME_CHUNK || out->len + len > MCP_MAX_MESSAGE) return 0;
+        if (!buffer_reserve(out, len)) return 0;
+        if (!read_all(fd, out->data + out->len, len)) return 0;
+        out->len += len;
+        out->data[out->len] = '\0';
+
+        if (!(flags & MCP_FRAME_MORE)) return 1;
+    }
+}
 
 MCPClient* mcp_create_client() {
-    MCPClient* client = malloc(sizeof(MCPClient));
+    MCPClient* client = calloc(1, sizeof(MCPClient));
     if (!client) return NULL;
     
     int to_bridge[2], from_bridge[2];
     
-    if (pipe(to_bridge) == -1 || pipe(from_bridge) == -1) {
+    // O_CLOEXEC: otros procesos hijos no deben heredar los extremos del bridge
+    if (pipe2(to_bridge, O_CLOEXEC) == -1) {
+        free(client);
+        return NULL;
+    }
+    if (pipe2(from_bridge, O_CLOEXEC) == -1) {
+        close(to_bridge[0]); close(to_bridge[1]);
         free(client);
         return NULL;
     }
@@ -25,33 +121,29 @@ MCPClient* mcp_create_client() {
     }
     
     if (pid == 0) {
-        // Proceso hijo - ejecutar el bridge
-        close(to_bridge[1]);
-        close(from_bridge[0]);
-        
+        // Proceso hijo - ejecutar el bridge (dup2 quita O_CLOEXEC a stdin/stdout)
         dup2(to_bridge[0], STDIN_FILENO);
         dup2(from_bridge[1], STDOUT_FILENO);
         
-        close(to_bridge[0]);
-        close(from_bridge[1]);
+        // Grupo de procesos propio: el Ctrl-C del terminal no debe cerrar el bridge
+        setpgid(0, 0);
         
         // Ejecutar el bridge nativo desde out/
         execl("./out/MCPBridge_native", "MCPBridge_native", NULL);
-        exit(1);
+        _exit(1);
     }
     
     // Proceso padre
     close(to_bridge[0]);
     close(from_bridge[1]);
     
-    client->bridge_in = fdopen(to_bridge[1], "w");
-    client->bridge_out = fdopen(from_bridge[0], "r");
-    client->bridge_pid = pid;
+    // Si el bridge muere, write() debe devolver EPIPE en vez de matar al proceso
+    signal(SIGPIPE, SIG_IGN);
     
-    if (!client->bridge_in || !client->bridge_out) {
-        mcp_cleanup(client);
-        return NULL;
-    }
+    client->fd_in = to_bridge[1];
+    client->fd_out = from_bridge[0];
+    client->bridge_pid = pid;
+    client->next_id = 1;
     
     return client;
 }
@@ -59,14 +151,13 @@ MCPClient* mcp_create_client() {
 void mcp_cleanup(MCPClient* client) {
     if (!client) return;
     
-    if (client->bridge_in) {
-        fprintf(client->bridge_in, "EXIT\n");
-        fflush(client->bridge_in);
-        fclose(client->bridge_in);
+    if (client->fd_in >= 0) {
+        write_frame(client->fd_in, NULL, 0, MCP_FRAME_CLOSE);
+        close(client->fd_in);
     }
     
-    if (client->bridge_out) {
-        fclose(client->bridge_out);
+    if (client->fd_out >= 0) {
+        close(client->fd_out);
     }
     
     if (client->bridge_pid > 0) {
@@ -74,55 +165,327 @@ void mcp_cleanup(MCPClient* client) {
         waitpid(client->bridge_pid, NULL, 0);
     }
     
+    while (client->ready) {
+        MCPResponse* next = client->ready->next;
+        mcp_free_response(client->ready);
+        client->ready = next;
+    }
+    free(client->abandoned);
+    
     free(client);
 }
 
-MCPResponse* mcp_send_command(MCPClient* client, const char* action, const char* data) {
-    if (!client || !action) return NULL;
+// Con stream = 1 el bridge manda la salida en mensajes {"Id","Fd","Chunk"} antes de la respuesta
+// timeout_ms > 0 pide al bridge que corte el comando tras ese plazo
+static int submit(MCPClient* client, const char* action, const char* data, int stream,
+                  int timeout_ms) {
+    if (!client || !action || client->broken) return 0;
+    int id = client->next_id++;
+    if (client->next_id <= 0) client->next_id = 1;
     
     // Construir JSON para el comando
-    fprintf(client->bridge_in, "{\"Action\":\"%s\"", action);
-    if (data) {
-        fprintf(client->bridge_in, ",\"Data\":\"");
-        for (const char* p = data; *p; p++) {
-            if (*p == '"' || *p == '\\') {
-                fputc('\\', client->bridge_in);
-            }
-            fputc(*p, client->bridge_in);
+    Buffer msg;
+    buffer_init(&msg);
+    int ok = buffer_appendf(&msg, "{\"Id\":%d,\"Action\":\"", id) &&
+             json_escape_append(&msg, action, strlen(action)) &&
+             buffer_append_str(&msg, "\"");
+    if (ok && data) {
+        ok = buffer_append_str(&msg, ",\"Data\":\"") &&
+             json_escape_append(&msg, data, strlen(data)) &&
+             buffer_append_str(&msg, "\"");
+    }
+    if (ok && stream) ok = buffer_append_str(&msg, ",\"Stream\":true");
+    if (ok && timeout_ms > 0) ok = buffer_appendf(&msg, ",\"TimeoutMs\":%d", timeout_ms);
+    ok = ok && buffer_append_str(&msg, "}");
+    
+    if (ok && !write_message(client->fd_in, msg.data, msg.len)) {
+        // Un mensaje a medio escribir desincroniza el protocolo
+        client->broken = 1;
+        ok = 0;
+    }
+    buffer_free(&msg);
+    if (!ok) return 0;
+    
+    client->in_flight++;
+    return id;
+}
+
+int mcp_submit(MCPClient* client, const char* action, const char* data) {
+    return submit(client, action, data, 0, 0);
+}
+
+// 1 si la solicitud id se canceló y ya nadie espera su respuesta
+static int is_abandoned(const MCPClient* client, int id) {
+    for (size_t i = 0; i < client->abandoned_count; i++) {
+        if (client->abandoned[i] == id) return 1;
+    }
+    return 0;
+}
+
+static int abandon(MCPClient* client, int id) {
+    if (is_abandoned(client, id)) return 1;
+    if (client->abandoned_count == client->abandoned_cap) {
+        size_t cap = client->abandoned_cap ? client->abandoned_cap * 2 : 8;
+        int* grown = realloc(client->abandoned, cap * sizeof(int));
+        if (!grown) return 0;
+        client->abandoned = grown;
+        client->abandoned_cap = cap;
+    }
+    client->abandoned[client->abandoned_count++] = id;
+    return 1;
+}
+
+static void forget_abandoned(MCPClient* client, int id) {
+    for (size_t i = 0; i < client->abandoned_count; i++) {
+        if (client->abandoned[i] == id) {
+            client->abandoned[i] = client->abandoned[--client->abandoned_count];
+            return;
         }
-        fprintf(client->bridge_in, "\"");
     }
-    fprintf(client->bridge_in, "}\n");
-    fflush(client->bridge_in);
+}
+
+// Entrega un trozo de salida en vivo; no es la respuesta, así que la solicitud sigue pendiente
+static void dispatch_chunk(MCPClient* client, int id, const Buffer* msg) {
+    if (!client->on_chunk) return;
+    JsonValue fd;
+    int stream = 1;
+    if (json_find(msg->data, msg->len, "Fd", &fd) && fd.type == JSON_TOK_NUMBER) {
+        stream = (int)strtol(fd.raw, NULL, 10);
+    }
+    char* chunk = json_get_string(msg->data, msg->len, "Chunk");
+    if (chunk) {
+        client->on_chunk(id, stream, chunk, strlen(chunk), client->chunk_ctx);
+        free(chunk);
+    }
+}
+
+// Lee la siguiente respuesta del bridge; NULL si vence timeout_ms o el bridge se cayó.
+// Los trozos de salida en vivo que lleguen mientras tanto se entregan a on_chunk
+static MCPResponse* read_reply(MCPClient* client, int timeout_ms) {
+    if (client->broken || client->in_flight == 0) return NULL;
     
-    // Leer respuesta
-    char buffer[8192];
-    if (!fgets(buffer, sizeof(buffer), client->bridge_out)) {
+    uint64_t deadline = timeout_ms >= 0 ? metrics_now() + (uint64_t)timeout_ms * 1000000ULL : 0;
+    Buffer msg;
+    buffer_init(&msg);
+    MCPResponse* response = NULL;
+    
+    while (!response) {
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            uint64_t now = metrics_now();
+            wait_ms = now < deadline ? (int)((deadline - now + 999999) / 1000000) : 0;
+        }
+        
+        struct pollfd pfd = { client->fd_out, POLLIN, 0 };
+        int n = poll(&pfd, 1, wait_ms);
+        // Una señal (Ctrl-C) despierta a poll: se vuelve a esperar lo que quede del plazo
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0) {
+            buffer_free(&msg);
+            return NULL;
+        }
+        
+        if (n < 0 || !read_message(client->fd_out, &msg)) {
+            buffer_free(&msg);
+            client->broken = 1;
+            return NULL;
+        }
+        
+        JsonValue id;
+        int reply_id = 0;
+        if (json_find(msg.data, msg.len, "Id", &id) && id.type == JSON_TOK_NUMBER) {
+            reply_id = (int)strtol(id.raw, NULL, 10);
+        }
+        JsonValue chunk;
+        if (reply_id > 0 && json_find(msg.data, msg.len, "Chunk", &chunk)) {
+            if (!is_abandoned(client, reply_id)) dispatch_chunk(client, reply_id, &msg);
+            continue;
+        }
+        if (reply_id > 0 && is_abandoned(client, reply_id)) {
+            // Respuesta de una solicitud cancelada: ya no la espera nadie
+            forget_abandoned(client, reply_id);
+            client->in_flight--;
+            if (client->in_flight == 0) break;
+            continue;
+        }
+        
+        // Crear respuesta usando nuestro parser simple
+        response = calloc(1, sizeof(MCPResponse));
+        if (!response) break;
+        response->id = reply_id;
+    }
+    if (!response && client->in_flight == 0 && !client->broken) {
+        // Solo quedaban respuestas descartadas
+        buffer_free(&msg);
+        return NULL;
+    }
+    if (!response || response->id <= 0) {
+        // Sin id no se sabe a quién pertenece: el bridge falló por completo
+        free(response);
+        buffer_free(&msg);
+        client->broken = 1;
         return NULL;
     }
     
-    // Crear respuesta usando nuestro parser simple
-    MCPResponse* response = calloc(1, sizeof(MCPResponse));
-    if (!response) return NULL;
+    // Extraer los campos con el lector JSON (desescapa \n, \" y \uXXXX)
+    response->success = json_get_bool(msg.data, msg.len, "Success", 0);
+    response->result = json_get_string(msg.data, msg.len, "Result");
+    response->error = json_get_string(msg.data, msg.len, "Error");
+    JsonValue elapsed;
+    if (json_find(msg.data, msg.len, "ElapsedMs", &elapsed) && elapsed.type == JSON_TOK_NUMBER) {
+        response->elapsed_ms = strtod(elapsed.raw, NULL);
+    }
+    client->in_flight--;
     
-    // Usar nuestras funciones simples de json_parser.h
-    response->success = json_extract_bool(buffer, "Success");
+    buffer_free(&msg);
+    return response;
+}
+
+// Saca de la lista de pendientes de recoger la respuesta de id, si ya llegó
+static MCPResponse* take_ready(MCPClient* client, int id) {
+    for (MCPResponse** p = &client->ready; *p; p = &(*p)->next) {
+        if ((*p)->id == id) {
+            MCPResponse* response = *p;
+            *p = response->next;
+            response->next = NULL;
+            return response;
+        }
+    }
+    return NULL;
+}
+
+static void queue_ready(MCPClient* client, MCPResponse* response) {
+    // Se guarda (en orden de llegada) para quien la pida
+    MCPResponse** tail = &client->ready;
+    while (*tail) tail = &(*tail)->next;
+    *tail = response;
+}
+
+// {"Id":id,"Action":"cancel"}: no tiene respuesta propia, la solicitud
+// cancelada responde con su error
+static int send_cancel(MCPClient* client, int id) {
+    if (client->broken) return 0;
+    Buffer msg;
+    buffer_init(&msg);
+    int ok = buffer_appendf(&msg, "{\"Id\":%d,\"Action\":\"cancel\"}", id);
+    if (ok && !write_message(client->fd_in, msg.data, msg.len)) {
+        client->broken = 1;
+        ok = 0;
+    }
+    buffer_free(&msg);
+    return ok;
+}
+
+int mcp_cancel(MCPClient* client, int id) {
+    if (!client || id <= 0 || client->broken) return 0;
     
-    char* result = json_extract_string(buffer, "Result");
-    if (result) {
-        response->result = result;
+    MCPResponse* done = take_ready(client, id);
+    if (done) {
+        // Ya terminó: no hay nada que matar
+        mcp_free_response(done);
+        return 1;
     }
     
-    char* error = json_extract_string(buffer, "Error");
-    if (error) {
-        response->error = error;
+    int ok = send_cancel(client, id);
+    return abandon(client, id) && ok;
+}
+
+// Ctrl-C durante mcp_wait: se pide la cancelación y se da al bridge un momento
+// para matar el comando y contestar con lo que alcanzó a producir
+static MCPResponse* cancel_wait(MCPClient* client, int id) {
+    MCPResponse* response = NULL;
+    send_cancel(client, id);
+    
+    uint64_t deadline = metrics_now() + (uint64_t)MCP_CANCEL_GRACE_MS * 1000000ULL;
+    while (!response && !client->broken) {
+        uint64_t now = metrics_now();
+        if (now >= deadline) break;
+        MCPResponse* reply = read_reply(client, (int)((deadline - now + 999999) / 1000000));
+        if (!reply) continue;
+        if (reply->id == id) response = reply;
+        else queue_ready(client, reply);
     }
+    if (response || client->broken) return response;
     
+    // El bridge no contestó a tiempo: su respuesta se descartará cuando llegue
+    abandon(client, id);
+    response = calloc(1, sizeof(MCPResponse));
+    if (response) {
+        response->id = id;
+        response->error = strdup("Comando cancelado con Ctrl-C");
+    }
     return response;
 }
 
+MCPResponse* mcp_wait(MCPClient* client, int id) {
+    if (!client || id <= 0) return NULL;
+    
+    // ¿Ya llegó mientras se esperaba otra?
+    MCPResponse* response = take_ready(client, id);
+    if (response) return response;
+    
+    // Se espera en tramos cortos para atender Ctrl-C aunque el bridge no diga nada
+    while (1) {
+        response = read_reply(client, MCP_INTERRUPT_CHECK_MS);
+        if (response && response->id == id) return response;
+        if (response) {
+            queue_ready(client, response);
+            continue;
+        }
+        if (client->broken || client->in_flight == 0) return NULL;
+        if (request_engine_interrupted()) return cancel_wait(client, id);
+    }
+}
+
+MCPResponse* mcp_wait_any(MCPClient* client, int timeout_ms) {
+    if (!client) return NULL;
+    
+    if (client->ready) {
+        MCPResponse* response = client->ready;
+        client->ready = response->next;
+        response->next = NULL;
+        return response;
+    }
+    return read_reply(client, timeout_ms);
+}
+
+MCPResponse* mcp_send_command(MCPClient* client, const char* action, const char* data) {
+    uint64_t t0 = metrics_now();
+    int id = mcp_submit(client, action, data);
+    MCPResponse* response = id ? mcp_wait(client, id) : NULL;
+    metrics_span(METRIC_STAGE_MCP, t0);
+    return response;
+}
+
+void mcp_set_command_timeout(MCPClient* client, int timeout_ms) {
+    if (client) client->command_timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+}
+
 MCPResponse* mcp_execute_command(MCPClient* client, const char* command) {
-    return mcp_send_command(client, "execute_command", command);
+    if (!client) return NULL;
+    uint64_t t0 = metrics_now();
+    int id = submit(client, "execute_command", command, 0, client->command_timeout_ms);
+    MCPResponse* response = id ? mcp_wait(client, id) : NULL;
+    metrics_span(METRIC_STAGE_MCP, t0);
+    return response;
+}
+
+MCPResponse* mcp_execute_command_live(MCPClient* client, const char* command,
+                                      MCPChunkCallback on_chunk, void* ctx) {
+    if (!client) return NULL;
+    uint64_t t0 = metrics_now();
+    MCPChunkCallback saved = client->on_chunk;
+    void* saved_ctx = client->chunk_ctx;
+    client->on_chunk = on_chunk;
+    client->chunk_ctx = ctx;
+    
+    int id = submit(client, "execute_command", command, 1, client->command_timeout_ms);
+    MCPResponse* response = id ? mcp_wait(client, id) : NULL;
+    
+    client->on_chunk = saved;
+    client->chunk_ctx = saved_ctx;
+    metrics_span(METRIC_STAGE_MCP, t0);
+    return response;
 }
 
 MCPResponse* mcp_analyze_text(MCPClient* client, const char* text) {
@@ -146,30 +509,6 @@ void mcp_free_response(MCPResponse* response) {
 }
 
 int is_user_command(const char* text) {
-    if (!text) return 0;
-    
-    // Saltar espacios iniciales
-    while (isspace(*text)) text++;
-    
-    // Lista de comandos comunes
-    const char* commands[] = {
-        "ls", "dir", "pwd", "cd", "cat", "grep", "find", "ps", "top", 
-        "df", "du", "free", "uname", "which", "whereis", "locate",
-        "pacman", "yay", "makepkg", "systemctl", "journalctl",
-        "sudo", "su", "chmod", "chown", "mkdir", "rmdir", "rm",
-        "cp", "mv", "ln", "tar", "gzip", "unzip", "wget", "curl",
-        "lsblk", "fdisk", "cfdisk", "mount", "umount",
-        NULL
-    };
-    
-    for (int i = 0; commands[i]; i++) {
-        size_t len = strlen(commands[i]);
-        if (strncmp(text, commands[i], len) == 0) {
-            if (text[len] == '\0' || isspace(text[len]) || text[len] == '-') {
-                return 1;
-            }
-        }
-    }
-    
-    return 0;
+    // Cualquier ejecutable del PATH u orden interna de la shell (ver command_index.h)
+    return command_index_is_command(text);
 }
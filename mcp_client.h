@@ -7,31 +7,90 @@
 #include <unistd.h>
 #include <sys/types.h>
 
+// Protocolo con el bridge: cada mensaje JSON viaja en uno o más frames
+// [longitud u32 big-endian][flags u32 big-endian][payload de longitud bytes]
+#define MCP_FRAME_HEADER 8
+#define MCP_FRAME_MORE 0x1           // El mensaje continúa en el siguiente frame
+#define MCP_FRAME_CLOSE 0x2          // Fin de la sesión (sin payload)
+#define MCP_FRAME_CHUNK (1u << 20)   // Tamaño máximo del payload de un frame
+#define MCP_MAX_MESSAGE (256u << 20) // Mensajes mayores se consideran corruptos
+
+#define MCP_INTERRUPT_CHECK_MS 100 // Cada cuánto mira mcp_wait si se pulsó Ctrl-C
+#define MCP_CANCEL_GRACE_MS 2000   // Espera a la respuesta real tras pedir la cancelación
+
+typedef struct MCPResponse MCPResponse;
+
+// Recibe la salida de un comando en vivo, trozo a trozo (fd 1 = stdout, 2 = stderr)
+typedef void (*MCPChunkCallback)(int id, int fd, const char* data, size_t len, void* ctx);
+
 typedef struct {
-    FILE* bridge_in;
-    FILE* bridge_out;
+    int fd_in;          // Escritura hacia el stdin del bridge
+    int fd_out;         // Lectura desde el stdout del bridge
     pid_t bridge_pid;
+    int next_id;        // Id de la siguiente solicitud
+    int in_flight;      // Solicitudes enviadas cuya respuesta no se ha leído
+    int broken;         // El bridge murió o rompió el protocolo
+    MCPResponse* ready; // Respuestas leídas que aún nadie ha recogido
+    MCPChunkCallback on_chunk; // Destino de los trozos de salida en vivo (NULL = se descartan)
+    void* chunk_ctx;
+    int command_timeout_ms; // Plazo de execute_command que aplica el bridge (0 = sin límite)
+    int* abandoned;     // Solicitudes canceladas cuya respuesta se descartará al llegar
+    size_t abandoned_count;
+    size_t abandoned_cap;
 } MCPClient;
 
-typedef struct {
+struct MCPResponse {
+    int id;             // Id de la solicitud a la que responde
     int success;
     char* result;
     char* error;
-} MCPResponse;
+    double elapsed_ms;  // Tiempo que tardó el bridge en atenderla
+    MCPResponse* next;  // Uso interno (respuestas pendientes de recoger)
+};
 
 // Funciones del cliente MCP
 MCPClient* mcp_create_client();
 void mcp_cleanup(MCPClient* client);
 
+// Solicitudes en paralelo: el bridge atiende varias a la vez y responde en el
+// orden en que terminan. El cliente no es seguro entre hilos.
+
+// Envía una solicitud sin esperar la respuesta. Devuelve su id (> 0) o 0 si falló
+int mcp_submit(MCPClient* client, const char* action, const char* data);
+
+// Espera la respuesta de la solicitud id; NULL si el bridge se cayó o el id no está pendiente.
+// Con Ctrl-C (request_engine_interrupted) pide al bridge que la cancele y, si no
+// responde en MCP_CANCEL_GRACE_MS, devuelve un error sin esperar más
+MCPResponse* mcp_wait(MCPClient* client, int id);
+
+// Pide al bridge que mate el comando de la solicitud id. Su respuesta (y la
+// salida en vivo que quede) se descarta al llegar: nadie la esperará ya.
+// Devuelve 0 si no se pudo enviar
+int mcp_cancel(MCPClient* client, int id);
+
+// Devuelve la siguiente respuesta que llegue (su id en response->id). timeout_ms < 0
+// espera sin límite; NULL si vence el plazo, no hay solicitudes pendientes o el bridge se cayó
+MCPResponse* mcp_wait_any(MCPClient* client, int timeout_ms);
+
+// Plazo de los comandos de mcp_execute_command(_live); 0 = sin límite
+void mcp_set_command_timeout(MCPClient* client, int timeout_ms);
+
+// Envía una solicitud y espera su respuesta
 MCPResponse* mcp_send_command(MCPClient* client, const char* action, const char* data);
 MCPResponse* mcp_execute_command(MCPClient* client, const char* command);
+
+// Como mcp_execute_command, pero el bridge envía la salida a on_chunk mientras el
+// comando corre; la respuesta final contiene igualmente la salida completa
+MCPResponse* mcp_execute_command_live(MCPClient* client, const char* command,
+                                      MCPChunkCallback on_chunk, void* ctx);
 MCPResponse* mcp_analyze_text(MCPClient* client, const char* text);
 MCPResponse* mcp_get_system_info(MCPClient* client);
 MCPResponse* mcp_arch_diagnostics(MCPClient* client);
 
 void mcp_free_response(MCPResponse* response);
 
-// Función para detectar si el texto del usuario es un comando
+// Función para detectar si el texto del usuario es un comando: su primera
+// palabra es un ejecutable del PATH, una orden interna o una ruta ejecutable
 int is_user_command(const char* text);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+ * output_reducer_test.c - Pruebas de output_reduce
+ * Comprueba que las líneas que solo difieren en números (tablas, direcciones,
+ * PIDs) nunca se agrupan y que las repeticiones se agrupan solo cuando la
+ * salida no cabe en el presupuesto.
+ *
+ * Uso: make test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/includes/buffer.h"
+#include "../common/includes/output_reducer.h"
+
+static int failures = 0;
+
+#define CHECK(cond, name) do { \
+    if (!(cond)) { fprintf(stderr, "❌ %s (%s:%d)\n", name, __FILE__, __LINE__); failures++; } \
+} while (0)
+
+// Sin presupuesto la salida solo se limpia: cada línea llega tal cual
+static void test_unlimited_keeps_numbers(void) {
+    const char *cases[] = {
+        "1\n2\n3\n4\n5",
+        "eth0: inet 192.168.1.5/24\neth1: inet 10.0.0.7/8",
+        "101 bash\n202 bash\n303 bash",
+        "same\nsame\nsame",
+        NULL
+    };
+    for (int i = 0; cases[i]; i++) {
+        OutputReduceStats stats;
+        char *out = output_reduce(cases[i], strlen(cases[i]), NULL, 0, &stats);
+        CHECK(strcmp(out, cases[i]) == 0, cases[i]);
+        CHECK(stats.collapsed_lines == 0 && stats.omitted_lines == 0, "sin límite no se agrupa");
+        free(out);
+    }
+}
+
+// Una tabla numérica que no cabe pierde filas (marcadas), pero ninguna fila
+// mostrada representa a otras ni aparece un valor que no estaba
+static void test_numeric_table_over_budget(void) {
+    Buffer table;
+    buffer_init(&table);
+    buffer_append_str(&table, "  PID TTY          TIME CMD\n");
+    for (int i = 0; i < 400; i++) {
+        buffer_appendf(&table, "%5d pts/%d    00:00:%02d bash\n", 1000 + i * 7, i % 4, i % 60);
+    }
+
+    OutputReduceStats stats;
+    char *out = output_reduce(table.data, table.len, NULL, 300, &stats);
+    CHECK(strstr(out, "[×") == NULL, "las filas de la tabla no se agrupan");
+    CHECK(stats.collapsed_lines == 0, "collapsed_lines = 0 en una tabla");
+    CHECK(stats.omitted_lines > 0 && strstr(out, "líneas omitidas") != NULL, "hueco marcado");
+    CHECK(stats.reduced_tokens <= 300, "cabe en el presupuesto");
+
+    // Cada línea de la salida es una fila original o una marca de omisión
+    char *save = NULL;
+    for (char *line = strtok_r(out, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        int known = strstr(line, "líneas omitidas") != NULL || strstr(table.data, line) != NULL;
+        CHECK(known, line);
+    }
+    free(out);
+    buffer_free(&table);
+}
+
+// Iguales salvo por la marca de tiempo: se agrupan solo si no cabe
+static void test_timestamps_collapse_over_budget(void) {
+    Buffer log;
+    buffer_init(&log);
+    for (int i = 0; i < 200; i++) {
+        buffer_appendf(&log, "Oct 18 10:%02d:%02d archlinux sshd[812]: Connection closed\n", i / 60, i % 60);
+    }
+    buffer_append_str(&log, "2024-10-18T10:59:00.123Z worker: done\n");
+    buffer_append_str(&log, "2024-10-18T10:59:01.456Z worker: done\n");
+    buffer_append_str(&log, "[   12.345678] usb 1-2: reset\n[   12.400001] usb 1-2: reset");
+
+    OutputReduceStats stats;
+    char *out = output_reduce(log.data, log.len, NULL, 200, &stats);
+    CHECK(strstr(out, "Connection closed  [×200]") != NULL, "syslog agrupado");
+    CHECK(strstr(out, "worker: done  [×2]") != NULL, "ISO 8601 agrupado");
+    CHECK(strstr(out, "usb 1-2: reset  [×2]") != NULL, "dmesg agrupado");
+    CHECK(stats.collapsed_lines == 199 + 1 + 1, "collapsed_lines");
+    free(out);
+
+    out = output_reduce(log.data, log.len, NULL, 100000, &stats);
+    CHECK(strstr(out, "[×") == NULL && stats.collapsed_lines == 0, "cabe: no se agrupa");
+    free(out);
+    buffer_free(&log);
+}
+
+// Un número tras la marca de tiempo sigue siendo un dato
+static void test_timestamp_then_data(void) {
+    Buffer log;
+    buffer_init(&log);
+    for (int i = 0; i < 300; i++) {
+        buffer_appendf(&log, "10:42:%02d eth%d: inet 10.0.%d.1\n", i % 60, i % 3, i);
+    }
+    OutputReduceStats stats;
+    char *out = output_reduce(log.data, log.len, NULL, 150, &stats);
+    CHECK(strstr(out, "[×") == NULL, "datos tras la hora no se agrupan");
+    free(out);
+    buffer_free(&log);
+}
+
+int main(void) {
+    test_unlimited_keeps_numbers();
+    test_numeric_table_over_budget();
+    test_timestamps_collapse_over_budget();
+    test_timestamp_then_data();
+
+    if (failures) {
+        fprintf(stderr, "output_reducer: %d fallos\n", failures);
+        return 1;
+    }
+    printf("✅ output_reducer: todas las pruebas pasan\n");
+    return 0;
+}
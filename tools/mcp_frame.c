@@ -0,0 +1,82 @@
+/*
+ * mcp_frame.c - Empaqueta y desempaqueta mensajes del protocolo del bridge
+ * para probarlo desde la shell:
+ *
+ *   echo '{"Id":1,"Action":"get_system_info"}' | mcp_frame encode \
+ *       | out/MCPBridge_native | mcp_frame decode | jq .Success
+ *
+ * encode: cada línea de la entrada es un mensaje; al final envía el frame de cierre.
+ * decode: escribe cada mensaje recibido en una línea.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../mcp_client.h"
+
+static void put_u32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void write_frame(const char* payload, uint32_t len, uint32_t flags) {
+    unsigned char header[MCP_FRAME_HEADER];
+    put_u32(header, len);
+    put_u32(header + 4, flags);
+    fwrite(header, 1, sizeof(header), stdout);
+    if (len > 0) fwrite(payload, 1, len, stdout);
+}
+
+static int encode(void) {
+    char* line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, stdin)) > 0) {
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) n--;
+        if (n == 0) continue;
+        size_t sent = 0;
+        do {
+            size_t chunk = (size_t)n - sent < MCP_FRAME_CHUNK ? (size_t)n - sent : MCP_FRAME_CHUNK;
+            int more = sent + chunk < (size_t)n;
+            write_frame(line + sent, (uint32_t)chunk, more ? MCP_FRAME_MORE : 0);
+            sent += chunk;
+        } while (sent < (size_t)n);
+    }
+    free(line);
+    write_frame(NULL, 0, MCP_FRAME_CLOSE);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
+
+static int decode(void) {
+    unsigned char header[MCP_FRAME_HEADER];
+    char* payload = malloc(MCP_FRAME_CHUNK);
+    if (!payload) return 1;
+    while (fread(header, 1, sizeof(header), stdin) == sizeof(header)) {
+        uint32_t len = get_u32(header);
+        uint32_t flags = get_u32(header + 4);
+        if (flags & MCP_FRAME_CLOSE) break;
+        if (len > MCP_FRAME_CHUNK || fread(payload, 1, len, stdin) != len) {
+            fprintf(stderr, "mcp_frame: frame inválido o incompleto\n");
+            free(payload);
+            return 1;
+        }
+        fwrite(payload, 1, len, stdout);
+        if (!(flags & MCP_FRAME_MORE)) putchar('\n');
+    }
+    free(payload);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && strcmp(argv[1], "encode") == 0) return encode();
+    if (argc == 2 && strcmp(argv[1], "decode") == 0) return decode();
+    fprintf(stderr, "Uso: %s encode|decode\n", argv[0]);
+    return 2;
+}